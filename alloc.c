@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "alloc.h"
+
+/* sits right before every block handed to the driver */
+struct sl_alloc_header {
+    size_t size;
+    /* from the start of the posix_memalign block to the user pointer */
+    uint32_t offset;
+    uint32_t alignment;
+    uint16_t site;
+    uint16_t scope;
+    uint32_t padding;
+};
+
+static const char *siteNames[ALLOC_SITE_COUNT] = {
+    "instance",  "device",    "swapchain",   "images",   "memory",
+    "buffers",   "pipelines", "descriptors", "commands", "sync",
+};
+
+static const char *scopeNames[ALLOC_SCOPE_COUNT] = {
+    "command", "object", "cache", "device", "instance",
+};
+
+static void countLive(struct sl_alloc_counters *counters, int64_t delta) {
+    int64_t live =
+        __atomic_add_fetch(&counters->live, delta, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&counters->peak, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&counters->peak, &peak, live, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static struct sl_alloc_counters *
+countersFor(struct sl_allocator *allocator, uint32_t site, uint32_t scope) {
+    if (scope >= ALLOC_SCOPE_COUNT) {
+        scope = VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+    }
+    return &allocator->counters[site][scope];
+}
+
+static void *trackedAlloc(struct sl_alloc_site *site, size_t size,
+                          size_t alignment, VkSystemAllocationScope scope) {
+    if (alignment < sizeof(void *)) {
+        alignment = sizeof(void *);
+    }
+    /* the header goes in front, rounded up so the block stays aligned */
+    size_t offset = (sizeof(struct sl_alloc_header) + alignment - 1) &
+                    ~(alignment - 1);
+    void *block = NULL;
+    if (posix_memalign(&block, alignment, offset + size) != 0) {
+        return NULL;
+    }
+
+    uint8_t *memory = (uint8_t *)block + offset;
+    struct sl_alloc_header *header = (struct sl_alloc_header *)memory - 1;
+    header->size = size;
+    header->offset = (uint32_t)offset;
+    header->alignment = (uint32_t)alignment;
+    header->site = (uint16_t)site->site;
+    header->scope = (uint16_t)scope;
+
+    struct sl_alloc_counters *counters =
+        countersFor(site->allocator, site->site, scope);
+    __atomic_add_fetch(&counters->allocations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counters->bytes, size, __ATOMIC_RELAXED);
+    countLive(counters, (int64_t)size);
+    return memory;
+}
+
+/* the block may come from another site's callbacks, the header says which
+   counters it was charged to */
+static void trackedFree(struct sl_allocator *allocator, void *memory) {
+    if (memory == NULL) {
+        return;
+    }
+    struct sl_alloc_header *header = (struct sl_alloc_header *)memory - 1;
+    struct sl_alloc_counters *counters =
+        countersFor(allocator, header->site, header->scope);
+    __atomic_add_fetch(&counters->frees, 1, __ATOMIC_RELAXED);
+    countLive(counters, -(int64_t)header->size);
+    free((uint8_t *)memory - header->offset);
+}
+
+static void *VKAPI_PTR allocationCallback(void *pUserData, size_t size,
+                                          size_t alignment,
+                                          VkSystemAllocationScope scope) {
+    return trackedAlloc(pUserData, size, alignment, scope);
+}
+
+static void *VKAPI_PTR reallocationCallback(void *pUserData, void *pOriginal,
+                                            size_t size, size_t alignment,
+                                            VkSystemAllocationScope scope) {
+    struct sl_alloc_site *site = pUserData;
+    if (pOriginal == NULL) {
+        return trackedAlloc(site, size, alignment, scope);
+    }
+    if (size == 0) {
+        trackedFree(site->allocator, pOriginal);
+        return NULL;
+    }
+
+    /* realloc cannot keep an alignment, so always move */
+    struct sl_alloc_header *header = (struct sl_alloc_header *)pOriginal - 1;
+    void *memory = trackedAlloc(site, size, alignment, scope);
+    if (memory == NULL) {
+        return NULL;
+    }
+    memcpy(memory, pOriginal, header->size < size ? header->size : size);
+    trackedFree(site->allocator, pOriginal);
+
+    struct sl_alloc_counters *counters =
+        countersFor(site->allocator, site->site, scope);
+    __atomic_add_fetch(&counters->reallocations, 1, __ATOMIC_RELAXED);
+    return memory;
+}
+
+static void VKAPI_PTR freeCallback(void *pUserData, void *pMemory) {
+    struct sl_alloc_site *site = pUserData;
+    trackedFree(site->allocator, pMemory);
+}
+
+static void VKAPI_PTR internalAllocationCallback(
+    void *pUserData, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope) {
+    struct sl_alloc_site *site = pUserData;
+    __atomic_add_fetch(
+        &countersFor(site->allocator, site->site, scope)->internal,
+        (int64_t)size, __ATOMIC_RELAXED);
+}
+
+static void VKAPI_PTR internalFreeCallback(void *pUserData, size_t size,
+                                           VkInternalAllocationType type,
+                                           VkSystemAllocationScope scope) {
+    struct sl_alloc_site *site = pUserData;
+    __atomic_sub_fetch(
+        &countersFor(site->allocator, site->site, scope)->internal,
+        (int64_t)size, __ATOMIC_RELAXED);
+}
+
+void createHostAllocator(struct sl_oo *oo) {
+    struct sl_allocator *allocator = &oo->alloc;
+    if (!allocator->enabled) {
+        return;
+    }
+
+    for (int i = 0; i < ALLOC_SITE_COUNT; i++) {
+        allocator->sites[i].allocator = allocator;
+        allocator->sites[i].site = (enum AllocSite)i;
+
+        VkAllocationCallbacks *callbacks = &allocator->callbacks[i];
+        callbacks->pUserData = &allocator->sites[i];
+        callbacks->pfnAllocation = allocationCallback;
+        callbacks->pfnReallocation = reallocationCallback;
+        callbacks->pfnFree = freeCallback;
+        callbacks->pfnInternalAllocation = internalAllocationCallback;
+        callbacks->pfnInternalFree = internalFreeCallback;
+    }
+    allocator->active = true;
+}
+
+const VkAllocationCallbacks *hostAllocator(struct sl_oo *oo,
+                                           enum AllocSite site) {
+    return oo->alloc.active ? &oo->alloc.callbacks[site] : NULL;
+}
+
+uint64_t hostAllocationCount(struct sl_oo *oo) {
+    uint64_t count = 0;
+    for (int site = 0; site < ALLOC_SITE_COUNT; site++) {
+        for (int scope = 0; scope < ALLOC_SCOPE_COUNT; scope++) {
+            count += __atomic_load_n(&oo->alloc.counters[site][scope]
+                                          .allocations,
+                                     __ATOMIC_RELAXED);
+        }
+    }
+    return count;
+}
+
+/* runs after vkDestroyInstance, so live is what leaked */
+void reportHostAllocations(struct sl_oo *oo) {
+    struct sl_allocator *allocator = &oo->alloc;
+    if (!allocator->active || !allocator->report) {
+        return;
+    }
+
+    fprintf(stderr, "host allocations by scope:\n");
+    fprintf(stderr, "  %-9s %9s %9s %12s %10s %8s %8s\n", "scope",
+            "allocs", "reallocs", "bytes", "peak", "live", "internal");
+    for (int scope = 0; scope < ALLOC_SCOPE_COUNT; scope++) {
+        struct sl_alloc_counters total = { 0 };
+        /* sites by allocation count, busiest first */
+        int hot[ALLOC_SITE_COUNT];
+        int hotCount = 0;
+        for (int site = 0; site < ALLOC_SITE_COUNT; site++) {
+            struct sl_alloc_counters *c = &allocator->counters[site][scope];
+            total.allocations += c->allocations;
+            total.reallocations += c->reallocations;
+            total.bytes += c->bytes;
+            total.peak += c->peak;
+            total.live += c->live;
+            total.internal += c->internal;
+            if (c->allocations == 0) {
+                continue;
+            }
+            int at = hotCount++;
+            while (at > 0 && allocator->counters[hot[at - 1]][scope]
+                                     .allocations < c->allocations) {
+                hot[at] = hot[at - 1];
+                at--;
+            }
+            hot[at] = site;
+        }
+        if (total.allocations == 0 && total.internal == 0) {
+            continue;
+        }
+
+        /* peak is the sum of each site's peak, an upper bound */
+        fprintf(stderr, "  %-9s %9llu %9llu %12llu %10lld %8lld %8lld\n",
+                scopeNames[scope], (unsigned long long)total.allocations,
+                (unsigned long long)total.reallocations,
+                (unsigned long long)total.bytes, (long long)total.peak,
+                (long long)total.live, (long long)total.internal);
+        for (int i = 0; i < hotCount && i < ALLOC_HOT_SITES; i++) {
+            struct sl_alloc_counters *c = &allocator->counters[hot[i]][scope];
+            fprintf(stderr, "    %-11s %9llu allocs %12llu bytes\n",
+                    siteNames[hot[i]], (unsigned long long)c->allocations,
+                    (unsigned long long)c->bytes);
+        }
+    }
+}
+
+void *arenaAlloc(struct sl_arena *arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (arena->used + size <= arena->size) {
+        void *memory = arena->base + arena->used;
+        arena->used += size;
+        return memory;
+    }
+
+    /* room for the chain pointer, padded to keep the 16 byte alignment */
+    uint8_t *block = malloc(16 + size);
+    if (block == NULL) {
+        error_log("failed to allocate arena block!");
+        exit(1);
+    }
+    *(void **)block = arena->spill;
+    arena->spill = block;
+    arena->spillBytes += size;
+    return block + 16;
+}
+
+void arenaReset(struct sl_arena *arena) {
+    if (arena->spill == NULL) {
+        arena->used = 0;
+        return;
+    }
+
+    size_t needed = arena->used + arena->spillBytes;
+    while (arena->spill != NULL) {
+        void *next = *(void **)arena->spill;
+        free(arena->spill);
+        arena->spill = next;
+    }
+    arena->spillBytes = 0;
+
+    /* big enough for everything the last round asked for, with slack for
+       a swapchain with a few more images */
+    size_t size = arena->size > 0 ? arena->size : ARENA_MIN_SIZE;
+    while (size < needed * 2) {
+        size *= 2;
+    }
+    free(arena->base);
+    arena->base = malloc(size);
+    if (arena->base == NULL) {
+        error_log("failed to allocate arena!");
+        exit(1);
+    }
+    arena->size = size;
+    arena->used = 0;
+}
+
+void arenaDestroy(struct sl_arena *arena) {
+    arenaReset(arena);
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+}
@@ -0,0 +1,89 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* host memory, ours and the driver's. every vkCreate and vkDestroy gets
+   the callbacks of the kind of object it makes, so what the driver
+   allocates is counted per kind and per VkSystemAllocationScope. arrays
+   that live as long as the swapchain come from an arena that is reset on
+   recreate instead of going back to malloc. */
+
+struct sl_oo;
+
+/* what an allocation was made for, one VkAllocationCallbacks each */
+enum AllocSite {
+    ALLOC_INSTANCE,
+    ALLOC_DEVICE,
+    ALLOC_SWAPCHAIN,
+    ALLOC_IMAGES,
+    ALLOC_MEMORY,
+    ALLOC_BUFFERS,
+    ALLOC_PIPELINES,
+    ALLOC_DESCRIPTORS,
+    ALLOC_COMMANDS,
+    ALLOC_SYNC,
+    ALLOC_SITE_COUNT,
+};
+
+/* VK_SYSTEM_ALLOCATION_SCOPE_COMMAND up to _INSTANCE */
+#define ALLOC_SCOPE_COUNT 5
+
+/* updated from whatever thread the driver allocates on */
+struct sl_alloc_counters {
+    uint64_t allocations;
+    uint64_t reallocations;
+    uint64_t frees;
+    uint64_t bytes;
+    int64_t live;
+    int64_t peak;
+    /* memory the driver got elsewhere and only told us about */
+    int64_t internal;
+};
+
+struct sl_allocator {
+    /* options, set before createHostAllocator */
+    bool enabled;
+    /* print the counters in cleanUp */
+    bool report;
+
+    bool active;
+    VkAllocationCallbacks callbacks[ALLOC_SITE_COUNT];
+    /* pUserData of the callbacks, points back into counters */
+    struct sl_alloc_site {
+        struct sl_allocator *allocator;
+        enum AllocSite site;
+    } sites[ALLOC_SITE_COUNT];
+    struct sl_alloc_counters counters[ALLOC_SITE_COUNT][ALLOC_SCOPE_COUNT];
+};
+
+/* bump allocator, everything goes at once with arenaReset. a block that
+   overflows spills into malloc until the next reset, which grows it, so
+   the second recreate on does not touch the heap at all */
+struct sl_arena {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    /* overflow blocks, chained through their first pointer */
+    void *spill;
+    size_t spillBytes;
+};
+
+void createHostAllocator(struct sl_oo *oo);
+/* NULL, the driver's own allocator, unless createHostAllocator ran */
+const VkAllocationCallbacks *hostAllocator(struct sl_oo *oo,
+                                           enum AllocSite site);
+/* every allocation so far, for steady state checks */
+uint64_t hostAllocationCount(struct sl_oo *oo);
+void reportHostAllocations(struct sl_oo *oo);
+
+void *arenaAlloc(struct sl_arena *arena, size_t size);
+void arenaReset(struct sl_arena *arena);
+void arenaDestroy(struct sl_arena *arena);
+
+#endif /* ALLOC_H */
@@ -0,0 +1,618 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "log.h"
+
+#include <unistd.h>
+
+/* renders a list of jobs offscreen and writes every one to an image, for
+   running server side without a process per image. the instance, the
+   device, the pipeline cache and the mesh are shared, every worker has
+   its own command pool, target, instance buffer and readback, so the
+   only thing the workers take turns on is the queue.
+
+   jobs come one per line from a file or stdin, # starts a comment:
+       output.png [instances [seed [vertex|depth|white]]] */
+
+struct batch_job {
+    char path[CAPTURE_PATH_LEN];
+    uint32_t instances;
+    uint32_t seed;
+    uint32_t colorMode;
+};
+
+/* a worker's share of the jobs, a range of indices into the job list.
+   the owner takes from the back, idle workers steal from the front, both
+   with one compare and swap on head and tail packed together. nothing is
+   pushed once the workers run, so an empty range stays empty */
+struct batch_deque {
+    /* head in the high half, tail in the low half */
+    uint64_t range;
+    /* the owner and the thieves write it, keep it off its neighbours'
+       cache line */
+    uint8_t padding[56];
+};
+
+struct batch;
+
+struct batch_worker {
+    struct batch *batch;
+    uint32_t index;
+    pthread_t thread;
+
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    struct sl_target target;
+    VkBuffer instanceBuffer;
+    VkDeviceMemory instanceBufferMemory;
+    /* mapped, write only, the instances are scattered and sorted in
+       scratch first */
+    struct sl_instance *instances;
+    struct sl_instance *scratch;
+    struct sl_readback readback;
+
+    uint32_t rendered;
+    uint32_t stolen;
+};
+
+struct batch {
+    struct sl_oo *oo;
+    struct batch_job *jobs;
+    uint32_t jobCount;
+    uint32_t instanceCapacity;
+    /* a variant per color mode, built before the workers start so they
+       never touch the pipeline registry. they only differ in their
+       constants, key has the state they leave dynamic */
+    VkPipeline pipelines[COLOR_MODE_COUNT];
+    struct sl_pipeline_key key;
+
+    /* vkQueueSubmit needs the queue externally synchronized, held for
+       the submit only */
+    pthread_mutex_t queueLock;
+
+    struct batch_worker *workers;
+    struct batch_deque *deques;
+    uint32_t workerCount;
+};
+
+static const char *colorModeNames[COLOR_MODE_COUNT] = { "vertex", "depth",
+                                                        "white" };
+
+/****** jobs */
+
+static bool parseJob(const char *line, struct batch_job *job) {
+    char mode[16] = "vertex";
+    char path[CAPTURE_PATH_LEN];
+    char instances[16] = "1";
+    char seed[16] = "1";
+    int n = sscanf(line, "%255s %15s %15s %15s", path, instances, seed,
+                   mode);
+    if (n < 1 || path[0] == '#') {
+        return false;
+    }
+    memcpy(job->path, path, sizeof(job->path));
+
+    if (!parseNumber(instances, MAX_INSTANCES, &job->instances)) {
+        error_log("bad instance count %s for %s, at most %d", instances,
+                  path, MAX_INSTANCES);
+        exit(1);
+    }
+    if (!parseNumber(seed, UINT32_MAX, &job->seed)) {
+        error_log("bad seed %s for %s", seed, path);
+        exit(1);
+    }
+
+    job->colorMode = COLOR_MODE_COUNT;
+    for (uint32_t i = 0; i < COLOR_MODE_COUNT; i++) {
+        if (strcmp(mode, colorModeNames[i]) == 0) {
+            job->colorMode = i;
+        }
+    }
+    if (job->colorMode == COLOR_MODE_COUNT) {
+        error_log("unknown color mode %s for %s", mode, path);
+        exit(1);
+    }
+    return true;
+}
+
+static void readJobs(struct batch *batch, const char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (fp == NULL) {
+        error_log("cannot open job list %s", path);
+        exit(1);
+    }
+
+    uint32_t capacity = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (batch->jobCount == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            batch->jobs =
+                realloc(batch->jobs, sizeof(struct batch_job) * capacity);
+        }
+        struct batch_job *job = &batch->jobs[batch->jobCount];
+        if (!parseJob(line, job)) {
+            continue;
+        }
+        if (job->instances > batch->instanceCapacity) {
+            batch->instanceCapacity = job->instances;
+        }
+        batch->jobCount++;
+    }
+
+    if (fp != stdin) {
+        fclose(fp);
+    }
+}
+
+static bool popJob(struct batch_deque *deque, uint32_t *job) {
+    uint64_t range = __atomic_load_n(&deque->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t head = (uint32_t)(range >> 32);
+        uint32_t tail = (uint32_t)range;
+        if (head == tail) {
+            return false;
+        }
+        uint64_t next = (uint64_t)head << 32 | (tail - 1);
+        if (__atomic_compare_exchange_n(&deque->range, &range, next, true,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *job = tail - 1;
+            return true;
+        }
+    }
+}
+
+static bool stealJob(struct batch_deque *deque, uint32_t *job) {
+    uint64_t range = __atomic_load_n(&deque->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t head = (uint32_t)(range >> 32);
+        uint32_t tail = (uint32_t)range;
+        if (head == tail) {
+            return false;
+        }
+        uint64_t next = (uint64_t)(head + 1) << 32 | tail;
+        if (__atomic_compare_exchange_n(&deque->range, &range, next, true,
+                                        __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE)) {
+            *job = head;
+            return true;
+        }
+    }
+}
+
+/* its own jobs first, then the front of the others, starting with the
+   next worker so the thieves spread out */
+static bool nextJob(struct batch_worker *worker, uint32_t *job) {
+    struct batch *batch = worker->batch;
+    if (popJob(&batch->deques[worker->index], job)) {
+        return true;
+    }
+    for (uint32_t i = 1; i < batch->workerCount; i++) {
+        uint32_t victim = (worker->index + i) % batch->workerCount;
+        if (stealJob(&batch->deques[victim], job)) {
+            worker->stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/****** workers */
+
+static void recordJob(struct batch_worker *worker,
+                      const struct batch_job *job, uint32_t count) {
+    struct sl_oo *oo = worker->batch->oo;
+    VkCommandBuffer commandBuffer = worker->commandBuffer;
+    VkExtent2D extent = worker->target.swapChainExtent;
+
+    VkCommandBufferBeginInfo beginInfo = { 0 };
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        error_log("failed to begin recording command buffer!");
+        exit(1);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo = { 0 };
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = oo->renderPass;
+    renderPassInfo.framebuffer = worker->target.swapChainFramebuffers[0];
+    renderPassInfo.renderArea.extent = extent;
+
+    VkClearValue clearValues[2] = { 0 };
+    clearValues[0].color.float32[3] = 1.0f;
+    clearValues[1].depthStencil.depth = 0.0f;
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = { 0 };
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = { 0 };
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (count > 0) {
+        struct sl_mesh *mesh = &oo->mesh;
+        VkBuffer buffers[2] = { worker->instanceBuffer, mesh->buffer };
+        VkDeviceSize offsets[2] = { 0, mesh->vertexOffset };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, mesh->buffer, mesh->indexOffset,
+                             mesh->indexType);
+        vkCmdPushConstants(commandBuffer, oo->pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           sizeof(mesh->decode), &mesh->decode);
+        /* nothing is latched here, slot 0 stays zero */
+        bindLatch(oo, commandBuffer, 0);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          worker->batch->pipelines[job->colorMode]);
+        recordPipelineState(oo, commandBuffer, &worker->batch->key);
+        /* one image, there is no frame rate to buy with the lower
+           levels */
+        vkCmdDrawIndexed(commandBuffer, mesh->lods[0].indexCount, count,
+                         mesh->lods[0].firstIndex, 0, 0);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    recordReadbackCopy(oo, commandBuffer, worker->target.swapChainImages[0],
+                       &worker->readback);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        error_log("failed to record command buffer!");
+        exit(1);
+    }
+}
+
+static void submitJob(struct batch_worker *worker) {
+    struct batch *batch = worker->batch;
+    struct sl_oo *oo = batch->oo;
+
+    VkSubmitInfo submitInfo = { 0 };
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &worker->commandBuffer;
+
+    pthread_mutex_lock(&batch->queueLock);
+    VkResult result =
+        vkQueueSubmit(oo->graphicsQueue, 1, &submitInfo, worker->fence);
+    pthread_mutex_unlock(&batch->queueLock);
+    if (result != VK_SUCCESS) {
+        error_log("failed to submit batch job!");
+        exit(1);
+    }
+}
+
+/* the worker waits for its own fence before encoding, the other workers
+   keep the gpu busy meanwhile */
+static void renderJob(struct batch_worker *worker,
+                      const struct batch_job *job) {
+    struct sl_oo *oo = worker->batch->oo;
+    TRACE_ZONE(oo, "batch job");
+
+    uint32_t count = job->instances < worker->batch->instanceCapacity
+                         ? job->instances
+                         : worker->batch->instanceCapacity;
+    if (count > 0) {
+        scatterInstances(worker->scratch, count, job->seed);
+        memcpy(worker->instances, worker->scratch,
+               sizeof(struct sl_instance) * count);
+    }
+
+    vkResetCommandPool(oo->device, worker->commandPool, 0);
+    recordJob(worker, job, count);
+    submitJob(worker);
+
+    struct sl_trace_zone zone = traceZoneBegin(oo, "wait for fence");
+    vkWaitForFences(oo->device, 1, &worker->fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(oo->device, 1, &worker->fence);
+    traceZoneEnd(&zone);
+
+    memcpy(worker->readback.path, job->path, sizeof(job->path));
+    encodeReadback(oo, &worker->readback);
+    worker->rendered++;
+}
+
+static void *batchWorker(void *arg) {
+    struct batch_worker *worker = arg;
+    traceThreadName(worker->batch->oo, "batch worker");
+
+    uint32_t job;
+    while (nextJob(worker, &job)) {
+        renderJob(worker, &worker->batch->jobs[job]);
+    }
+    return NULL;
+}
+
+/* everything a worker owns is made up front on the main thread, the
+   memory budget is not counted from several threads */
+static void createWorker(struct batch *batch, struct batch_worker *worker) {
+    struct sl_oo *oo = batch->oo;
+    TRACE_ZONE(oo, "createWorker");
+
+    struct QueueFamilyIndices indices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+    VkCommandPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = indices.graphicsFamily;
+    if (vkCreateCommandPool(oo->device, &poolInfo,
+                            hostAllocator(oo, ALLOC_COMMANDS),
+                            &worker->commandPool) != VK_SUCCESS) {
+        error_log("failed to create command pool!");
+        exit(1);
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = worker->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(oo->device, &allocInfo,
+                                 &worker->commandBuffer) != VK_SUCCESS) {
+        error_log("failed to allocate command buffers!");
+        exit(1);
+    }
+
+    VkFenceCreateInfo fenceInfo = { 0 };
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(oo->device, &fenceInfo, hostAllocator(oo, ALLOC_SYNC),
+                      &worker->fence) != VK_SUCCESS) {
+        error_log("failed to create fence!");
+        exit(1);
+    }
+
+    createOffscreenTarget(oo, &worker->target);
+
+    VkDeviceSize instanceSize =
+        sizeof(struct sl_instance) * batch->instanceCapacity;
+    createBuffer(oo, instanceSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &worker->instanceBuffer, &worker->instanceBufferMemory);
+    vkMapMemory(oo->device, worker->instanceBufferMemory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&worker->instances);
+    worker->scratch = malloc(instanceSize);
+    if (worker->scratch == NULL) {
+        error_log("failed to allocate instance scratch!");
+        exit(1);
+    }
+
+    VkExtent2D extent = worker->target.swapChainExtent;
+    createReadback(oo, &worker->readback,
+                   (VkDeviceSize)extent.width * extent.height * 4,
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    worker->readback.extent = extent;
+    worker->readback.format = worker->target.swapChainImageFormat;
+}
+
+static void destroyWorker(struct batch *batch, struct batch_worker *worker) {
+    struct sl_oo *oo = batch->oo;
+
+    destroyReadback(oo, &worker->readback);
+    free(worker->scratch);
+    vkUnmapMemory(oo->device, worker->instanceBufferMemory);
+    vkDestroyBuffer(oo->device, worker->instanceBuffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, worker->instanceBufferMemory);
+    destroyOffscreenTarget(oo, &worker->target);
+    vkDestroyFence(oo->device, worker->fence, hostAllocator(oo, ALLOC_SYNC));
+    vkDestroyCommandPool(oo->device, worker->commandPool,
+                         hostAllocator(oo, ALLOC_COMMANDS));
+}
+
+/****** main thread */
+
+static void createBatch(struct sl_oo *oo, struct batch *batch,
+                        uint32_t workerCount) {
+    TRACE_ZONE(oo, "createBatch");
+
+    batch->oo = oo;
+    if (batch->instanceCapacity == 0) {
+        batch->instanceCapacity = 1;
+    }
+
+    /* the workers only read the variants, the cache behind them is
+       shared with every other pipeline */
+    batch->key = pipelineKeyDefault(oo);
+    batch->key.shaders = oo->pipelines.generation;
+    for (uint32_t i = 0; i < COLOR_MODE_COUNT; i++) {
+        struct sl_pipeline_key key = batch->key;
+        key.spec[SPEC_COLOR_MODE] = i;
+        batch->pipelines[i] = waitForPipeline(oo, &key);
+    }
+
+    if (workerCount > batch->jobCount) {
+        workerCount = batch->jobCount;
+    }
+    batch->workerCount = workerCount;
+
+    /* every worker maps its own instance buffer, fewer instances rather
+       than running out of memory, the jobs are clamped to the capacity */
+    uint32_t wanted = batch->instanceCapacity;
+    while (batch->instanceCapacity > 1 &&
+           !memoryFits(oo,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                       sizeof(struct sl_instance) * batch->instanceCapacity *
+                           workerCount)) {
+        batch->instanceCapacity /= 2;
+    }
+    if (batch->instanceCapacity < wanted) {
+        error_log("only %u of %u instances fit in the memory budget",
+                  batch->instanceCapacity, wanted);
+    }
+    pthread_mutex_init(&batch->queueLock, NULL);
+    batch->workers = calloc(workerCount, sizeof(struct batch_worker));
+    batch->deques = calloc(workerCount, sizeof(struct batch_deque));
+
+    /* contiguous shares, stealing evens out jobs of different cost */
+    for (uint32_t i = 0; i < workerCount; i++) {
+        uint64_t head = (uint64_t)batch->jobCount * i / workerCount;
+        uint64_t tail = (uint64_t)batch->jobCount * (i + 1) / workerCount;
+        batch->deques[i].range = head << 32 | tail;
+
+        struct batch_worker *worker = &batch->workers[i];
+        worker->batch = batch;
+        worker->index = i;
+        createWorker(batch, worker);
+    }
+}
+
+static void runBatch(struct batch *batch) {
+    for (uint32_t i = 0; i < batch->workerCount; i++) {
+        if (pthread_create(&batch->workers[i].thread, NULL, batchWorker,
+                           &batch->workers[i]) != 0) {
+            error_log("failed to start batch worker!");
+            exit(1);
+        }
+    }
+    for (uint32_t i = 0; i < batch->workerCount; i++) {
+        pthread_join(batch->workers[i].thread, NULL);
+    }
+}
+
+static void destroyBatch(struct batch *batch) {
+    for (uint32_t i = 0; i < batch->workerCount; i++) {
+        destroyWorker(batch, &batch->workers[i]);
+    }
+    free(batch->deques);
+    free(batch->workers);
+    pthread_mutex_destroy(&batch->queueLock);
+    free(batch->jobs);
+}
+
+static void usage(const char *name) {
+    error_log("usage: %s [--workers N] [--size WxH] "
+              "[--device index|name|uuid] [--msaa=1|2|4|8] "
+              "[--trace file.json] [--mesh file.slm] "
+              "[--validation=off|error|warning|info|verbose] jobs.txt|-",
+              name);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct sl_oo oo = { 0 };
+    oo.headless = true;
+    oo.targetCount = 1;
+    oo.headlessExtent.width = WIDTH;
+    oo.headlessExtent.height = HEIGHT;
+    oo.deviceSelector = getenv(DEVICE_ENV);
+    oo.msaaSamples = MSAA_SAMPLES;
+    oo.alloc.enabled = HOST_ALLOCATOR;
+    oo.pipelines.dynamic.enabled = PIPELINE_DYNAMIC_STATE;
+    validationLevel = VALIDATION_OFF;
+
+    uint32_t workerCount = BATCH_WORKERS;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0 && cores < workerCount) {
+        workerCount = (uint32_t)cores;
+    }
+
+    const char *jobsPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            char *end = NULL;
+            unsigned long n = strtoul(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || n == 0) {
+                usage(argv[0]);
+            }
+            if (n > BATCH_MAX_WORKERS) {
+                error_log("--workers %lu is more than %d, using %d", n,
+                          BATCH_MAX_WORKERS, BATCH_MAX_WORKERS);
+                n = BATCH_MAX_WORKERS;
+            }
+            workerCount = (uint32_t)n;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &oo.headlessExtent.width,
+                       &oo.headlessExtent.height) != 2) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            oo.deviceSelector = argv[++i];
+        } else if (strncmp(argv[i], "--msaa=", 7) == 0) {
+            oo.msaaSamples = (uint32_t)strtoul(argv[i] + 7, NULL, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            oo.trace.path = argv[++i];
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            oo.meshPath = argv[++i];
+        } else if (strncmp(argv[i], "--validation=", 13) == 0) {
+            if (!parseValidationLevel(argv[i] + 13, &validationLevel)) {
+                usage(argv[0]);
+            }
+        } else if (jobsPath == NULL &&
+                   (argv[i][0] != '-' || strcmp(argv[i], "-") == 0)) {
+            jobsPath = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (jobsPath == NULL || workerCount == 0 ||
+        oo.headlessExtent.width == 0 || oo.headlessExtent.height == 0) {
+        usage(argv[0]);
+    }
+
+    enableValidationLayers = validationLevel != VALIDATION_OFF;
+    if (enableValidationLayers) {
+        log_init();
+    }
+
+    struct batch batch = { 0 };
+    readJobs(&batch, jobsPath);
+    if (batch.jobCount == 0) {
+        error_log("no jobs in %s", jobsPath);
+        return 1;
+    }
+
+    /* the same setup as the benchmark, the workers only add their own
+       targets next to it */
+    createTrace(&oo);
+    createHostAllocator(&oo);
+    createInstance(&oo);
+    setupDebugMessenger(&oo);
+    pickPhysicalDevice(&oo);
+    createLogicalDevice(&oo);
+    createSwapChain(&oo);
+    createImageViews(&oo);
+    createColorResources(&oo);
+    createDepthResources(&oo);
+    createRenderPass(&oo);
+    createGraphicsPipeline(&oo);
+    createFramebuffers(&oo);
+    createCommandPool(&oo);
+    createCommandBuffer(&oo);
+    createMesh(&oo);
+    createInstanceBuffer(&oo);
+    createSyncObjects(&oo);
+
+    createBatch(&oo, &batch, workerCount);
+
+    double start = nowMs();
+    runBatch(&batch);
+    double seconds = (nowMs() - start) / 1000.0;
+
+    uint32_t stolen = 0;
+    for (uint32_t i = 0; i < batch.workerCount; i++) {
+        stolen += batch.workers[i].stolen;
+    }
+    fprintf(stderr,
+            "%u images in %.2f s with %u workers, %.0f per hour, %u "
+            "stolen\n",
+            batch.jobCount, seconds, batch.workerCount,
+            seconds > 0.0 ? batch.jobCount * 3600.0 / seconds : 0.0,
+            stolen);
+
+    vkDeviceWaitIdle(oo.device);
+    destroyBatch(&batch);
+    cleanUp(&oo);
+    return 0;
+}
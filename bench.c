@@ -0,0 +1,386 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "log.h"
+
+#include <math.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* renders a few fixed scenarios offscreen and prints the results as
+   json on stdout, so two builds can be compared with a plain diff.
+   point VK_DRIVER_FILES at lavapipe (or use --device llvmpipe) to run it
+   on a machine without a gpu. */
+
+struct bench_scenario {
+    const char *name;
+    /* 0 only clears */
+    uint32_t instanceCount;
+    /* frames between two resizes, 0 never resizes */
+    uint32_t resizeInterval;
+    /* quads pushed every frame, with random keys */
+    uint32_t spriteCount;
+    /* sweep the camera sideways, so part of the instances are culled */
+    bool pan;
+};
+
+struct bench_result {
+    const char *name;
+    uint32_t frames;
+    double wallMs;
+    double cpuMs;
+    double frameMs[4]; /* p50 p90 p99 max */
+    double gpuMs[3]; /* mean p50 p99 */
+    uint32_t gpuSamples;
+    long peakRssKb;
+    /* through the VkAllocationCallbacks, 0 once nothing churns */
+    uint64_t hostAllocations;
+    /* device local heaps, what the driver or our own counting says */
+    VkDeviceSize peakMemoryUsage;
+    VkDeviceSize memoryBudget;
+    bool memoryPressure;
+    /* instanced draws the sprites took in the last frame */
+    uint32_t spriteDraws;
+    /* mean over the measured frames */
+    double visibleInstances;
+    double drawnInstances;
+};
+
+/* sizes cycled through by the resize scenario */
+static const VkExtent2D resizeExtents[] = {
+    { 1280, 720 }, { 640, 480 }, { 1920, 1080 }, { 800, 600 }
+};
+
+double cpu_ms() {
+    /* all threads of the process, so driver threads are included */
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1e3 +
+           usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1e3;
+}
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    /* bytes on macOS, kilobytes everywhere else */
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/* the same quads every run, spread over every layer and blend mode */
+void pushBenchSprites(struct sl_oo *oo, uint32_t count, uint32_t frame) {
+    uint32_t seed = 12345;
+    float uv[SPRITE_SHAPE_COUNT][4];
+    for (int shape = 0; shape < SPRITE_SHAPE_COUNT; shape++) {
+        spriteShapeUV((enum SpriteShape)shape, uv[shape]);
+    }
+
+    VkExtent2D extent = oo->targets[0].swapChainExtent;
+    clearSprites(oo);
+    for (uint32_t i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint32_t key = (seed >> 8) % SPRITE_KEY_COUNT;
+        float rect[4] = {
+            (float)((seed >> 4) % extent.width),
+            (float)((seed >> 12) % extent.height + frame % 8),
+            8.0f + (seed >> 20) % 24,
+            8.0f + (seed >> 24) % 24,
+        };
+        pushSprite(oo, key, rect, uv[(seed >> 28) % SPRITE_SHAPE_COUNT],
+                   SPRITE_RGBA(seed & 0xff, seed >> 8 & 0xff, 192, 160));
+    }
+}
+
+void runScenario(struct sl_oo *oo, const struct bench_scenario *scenario,
+                 uint32_t frames, struct bench_result *result) {
+    double *frameTimes = malloc(sizeof(double) * frames);
+    double *gpuTimes = malloc(sizeof(double) * frames);
+    uint32_t gpuCount = 0;
+    double gpuTotal = 0.0;
+    uint64_t visibleTotal = 0;
+    uint64_t drawnTotal = 0;
+
+    oo->instanceCount = scenario->instanceCount;
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+        pushBenchSprites(oo, scenario->spriteCount, i);
+        drawFrame(oo);
+    }
+    vkDeviceWaitIdle(oo->device);
+
+    double cpuStart = cpu_ms();
+    double wallStart = nowMs();
+    uint64_t allocStart = hostAllocationCount(oo);
+
+    for (uint32_t i = 0; i < frames; i++) {
+        double start = nowMs();
+
+        if (scenario->resizeInterval > 0 && i > 0 &&
+            i % scenario->resizeInterval == 0) {
+            int n = sizeof(resizeExtents) / sizeof(VkExtent2D);
+            int next = (i / scenario->resizeInterval) % n;
+            oo->headlessExtent = resizeExtents[next];
+            recreateSwapChain(oo);
+        }
+
+        /* part of the frame, like it would be in an application */
+        pushBenchSprites(oo, scenario->spriteCount, i);
+        if (scenario->pan) {
+            oo->camera[0] = sinf(i * 0.01f) * SCENE_DEPTH * 0.5f;
+        }
+
+        /* the gpu time drawFrame reports belongs to an older frame */
+        oo->stats.gpuFrameValid = false;
+        drawFrame(oo);
+
+        frameTimes[i] = nowMs() - start;
+        visibleTotal += oo->stats.visibleInstances;
+        drawnTotal += oo->stats.drawnInstances;
+        if (oo->stats.memoryUsage > result->peakMemoryUsage) {
+            result->peakMemoryUsage = oo->stats.memoryUsage;
+        }
+        result->memoryPressure |= oo->stats.memoryPressure;
+        if (oo->stats.gpuFrameValid) {
+            gpuTimes[gpuCount++] = oo->stats.gpuFrameMs;
+            gpuTotal += oo->stats.gpuFrameMs;
+        }
+    }
+    vkDeviceWaitIdle(oo->device);
+
+    result->name = scenario->name;
+    result->frames = frames;
+    result->wallMs = nowMs() - wallStart;
+    result->cpuMs = cpu_ms() - cpuStart;
+    result->frameMs[0] = percentile(frameTimes, frames, 0.50);
+    result->frameMs[1] = percentile(frameTimes, frames, 0.90);
+    result->frameMs[2] = percentile(frameTimes, frames, 0.99);
+    /* percentile left frameTimes sorted */
+    result->frameMs[3] = frameTimes[frames - 1];
+    result->gpuSamples = gpuCount;
+    result->gpuMs[0] = gpuCount > 0 ? gpuTotal / gpuCount : 0.0;
+    result->gpuMs[1] = percentile(gpuTimes, gpuCount, 0.50);
+    result->gpuMs[2] = percentile(gpuTimes, gpuCount, 0.99);
+    result->peakRssKb = peak_rss_kb();
+    result->hostAllocations = hostAllocationCount(oo) - allocStart;
+    result->memoryBudget = oo->stats.memoryBudget;
+    result->spriteDraws = oo->sprites.draws;
+    result->visibleInstances = (double)visibleTotal / frames;
+    result->drawnInstances = (double)drawnTotal / frames;
+    clearSprites(oo);
+    oo->camera[0] = 0.0f;
+
+    /* put the default size back for the next scenario */
+    if (oo->targets[0].swapChainExtent.width != WIDTH ||
+        oo->targets[0].swapChainExtent.height != HEIGHT) {
+        oo->headlessExtent.width = WIDTH;
+        oo->headlessExtent.height = HEIGHT;
+        recreateSwapChain(oo);
+    }
+
+    free(frameTimes);
+    free(gpuTimes);
+}
+
+void printJsonString(const char *s) {
+    putchar('"');
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)*s >= 0x20) {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+void printResults(struct sl_oo *oo, struct bench_result *results, int count) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+
+    printf("{\n");
+    printf("  \"device\": ");
+    printJsonString(properties.deviceName);
+    printf(",\n");
+    printf("  \"device_type\": \"%s\",\n",
+           deviceTypeName(properties.deviceType));
+    printf("  \"driver_version\": %u,\n", properties.driverVersion);
+    printf("  \"width\": %d,\n", WIDTH);
+    printf("  \"height\": %d,\n", HEIGHT);
+    printf("  \"msaa_samples\": %u,\n", oo->msaaSamples);
+    printf("  \"depth_prepass\": %s,\n",
+           oo->depthPrepass ? "true" : "false");
+    printf("  \"occlusion\": %s,\n", oo->occlusion.active ? "true" : "false");
+    printf("  \"gpu_timing\": %s,\n", oo->gpuTiming ? "true" : "false");
+    printf("  \"memory_budget\": \"%s\",\n",
+           oo->budget.extension ? "VK_EXT_memory_budget" : "heap size");
+    printf("  \"mesh_triangles\": %u,\n", oo->mesh.indexCount / 3);
+    printf("  \"scenarios\": [\n");
+    for (int i = 0; i < count; i++) {
+        struct bench_result *r = &results[i];
+        printf("    {\n");
+        printf("      \"name\": \"%s\",\n", r->name);
+        printf("      \"frames\": %u,\n", r->frames);
+        printf("      \"fps\": %.2f,\n", r->frames * 1000.0 / r->wallMs);
+        printf("      \"frame_ms\": { \"p50\": %.4f, \"p90\": %.4f, "
+               "\"p99\": %.4f, \"max\": %.4f },\n",
+               r->frameMs[0], r->frameMs[1], r->frameMs[2], r->frameMs[3]);
+        printf("      \"cpu_ms_per_frame\": %.4f,\n", r->cpuMs / r->frames);
+        printf("      \"gpu_ms\": { \"mean\": %.4f, \"p50\": %.4f, "
+               "\"p99\": %.4f, \"samples\": %u },\n",
+               r->gpuMs[0], r->gpuMs[1], r->gpuMs[2], r->gpuSamples);
+        printf("      \"peak_rss_kb\": %ld,\n", r->peakRssKb);
+        printf("      \"host_allocs_per_frame\": %.4f,\n",
+               (double)r->hostAllocations / r->frames);
+        printf("      \"device_memory_mib\": { \"peak\": %.1f, "
+               "\"budget\": %.1f, \"pressure\": %s },\n",
+               r->peakMemoryUsage / 1048576.0, r->memoryBudget / 1048576.0,
+               r->memoryPressure ? "true" : "false");
+        printf("      \"sprite_draws\": %u,\n", r->spriteDraws);
+        printf("      \"visible_instances\": %.1f,\n", r->visibleInstances);
+        printf("      \"drawn_instances\": %.1f\n", r->drawnInstances);
+        printf("    }%s\n", i + 1 < count ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+void usage(const char *name) {
+    error_log("usage: %s [--frames N] [--instances N] [--sprites N] "
+              "[--scenario name] "
+              "[--device index|name|uuid] [--msaa=1|2|4|8] "
+              "[--depth-prepass] [--occlusion] [--no-dynamic-state] "
+              "[--trace file.json] [--mesh file.slm] "
+              "[--validation=off|error|warning|info|verbose]",
+              name);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct sl_bench_options {
+        uint32_t frames;
+        uint32_t instances;
+        uint32_t sprites;
+        const char *scenario;
+    } options = { BENCH_FRAMES, BENCH_INSTANCES, BENCH_SPRITES, NULL };
+
+    struct sl_oo oo = { 0 };
+    oo.headless = true;
+    oo.targetCount = 1;
+    oo.headlessExtent.width = WIDTH;
+    oo.headlessExtent.height = HEIGHT;
+    oo.deviceSelector = getenv(DEVICE_ENV);
+    oo.msaaSamples = MSAA_SAMPLES;
+    oo.depthPrepass = DEPTH_PREPASS;
+    oo.occlusion.enabled = OCCLUSION_CULLING;
+    oo.alloc.enabled = HOST_ALLOCATOR;
+    oo.pipelines.dynamic.enabled = PIPELINE_DYNAMIC_STATE;
+
+    /* validation skews every number, only enable it on request */
+    validationLevel = VALIDATION_OFF;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            if (!parseNumber(argv[++i], MAX_INSTANCES, &options.instances) ||
+                options.instances == 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+            options.sprites = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            options.scenario = argv[++i];
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            oo.deviceSelector = argv[++i];
+        } else if (strncmp(argv[i], "--msaa=", 7) == 0) {
+            oo.msaaSamples = (uint32_t)strtoul(argv[i] + 7, NULL, 10);
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            oo.depthPrepass = true;
+        } else if (strcmp(argv[i], "--occlusion") == 0) {
+            oo.occlusion.enabled = true;
+        } else if (strcmp(argv[i], "--no-dynamic-state") == 0) {
+            oo.pipelines.dynamic.enabled = false;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            oo.trace.path = argv[++i];
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            oo.meshPath = argv[++i];
+        } else if (strncmp(argv[i], "--validation=", 13) == 0) {
+            if (!parseValidationLevel(argv[i] + 13, &validationLevel)) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (options.frames == 0) {
+        usage(argv[0]);
+    }
+
+    enableValidationLayers = validationLevel != VALIDATION_OFF;
+    if (enableValidationLayers) {
+        log_init();
+    }
+
+    const struct bench_scenario scenarios[] = {
+        { "clear", 0, 0, 0, false },
+        { "triangle", 1, 0, 0, false },
+        { "instances", options.instances, 0, 0, false },
+        { "resize", 1, BENCH_RESIZE_INTERVAL, 0, false },
+        { "sprites", 1, 0, options.sprites, false },
+        { "culling", options.instances, 0, 0, true },
+    };
+    int scenarioCount = sizeof(scenarios) / sizeof(struct bench_scenario);
+
+    createTrace(&oo);
+    createHostAllocator(&oo);
+    createInstance(&oo);
+    setupDebugMessenger(&oo);
+    pickPhysicalDevice(&oo);
+    createLogicalDevice(&oo);
+    createOcclusion(&oo);
+    createSwapChain(&oo);
+    createImageViews(&oo);
+    createColorResources(&oo);
+    createDepthResources(&oo);
+    createRenderPass(&oo);
+    createGraphicsPipeline(&oo);
+    createFramebuffers(&oo);
+    createCommandPool(&oo);
+    createCommandBuffer(&oo);
+    createFrameDescriptors(&oo);
+    createMesh(&oo);
+    /* room for the largest scenario */
+    oo.instanceCount = options.instances > 1 ? options.instances : 1;
+    createInstanceBuffer(&oo);
+    createSyncObjects(&oo);
+    createQueryPool(&oo);
+    createSprites(&oo);
+
+    struct bench_result results[sizeof(scenarios) /
+                                sizeof(struct bench_scenario)] = { 0 };
+    int resultCount = 0;
+    for (int i = 0; i < scenarioCount; i++) {
+        if (options.scenario != NULL &&
+            strcmp(options.scenario, scenarios[i].name) != 0) {
+            continue;
+        }
+        fprintf(stderr, "running %s\n", scenarios[i].name);
+        runScenario(&oo, &scenarios[i], options.frames,
+                    &results[resultCount++]);
+    }
+
+    if (resultCount == 0) {
+        error_log("unknown scenario %s", options.scenario);
+        exit(1);
+    }
+
+    printResults(&oo, results, resultCount);
+
+    vkDeviceWaitIdle(oo.device);
+    cleanUp(&oo);
+    return 0;
+}
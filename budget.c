@@ -0,0 +1,184 @@
+#include "renderer.h"
+#include "budget.h"
+
+void createMemoryBudget(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createMemoryBudget");
+
+    struct sl_budget *budget = &oo->budget;
+    pthread_mutex_init(&budget->lock, NULL);
+    budget->allocationCapacity = BUDGET_INITIAL_ALLOCATIONS;
+    budget->allocations = malloc(sizeof(struct sl_budget_allocation) *
+                                 budget->allocationCapacity);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(oo->physicalDevice, &memProperties);
+
+    budget->heapCount = memProperties.memoryHeapCount;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        budget->heapFlags[i] = memProperties.memoryHeaps[i].flags;
+        budget->heapSize[i] = memProperties.memoryHeaps[i].size;
+    }
+    budget->typeCount = memProperties.memoryTypeCount;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        budget->typeHeap[i] = memProperties.memoryTypes[i].heapIndex;
+        budget->typeFlags[i] = memProperties.memoryTypes[i].propertyFlags;
+    }
+
+    updateMemoryBudget(oo);
+}
+
+void destroyMemoryBudget(struct sl_oo *oo) {
+    struct sl_budget *budget = &oo->budget;
+    if (budget->allocations == NULL) {
+        return;
+    }
+    free(budget->allocations);
+    budget->allocations = NULL;
+    pthread_mutex_destroy(&budget->lock);
+}
+
+/* one call into the driver and a loop over at most 16 heaps */
+void updateMemoryBudget(struct sl_oo *oo) {
+    struct sl_budget *budget = &oo->budget;
+
+    if (budget->extension) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = { 0 };
+        budgetProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memProperties = { 0 };
+        memProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memProperties.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(oo->physicalDevice,
+                                             &memProperties);
+
+        /* the batch and capture threads allocate meanwhile */
+        pthread_mutex_lock(&budget->lock);
+        for (uint32_t i = 0; i < budget->heapCount; i++) {
+            budget->budget[i] = budgetProperties.heapBudget[i];
+            budget->usage[i] = budgetProperties.heapUsage[i];
+        }
+    } else {
+        pthread_mutex_lock(&budget->lock);
+        for (uint32_t i = 0; i < budget->heapCount; i++) {
+            budget->budget[i] =
+                budget->heapSize[i] / 100 * BUDGET_FALLBACK_SHARE;
+            budget->usage[i] = budget->allocated[i];
+        }
+    }
+
+    /* any heap counts, on a discrete gpu the readbacks live in system
+       memory and run out there */
+    bool high = false;
+    bool low = true;
+    VkDeviceSize deviceBudget = 0;
+    VkDeviceSize deviceUsage = 0;
+    for (uint32_t i = 0; i < budget->heapCount; i++) {
+        VkDeviceSize limit = budget->budget[i] / 100;
+        if (budget->usage[i] > limit * BUDGET_HIGH_WATER) {
+            high = true;
+        }
+        if (budget->usage[i] > limit * BUDGET_LOW_WATER) {
+            low = false;
+        }
+        if (budget->heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            deviceBudget += budget->budget[i];
+            deviceUsage += budget->usage[i];
+        }
+    }
+    /* evicting frees memory, which takes the lock again */
+    pthread_mutex_unlock(&budget->lock);
+
+    if (!budget->pressure && high) {
+        budget->pressure = true;
+        budget->pressureEvents++;
+        error_log("device memory close to the budget, %llu of %llu MiB "
+                  "used, releasing what is not needed",
+                  (unsigned long long)(deviceUsage >> 20),
+                  (unsigned long long)(deviceBudget >> 20));
+        evictCaptureBuffers(oo);
+    } else if (budget->pressure && low) {
+        budget->pressure = false;
+    }
+
+    oo->stats.memoryBudget = deviceBudget;
+    oo->stats.memoryUsage = deviceUsage;
+    oo->stats.memoryPressure = budget->pressure;
+}
+
+VkResult allocateDeviceMemory(struct sl_oo *oo,
+                              const VkMemoryAllocateInfo *allocInfo,
+                              VkDeviceMemory *memory) {
+    struct sl_budget *budget = &oo->budget;
+
+    VkResult result = vkAllocateMemory(oo->device, allocInfo,
+                                       hostAllocator(oo, ALLOC_MEMORY),
+                                       memory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    pthread_mutex_lock(&budget->lock);
+    /* every window, worker and pyramid adds a few, none goes untracked */
+    if (budget->allocationCount == budget->allocationCapacity) {
+        budget->allocationCapacity *= 2;
+        budget->allocations =
+            realloc(budget->allocations, sizeof(struct sl_budget_allocation) *
+                                             budget->allocationCapacity);
+    }
+    uint32_t heap = budget->typeHeap[allocInfo->memoryTypeIndex];
+    struct sl_budget_allocation *allocation =
+        &budget->allocations[budget->allocationCount++];
+    allocation->memory = *memory;
+    allocation->size = allocInfo->allocationSize;
+    allocation->heap = heap;
+    budget->allocated[heap] += allocation->size;
+    /* the driver only reports it with the next update, memoryFits should
+       see it right away */
+    budget->usage[heap] += allocation->size;
+    pthread_mutex_unlock(&budget->lock);
+    return result;
+}
+
+void freeDeviceMemory(struct sl_oo *oo, VkDeviceMemory memory) {
+    struct sl_budget *budget = &oo->budget;
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    pthread_mutex_lock(&budget->lock);
+    for (uint32_t i = 0; i < budget->allocationCount; i++) {
+        struct sl_budget_allocation *allocation = &budget->allocations[i];
+        if (allocation->memory != memory) {
+            continue;
+        }
+        budget->allocated[allocation->heap] -= allocation->size;
+        if (budget->usage[allocation->heap] >= allocation->size) {
+            budget->usage[allocation->heap] -= allocation->size;
+        }
+        *allocation = budget->allocations[--budget->allocationCount];
+        break;
+    }
+    pthread_mutex_unlock(&budget->lock);
+
+    vkFreeMemory(oo->device, memory, hostAllocator(oo, ALLOC_MEMORY));
+}
+
+bool memoryFits(struct sl_oo *oo, VkMemoryPropertyFlags properties,
+                VkDeviceSize size) {
+    struct sl_budget *budget = &oo->budget;
+
+    for (uint32_t i = 0; i < budget->typeCount; i++) {
+        if ((budget->typeFlags[i] & properties) != properties) {
+            continue;
+        }
+        uint32_t heap = budget->typeHeap[i];
+        pthread_mutex_lock(&budget->lock);
+        bool fits = budget->usage[heap] + size <=
+                    budget->budget[heap] / 100 * BUDGET_HIGH_WATER;
+        pthread_mutex_unlock(&budget->lock);
+        return fits;
+    }
+    /* nothing has these properties, the allocation fails anyway */
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* device memory, against what the driver says we may use. with
+   VK_EXT_memory_budget the budget and usage of every heap come from the
+   driver and include other processes, without it the budget is a share of
+   the heap size and the usage is what we allocated ourselves. memory
+   nobody needs right now is dropped when usage gets close to the budget,
+   instead of running into VK_ERROR_OUT_OF_DEVICE_MEMORY. */
+
+struct sl_oo;
+
+struct sl_budget {
+    /* VK_EXT_memory_budget is enabled on the device */
+    bool extension;
+
+    uint32_t heapCount;
+    VkMemoryHeapFlags heapFlags[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapSize[VK_MAX_MEMORY_HEAPS];
+    /* of every memory type */
+    uint32_t typeHeap[VK_MAX_MEMORY_TYPES];
+    VkMemoryPropertyFlags typeFlags[VK_MAX_MEMORY_TYPES];
+    uint32_t typeCount;
+
+    /* refreshed by updateMemoryBudget, allocations add to usage right
+       away. both under lock */
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+
+    /* every vkAllocateMemory of ours, to know the size again on free.
+       grows by doubling, the batch workers allocate too, so it is locked */
+    pthread_mutex_t lock;
+    struct sl_budget_allocation {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t heap;
+    } *allocations;
+    uint32_t allocationCount;
+    uint32_t allocationCapacity;
+    VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+
+    /* a heap went over BUDGET_HIGH_WATER and not every heap is back
+       under BUDGET_LOW_WATER yet */
+    bool pressure;
+    uint32_t pressureEvents;
+};
+
+/* createLogicalDevice calls this once the device exists */
+void createMemoryBudget(struct sl_oo *oo);
+/* after the device, every allocation is gone by then */
+void destroyMemoryBudget(struct sl_oo *oo);
+/* once per frame after the fence wait, fills in oo->stats */
+void updateMemoryBudget(struct sl_oo *oo);
+
+/* vkAllocateMemory and vkFreeMemory, counted against the heap */
+VkResult allocateDeviceMemory(struct sl_oo *oo,
+                              const VkMemoryAllocateInfo *allocInfo,
+                              VkDeviceMemory *memory);
+void freeDeviceMemory(struct sl_oo *oo, VkDeviceMemory memory);
+
+/* whether size more bytes of memory with these properties keep the heap
+   under BUDGET_HIGH_WATER */
+bool memoryFits(struct sl_oo *oo, VkMemoryPropertyFlags properties,
+                VkDeviceSize size);
+
+#endif /* BUDGET_H */
@@ -0,0 +1,539 @@
+#include "renderer.h"
+#include "capture.h"
+
+/* only 8 bit rgba/bgra swapchains can be written out as is */
+bool isCapturableFormat(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isBGRA(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB ||
+           format == VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+void createReadback(struct sl_oo *oo, struct sl_readback *readback,
+                    VkDeviceSize size, VkBufferUsageFlags usage) {
+    TRACE_ZONE(oo, "createReadback");
+
+    VkBufferCreateInfo bufferInfo = { 0 };
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(oo->device, &bufferInfo,
+                       hostAllocator(oo, ALLOC_BUFFERS),
+                       &readback->buffer) != VK_SUCCESS) {
+        error_log("failed to create readback buffer!");
+        exit(1);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(oo->device, readback->buffer,
+                                  &memRequirements);
+
+    /* cached memory makes the cpu reads fast, it is usually not coherent
+       so the worker invalidates before reading */
+    VkMemoryAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    readback->coherent = false;
+    if (!tryFindMemoryType(oo->physicalDevice, memRequirements.memoryTypeBits,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                           &allocInfo.memoryTypeIndex)) {
+        allocInfo.memoryTypeIndex =
+            findMemoryType(oo->physicalDevice, memRequirements.memoryTypeBits,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        readback->coherent = true;
+    }
+
+    if (allocateDeviceMemory(oo, &allocInfo, &readback->memory) !=
+        VK_SUCCESS) {
+        error_log("failed to allocate readback memory!");
+        exit(1);
+    }
+
+    vkBindBufferMemory(oo->device, readback->buffer, readback->memory, 0);
+    vkMapMemory(oo->device, readback->memory, 0, VK_WHOLE_SIZE, 0,
+                &readback->mapped);
+    readback->size = size;
+    readback->state = READBACK_FREE;
+}
+
+void destroyReadback(struct sl_oo *oo, struct sl_readback *readback) {
+    if (readback->buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    vkUnmapMemory(oo->device, readback->memory);
+    vkDestroyBuffer(oo->device, readback->buffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, readback->memory);
+    readback->buffer = VK_NULL_HANDLE;
+}
+
+/****** encoders, worker threads only */
+
+static uint32_t crcTable[256];
+/* by whichever encoder gets there first */
+static pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+static void makeCrcTable(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+}
+
+static uint32_t crc(uint32_t c, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        c = crcTable[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    }
+    return c;
+}
+
+static void putBE32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void writeChunk(FILE *fp, const char *type, const uint8_t *data,
+                       uint32_t size) {
+    uint8_t header[8];
+    putBE32(header, size);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, fp);
+    fwrite(data, 1, size, fp);
+
+    uint32_t c = crc(0xffffffffu, header + 4, 4);
+    c = crc(c, data, size) ^ 0xffffffffu;
+    uint8_t trailer[4];
+    putBE32(trailer, c);
+    fwrite(trailer, 1, 4, fp);
+}
+
+/* rgb rows in, an uncompressed png out. stored deflate blocks cost some
+   disk but keep us off zlib and make encoding a memcpy. */
+static void writePNG(FILE *fp, const uint8_t *rgb, uint32_t width,
+                     uint32_t height) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G',
+                                          '\r', '\n', 0x1a, '\n' };
+    fwrite(signature, 1, 8, fp);
+    pthread_once(&crcTableOnce, makeCrcTable);
+
+    uint8_t ihdr[13] = { 0 };
+    putBE32(ihdr, width);
+    putBE32(ihdr + 4, height);
+    ihdr[8] = 8; /* bit depth */
+    ihdr[9] = 2; /* truecolor */
+    writeChunk(fp, "IHDR", ihdr, 13);
+
+    /* every row starts with filter type 0 */
+    size_t rowSize = (size_t)width * 3 + 1;
+    size_t rawSize = rowSize * height;
+    size_t blocks = (rawSize + 65534) / 65535;
+    size_t idatSize = 2 + blocks * 5 + rawSize + 4;
+    uint8_t *idat = malloc(idatSize);
+    uint8_t *p = idat;
+
+    *p++ = 0x78;
+    *p++ = 0x01;
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    size_t remaining = rawSize;
+    size_t row = 0;
+    size_t column = 0;
+    while (remaining > 0) {
+        uint16_t len = remaining > 65535 ? 65535 : (uint16_t)remaining;
+        uint16_t nlen = ~len;
+        remaining -= len;
+        *p++ = remaining == 0 ? 1 : 0;
+        *p++ = len & 0xff;
+        *p++ = len >> 8;
+        *p++ = nlen & 0xff;
+        *p++ = nlen >> 8;
+
+        for (uint16_t i = 0; i < len; i++) {
+            uint8_t byte =
+                column == 0 ? 0 : rgb[row * width * 3 + column - 1];
+            if (++column == rowSize) {
+                column = 0;
+                row++;
+            }
+            *p++ = byte;
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    putBE32(p, (b << 16) | a);
+
+    writeChunk(fp, "IDAT", idat, (uint32_t)idatSize);
+    writeChunk(fp, "IEND", NULL, 0);
+    free(idat);
+}
+
+static void writePPM(FILE *fp, const uint8_t *rgb, uint32_t width,
+                     uint32_t height) {
+    fprintf(fp, "P6\n%u %u\n255\n", width, height);
+    fwrite(rgb, 3, (size_t)width * height, fp);
+}
+
+void invalidateReadback(struct sl_oo *oo, struct sl_readback *readback) {
+    if (!readback->coherent) {
+        VkMappedMemoryRange range = { 0 };
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = readback->memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(oo->device, 1, &range);
+    }
+}
+
+void encodeReadback(struct sl_oo *oo, struct sl_readback *readback) {
+    TRACE_ZONE(oo, "encode screenshot");
+    invalidateReadback(oo, readback);
+
+    uint32_t width = readback->extent.width;
+    uint32_t height = readback->extent.height;
+    size_t pixels = (size_t)width * height;
+    const uint8_t *src = readback->mapped;
+    uint8_t *rgb = malloc(pixels * 3);
+
+    int r = isBGRA(readback->format) ? 2 : 0;
+    for (size_t i = 0; i < pixels; i++) {
+        rgb[i * 3 + 0] = src[i * 4 + r];
+        rgb[i * 3 + 1] = src[i * 4 + 1];
+        rgb[i * 3 + 2] = src[i * 4 + 2 - r];
+    }
+
+    FILE *fp = fopen(readback->path, "wb");
+    if (fp == NULL) {
+        error_log("failed to open %s!", readback->path);
+    } else {
+        size_t len = strlen(readback->path);
+        if (len > 4 && strcasecmp(readback->path + len - 4, ".ppm") == 0) {
+            writePPM(fp, rgb, width, height);
+        } else {
+            writePNG(fp, rgb, width, height);
+        }
+        fclose(fp);
+    }
+
+    free(rgb);
+}
+
+static void *captureWorker(void *arg) {
+    struct sl_oo *oo = arg;
+    struct sl_capture *capture = &oo->capture;
+    traceThreadName(oo, "capture worker");
+
+    pthread_mutex_lock(&capture->lock);
+    for (;;) {
+        while (capture->queueCount == 0 && !capture->stopping) {
+            pthread_cond_wait(&capture->cond, &capture->lock);
+        }
+        if (capture->queueCount == 0) {
+            break;
+        }
+
+        int index = capture->queue[capture->queueHead];
+        capture->queueHead = (capture->queueHead + 1) % CAPTURE_RING_SIZE;
+        pthread_mutex_unlock(&capture->lock);
+
+        struct sl_readback *readback = &capture->readbacks[index];
+        encodeReadback(oo, readback);
+        __atomic_store_n(&readback->state, READBACK_FREE, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&capture->lock);
+        /* only counted down once encoded, so a flush waits for it */
+        capture->queueCount--;
+        pthread_cond_broadcast(&capture->cond);
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    return NULL;
+}
+
+static void dispatchReadback(struct sl_capture *capture, int index) {
+    __atomic_store_n(&capture->readbacks[index].state, READBACK_ENCODING,
+                     __ATOMIC_RELAXED);
+
+    /* the ring and the queue have the same size, this never overflows */
+    pthread_mutex_lock(&capture->lock);
+    int tail = (capture->queueHead + capture->queueCount) % CAPTURE_RING_SIZE;
+    capture->queue[tail] = index;
+    capture->queueCount++;
+    pthread_cond_broadcast(&capture->cond);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/* only valid once the gpu is idle, hands over every recorded copy and
+   waits until the worker wrote all of them */
+static void flushCapture(struct sl_oo *oo) {
+    struct sl_capture *capture = &oo->capture;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (capture->pending[i] >= 0) {
+            dispatchReadback(capture, capture->pending[i]);
+            capture->pending[i] = -1;
+        }
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    while (capture->queueCount > 0) {
+        pthread_cond_wait(&capture->cond, &capture->lock);
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/****** render thread */
+
+void createCapture(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createCapture");
+
+    struct sl_capture *capture = &oo->capture;
+
+    capture->pending = malloc(sizeof(int) * MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        capture->pending[i] = -1;
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->cond, NULL);
+    if (pthread_create(&capture->worker, NULL, captureWorker, oo) != 0) {
+        error_log("failed to start capture thread!");
+        exit(1);
+    }
+
+    recreateCaptureBuffers(oo);
+}
+
+void recreateCaptureBuffers(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "recreateCaptureBuffers");
+
+    struct sl_capture *capture = &oo->capture;
+    if (capture->pending == NULL) {
+        return;
+    }
+
+    flushCapture(oo);
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        destroyReadback(oo, &capture->readbacks[i]);
+    }
+
+    if (!isCapturableFormat(oo->targets[0].swapChainImageFormat)) {
+        capture->supported = false;
+    }
+    if (!capture->supported) {
+        return;
+    }
+
+    capture->readbackSize = (VkDeviceSize)oo->targets[0].swapChainExtent.width *
+                            oo->targets[0].swapChainExtent.height * 4;
+    /* left to captureBegin while memory is short */
+    if (oo->budget.pressure) {
+        return;
+    }
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        createReadback(oo, &capture->readbacks[i], capture->readbackSize,
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    }
+}
+
+void destroyCapture(struct sl_oo *oo) {
+    struct sl_capture *capture = &oo->capture;
+    if (capture->pending == NULL) {
+        return;
+    }
+
+    flushCapture(oo);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->stopping = true;
+    pthread_cond_broadcast(&capture->cond);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->worker, NULL);
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        destroyReadback(oo, &capture->readbacks[i]);
+    }
+    pthread_cond_destroy(&capture->cond);
+    pthread_mutex_destroy(&capture->lock);
+    free(capture->pending);
+    capture->pending = NULL;
+}
+
+/* free ones are neither recorded nor read by the worker, nothing to wait
+   for */
+void evictCaptureBuffers(struct sl_oo *oo) {
+    struct sl_capture *capture = &oo->capture;
+    if (capture->pending == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        struct sl_readback *readback = &capture->readbacks[i];
+        if (__atomic_load_n(&readback->state, __ATOMIC_ACQUIRE) ==
+            READBACK_FREE) {
+            destroyReadback(oo, readback);
+        }
+    }
+}
+
+void captureScreenshot(struct sl_oo *oo, const char *path) {
+    struct sl_capture *capture = &oo->capture;
+
+    if (capture->pending == NULL || !capture->supported) {
+        error_log("screenshots are not supported by this swapchain");
+        return;
+    }
+
+    strncpy(capture->requestPath, path, CAPTURE_PATH_LEN - 1);
+    capture->requestPath[CAPTURE_PATH_LEN - 1] = '\0';
+    capture->requested = true;
+}
+
+void captureCollect(struct sl_oo *oo) {
+    struct sl_capture *capture = &oo->capture;
+    if (capture->pending == NULL) {
+        return;
+    }
+    int index = capture->pending[oo->currentFrame];
+
+    /* the fence of this frame slot just signaled, so is the copy */
+    if (index >= 0) {
+        dispatchReadback(capture, index);
+        capture->pending[oo->currentFrame] = -1;
+    }
+}
+
+void captureBegin(struct sl_oo *oo) {
+    struct sl_capture *capture = &oo->capture;
+
+    if (!capture->requested) {
+        return;
+    }
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+        struct sl_readback *readback = &capture->readbacks[i];
+        if (__atomic_load_n(&readback->state, __ATOMIC_ACQUIRE) !=
+            READBACK_FREE) {
+            continue;
+        }
+        if (readback->buffer == VK_NULL_HANDLE) {
+            /* evicted, the screenshot waits until memory is back */
+            if (oo->budget.pressure) {
+                continue;
+            }
+            createReadback(oo, readback, capture->readbackSize,
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        }
+
+        readback->state = READBACK_IN_FLIGHT;
+        readback->extent = oo->targets[0].swapChainExtent;
+        readback->format = oo->targets[0].swapChainImageFormat;
+        memcpy(readback->path, capture->requestPath, CAPTURE_PATH_LEN);
+        capture->pending[oo->currentFrame] = i;
+        capture->requested = false;
+        return;
+    }
+
+    /* every buffer is still busy (or evicted), try again next frame
+       instead of waiting for the worker */
+    capture->skipped++;
+}
+
+void recordReadbackCopy(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                        VkImage image, struct sl_readback *readback) {
+    /* headless images already end the render pass in TRANSFER_SRC */
+    VkImageLayout finalLayout = oo->headless
+                                    ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkImageMemoryBarrier barrier = { 0 };
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = finalLayout;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    /* the transfer stage orders us after a copy recorded just before */
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &barrier);
+
+    VkBufferImageCopy region = { 0 };
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = readback->extent.width;
+    region.imageExtent.height = readback->extent.height;
+    region.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(commandBuffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readback->buffer, 1, &region);
+
+    /* back to what present (or the next copy) expects */
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    /* make the copy visible to the host once the fence signals */
+    VkBufferMemoryBarrier bufferBarrier = { 0 };
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = readback->buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                         &bufferBarrier, 0, NULL);
+}
+
+void recordCapture(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                   uint32_t imageIndex) {
+    if (oo->capture.pending == NULL) {
+        return;
+    }
+    int index = oo->capture.pending[oo->currentFrame];
+    if (index < 0) {
+        return;
+    }
+
+    recordReadbackCopy(oo, commandBuffer,
+                       oo->targets[0].swapChainImages[imageIndex],
+                       &oo->capture.readbacks[index]);
+}
@@ -0,0 +1,98 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* screenshots without stalling the frame loop. the copy into a host
+   visible buffer is recorded into the frame's own command buffer, the
+   frame fence tells us when it landed (MAX_FRAMES_IN_FLIGHT frames
+   later) and a worker thread does the encoding. */
+
+struct sl_oo;
+
+enum ReadbackState {
+    READBACK_FREE,
+    /* the copy is recorded, waiting for the frame fence */
+    READBACK_IN_FLIGHT,
+    /* handed to the worker */
+    READBACK_ENCODING,
+};
+
+struct sl_readback {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    /* mapped once at creation, nothing is mapped on the render thread */
+    void *mapped;
+    VkDeviceSize size;
+    bool coherent;
+    uint32_t state;
+
+    /* what the copy contains, filled when it is recorded */
+    VkExtent2D extent;
+    VkFormat format;
+    char path[CAPTURE_PATH_LEN];
+};
+
+struct sl_capture {
+    bool supported;
+    /* a buffer may be missing while device memory is short, it is made
+       again when a screenshot needs it */
+    struct sl_readback readbacks[CAPTURE_RING_SIZE];
+    VkDeviceSize readbackSize;
+    /* readback recorded by each frame in flight, -1 for none */
+    int *pending;
+
+    bool requested;
+    char requestPath[CAPTURE_PATH_LEN];
+    uint32_t skipped;
+
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int queue[CAPTURE_RING_SIZE];
+    int queueHead;
+    int queueCount;
+    bool stopping;
+};
+
+/* 8 bit rgba and bgra, the only formats written out as they are */
+bool isCapturableFormat(VkFormat format);
+bool isBGRA(VkFormat format);
+
+/* persistently mapped host visible buffers, shared with the video stream */
+void createReadback(struct sl_oo *oo, struct sl_readback *readback,
+                    VkDeviceSize size, VkBufferUsageFlags usage);
+void destroyReadback(struct sl_oo *oo, struct sl_readback *readback);
+/* worker side, before reading mapped */
+void invalidateReadback(struct sl_oo *oo, struct sl_readback *readback);
+
+/* writes the copy to readback->path, .png or .ppm, after the fence of
+   the copy signaled. any thread */
+void encodeReadback(struct sl_oo *oo, struct sl_readback *readback);
+
+/* copies a rendered image into readback, visible to the host once the
+   frame fence signals. the image is left in the layout it came in. */
+void recordReadbackCopy(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                        VkImage image, struct sl_readback *readback);
+
+void createCapture(struct sl_oo *oo);
+void recreateCaptureBuffers(struct sl_oo *oo);
+void destroyCapture(struct sl_oo *oo);
+/* drops the buffers no screenshot is using, under memory pressure */
+void evictCaptureBuffers(struct sl_oo *oo);
+
+/* asks for the next frame to be written to path, .png or .ppm */
+void captureScreenshot(struct sl_oo *oo, const char *path);
+
+/* drawFrame calls these in order: after the fence wait, before recording
+   and while recording after the render pass */
+void captureCollect(struct sl_oo *oo);
+void captureBegin(struct sl_oo *oo);
+void recordCapture(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                   uint32_t imageIndex);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,478 @@
+#include "renderer.h"
+#include "cmdlog.h"
+
+static void writeBytes(struct sl_cmdlog *cmdlog, const void *data,
+                       size_t size) {
+    if (cmdlog->fp != NULL && size > 0 &&
+        fwrite(data, 1, size, cmdlog->fp) != size) {
+        /* keep drawing, only the file is lost */
+        error_log("failed to write %s, recording stopped", cmdlog->path);
+        fclose(cmdlog->fp);
+        cmdlog->fp = NULL;
+    }
+}
+
+static void writeOp(struct sl_cmdlog *cmdlog, uint32_t op, uint32_t size) {
+    uint32_t head[2] = { op, size };
+    writeBytes(cmdlog, head, sizeof(head));
+}
+
+static void readBytes(struct sl_cmdlog *cmdlog, void *data, size_t size) {
+    if (size > 0 && fread(data, 1, size, cmdlog->fp) != size) {
+        error_log("%s is truncated", cmdlog->path);
+        exit(1);
+    }
+}
+
+/* a known op of another size than its payload, the rest of the stream
+   would be read out of step */
+static void checkOpSize(struct sl_cmdlog *cmdlog, uint32_t op, uint32_t size,
+                        uint64_t expected) {
+    if (size != expected) {
+        error_log("%s is corrupt, op %u has %u bytes instead of %llu",
+                  cmdlog->path, op, size, (unsigned long long)expected);
+        exit(1);
+    }
+}
+
+/* room for count instances and sprites in the copies, they only grow */
+static void reserveInstances(struct sl_cmdlog *cmdlog, uint32_t count) {
+    if (count <= cmdlog->instanceCapacity) {
+        return;
+    }
+    cmdlog->instances =
+        realloc(cmdlog->instances, sizeof(struct sl_instance) * count);
+    cmdlog->ids = realloc(cmdlog->ids, sizeof(uint32_t) * count);
+    if (cmdlog->instances == NULL || cmdlog->ids == NULL) {
+        error_log("failed to allocate %u recorded instances!", count);
+        exit(1);
+    }
+    cmdlog->instanceCapacity = count;
+}
+
+static void reserveSprites(struct sl_cmdlog *cmdlog, uint32_t count) {
+    if (count <= cmdlog->spriteCapacity) {
+        return;
+    }
+    cmdlog->spriteKeys =
+        realloc(cmdlog->spriteKeys, sizeof(uint32_t) * count);
+    cmdlog->spriteRects =
+        realloc(cmdlog->spriteRects, sizeof(float) * 4 * count);
+    cmdlog->spriteUvs = realloc(cmdlog->spriteUvs, sizeof(float) * 4 * count);
+    cmdlog->spriteColors =
+        realloc(cmdlog->spriteColors, sizeof(uint32_t) * count);
+    if (cmdlog->spriteKeys == NULL || cmdlog->spriteRects == NULL ||
+        cmdlog->spriteUvs == NULL || cmdlog->spriteColors == NULL) {
+        error_log("failed to allocate %u recorded sprites!", count);
+        exit(1);
+    }
+    cmdlog->spriteCapacity = count;
+}
+
+/* nothing seen yet, so the first frame writes or reads every op */
+static void forgetState(struct sl_cmdlog *cmdlog) {
+    memset(&cmdlog->extent, 0, sizeof(cmdlog->extent));
+    memset(&cmdlog->material, 0, sizeof(cmdlog->material));
+    cmdlog->lodCount = 0;
+    memset(cmdlog->lodFirst, 0, sizeof(cmdlog->lodFirst));
+    memset(cmdlog->lodVisible, 0, sizeof(cmdlog->lodVisible));
+    cmdlog->instanceCount = 0;
+    cmdlog->spriteCount = UINT32_MAX;
+}
+
+/* the frame count goes back into the header, a pipe keeps 0 */
+static void finishRecording(struct sl_cmdlog *cmdlog) {
+    cmdlog->header.frameCount = cmdlog->frameCount;
+    if (cmdlog->fp != NULL && fseek(cmdlog->fp, 0, SEEK_SET) == 0) {
+        writeBytes(cmdlog, &cmdlog->header, sizeof(cmdlog->header));
+    }
+    /* writeBytes closes it when that fails */
+    if (cmdlog->fp != NULL) {
+        fclose(cmdlog->fp);
+        cmdlog->fp = NULL;
+    }
+    error_log("recorded %u frames to %s", cmdlog->frameCount, cmdlog->path);
+    cmdlog->recording = false;
+}
+
+void createCmdlog(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createCmdlog");
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    if (cmdlog->path == NULL) {
+        return;
+    }
+
+    cmdlog->fp = fopen(cmdlog->path, "wb");
+    if (cmdlog->fp == NULL) {
+        error_log("failed to open %s, not recording", cmdlog->path);
+        return;
+    }
+
+    struct sl_cmdlog_header *header = &cmdlog->header;
+    memset(header, 0, sizeof(*header));
+    header->magic = CMDLOG_MAGIC;
+    header->version = CMDLOG_VERSION;
+    header->width = oo->targets[0].swapChainExtent.width;
+    header->height = oo->targets[0].swapChainExtent.height;
+    header->msaaSamples = oo->msaaSamples;
+    header->depthPrepass = oo->depthPrepass;
+    header->dynamicState = oo->pipelines.dynamic.enabled;
+    header->occlusion = oo->occlusion.active;
+    header->instanceCapacity = oo->instanceCapacity;
+    header->postPassCount = oo->post.active ? oo->post.passCount : 0;
+    for (uint32_t i = 0; i < header->postPassCount; i++) {
+        header->postPasses[i] = oo->post.passes[i];
+    }
+    if (oo->meshPath != NULL) {
+        snprintf(header->meshPath, sizeof(header->meshPath), "%s",
+                 oo->meshPath);
+    }
+    writeBytes(cmdlog, header, sizeof(*header));
+
+    /* the copies are compared every frame, nothing grows while drawing */
+    reserveInstances(cmdlog, oo->instanceCapacity);
+    reserveSprites(cmdlog, SPRITE_MAX_SPRITES);
+    forgetState(cmdlog);
+    cmdlog->frameCount = 0;
+    cmdlog->recording = true;
+}
+
+void destroyCmdlog(struct sl_oo *oo) {
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    if (cmdlog->recording) {
+        finishRecording(cmdlog);
+    }
+    if (cmdlog->fp != NULL) {
+        fclose(cmdlog->fp);
+        cmdlog->fp = NULL;
+    }
+
+    free(cmdlog->instances);
+    free(cmdlog->ids);
+    free(cmdlog->spriteKeys);
+    free(cmdlog->spriteRects);
+    free(cmdlog->spriteUvs);
+    free(cmdlog->spriteColors);
+    cmdlog->instances = NULL;
+    cmdlog->ids = NULL;
+    cmdlog->spriteKeys = NULL;
+    cmdlog->spriteRects = NULL;
+    cmdlog->spriteUvs = NULL;
+    cmdlog->spriteColors = NULL;
+    cmdlog->instanceCapacity = 0;
+    cmdlog->spriteCapacity = 0;
+    cmdlog->recording = false;
+    cmdlog->replaying = false;
+}
+
+static bool spritesChanged(struct sl_cmdlog *cmdlog,
+                           const struct sl_sprites *sprites) {
+    uint32_t n = sprites->count;
+    if (n != cmdlog->spriteCount) {
+        return true;
+    }
+    return n > 0 &&
+           (memcmp(cmdlog->spriteKeys, sprites->keys,
+                   sizeof(uint32_t) * n) != 0 ||
+            memcmp(cmdlog->spriteRects, sprites->rects,
+                   sizeof(float) * 4 * n) != 0 ||
+            memcmp(cmdlog->spriteUvs, sprites->uvs,
+                   sizeof(float) * 4 * n) != 0 ||
+            memcmp(cmdlog->spriteColors, sprites->colors,
+                   sizeof(uint32_t) * n) != 0);
+}
+
+void recordCmdlogFrame(struct sl_oo *oo) {
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    if (!cmdlog->recording || cmdlog->fp == NULL ||
+        !oo->targets[0].acquired) {
+        return;
+    }
+    TRACE_ZONE(oo, "recordCmdlogFrame");
+
+    VkExtent2D extent = oo->targets[0].swapChainExtent;
+    if (extent.width != cmdlog->extent.width ||
+        extent.height != cmdlog->extent.height) {
+        cmdlog->extent = extent;
+        uint32_t size[2] = { extent.width, extent.height };
+        writeOp(cmdlog, CMDLOG_EXTENT, sizeof(size));
+        writeBytes(cmdlog, size, sizeof(size));
+    }
+
+    if (memcmp(&oo->material, &cmdlog->material, sizeof(oo->material)) !=
+        0) {
+        cmdlog->material = oo->material;
+        writeOp(cmdlog, CMDLOG_MATERIAL, sizeof(cmdlog->material));
+        writeBytes(cmdlog, &cmdlog->material, sizeof(cmdlog->material));
+    }
+
+    /* what recordTarget draws, nothing when no instance is visible */
+    const struct sl_cull *cull = &oo->cull;
+    uint32_t lodCount = cull->visible > 0 ? oo->mesh.lodCount : 0;
+    if (lodCount != cmdlog->lodCount ||
+        memcmp(cull->lodFirst, cmdlog->lodFirst, sizeof(cull->lodFirst)) !=
+            0 ||
+        memcmp(cull->lodVisible, cmdlog->lodVisible,
+               sizeof(cull->lodVisible)) != 0) {
+        cmdlog->lodCount = lodCount;
+        memcpy(cmdlog->lodFirst, cull->lodFirst, sizeof(cull->lodFirst));
+        memcpy(cmdlog->lodVisible, cull->lodVisible,
+               sizeof(cull->lodVisible));
+        writeOp(cmdlog, CMDLOG_DRAWS,
+                sizeof(uint32_t) * (1 + 2 * MESH_MAX_LODS));
+        writeBytes(cmdlog, &cmdlog->lodCount, sizeof(uint32_t));
+        writeBytes(cmdlog, cmdlog->lodFirst, sizeof(cmdlog->lodFirst));
+        writeBytes(cmdlog, cmdlog->lodVisible, sizeof(cmdlog->lodVisible));
+    }
+
+    /* the region the culling wrote for this frame, a moving camera
+       rewrites all of it. read back from mapped memory that may be
+       uncached, recording is not free but the replay does not pay it */
+    const struct sl_instance *instances =
+        oo->instances + (size_t)oo->instanceCapacity * oo->currentFrame;
+    const uint32_t *ids =
+        oo->occlusion.active
+            ? oo->occlusion.ids + (size_t)oo->instanceCapacity *
+                                      oo->currentFrame
+            : NULL;
+    uint32_t count = cull->visible;
+    size_t instanceSize = sizeof(struct sl_instance) * count;
+    size_t idSize = ids != NULL ? sizeof(uint32_t) * count : 0;
+    if (count != cmdlog->instanceCount ||
+        memcmp(instances, cmdlog->instances, instanceSize) != 0 ||
+        (ids != NULL && memcmp(ids, cmdlog->ids, idSize) != 0)) {
+        cmdlog->instanceCount = count;
+        memcpy(cmdlog->instances, instances, instanceSize);
+        if (ids != NULL) {
+            memcpy(cmdlog->ids, ids, idSize);
+        }
+        writeOp(cmdlog, CMDLOG_INSTANCES,
+                (uint32_t)(sizeof(uint32_t) + instanceSize + idSize));
+        writeBytes(cmdlog, &count, sizeof(count));
+        writeBytes(cmdlog, instances, instanceSize);
+        writeBytes(cmdlog, ids, idSize);
+    }
+
+    /* as pushed, recordSprites sorts its own copy */
+    const struct sl_sprites *sprites = &oo->sprites;
+    if (spritesChanged(cmdlog, sprites)) {
+        uint32_t n = sprites->count;
+        reserveSprites(cmdlog, n);
+        memcpy(cmdlog->spriteKeys, sprites->keys, sizeof(uint32_t) * n);
+        memcpy(cmdlog->spriteRects, sprites->rects, sizeof(float) * 4 * n);
+        memcpy(cmdlog->spriteUvs, sprites->uvs, sizeof(float) * 4 * n);
+        memcpy(cmdlog->spriteColors, sprites->colors, sizeof(uint32_t) * n);
+        cmdlog->spriteCount = n;
+        writeOp(cmdlog, CMDLOG_SPRITES,
+                (uint32_t)(sizeof(uint32_t) + n * 10 * sizeof(uint32_t)));
+        writeBytes(cmdlog, &n, sizeof(n));
+        writeBytes(cmdlog, cmdlog->spriteKeys, sizeof(uint32_t) * n);
+        writeBytes(cmdlog, cmdlog->spriteRects, sizeof(float) * 4 * n);
+        writeBytes(cmdlog, cmdlog->spriteUvs, sizeof(float) * 4 * n);
+        writeBytes(cmdlog, cmdlog->spriteColors, sizeof(uint32_t) * n);
+    }
+
+    writeOp(cmdlog, CMDLOG_END, 0);
+    cmdlog->frameCount++;
+
+    /* later frames are only drawn */
+    if (cmdlog->frames > 0 && cmdlog->frameCount == cmdlog->frames) {
+        finishRecording(cmdlog);
+    }
+}
+
+void openCmdlog(struct sl_oo *oo, const char *path) {
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    cmdlog->path = path;
+    cmdlog->fp = fopen(path, "rb");
+    if (cmdlog->fp == NULL) {
+        error_log("failed to open %s!", path);
+        exit(1);
+    }
+
+    struct sl_cmdlog_header *header = &cmdlog->header;
+    readBytes(cmdlog, header, sizeof(*header));
+    if (header->magic != CMDLOG_MAGIC || header->version != CMDLOG_VERSION) {
+        error_log("%s is not a version %d recording", path, CMDLOG_VERSION);
+        exit(1);
+    }
+    if (header->postPassCount > POST_MAX_PASSES) {
+        error_log("%s has %u post passes, at most %d are supported", path,
+                  header->postPassCount, POST_MAX_PASSES);
+        exit(1);
+    }
+    if (header->instanceCapacity > MAX_INSTANCES) {
+        error_log("%s has %u instances, at most %d are supported", path,
+                  header->instanceCapacity, MAX_INSTANCES);
+        exit(1);
+    }
+    header->meshPath[CMDLOG_PATH_LEN - 1] = '\0';
+
+    cmdlog->firstFrame = ftell(cmdlog->fp);
+    reserveInstances(cmdlog, header->instanceCapacity);
+    forgetState(cmdlog);
+    cmdlog->frameCount = 0;
+    cmdlog->replaying = true;
+}
+
+bool readCmdlogFrame(struct sl_oo *oo) {
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    TRACE_ZONE(oo, "readCmdlogFrame");
+
+    for (bool first = true;; first = false) {
+        uint32_t head[2];
+        size_t n = fread(head, 1, sizeof(head), cmdlog->fp);
+        if (n == 0 && first) {
+            return false;
+        } else if (n != sizeof(head)) {
+            error_log("%s is truncated", cmdlog->path);
+            exit(1);
+        }
+        uint32_t op = head[0];
+        uint32_t size = head[1];
+
+        switch (op) {
+        case CMDLOG_END:
+            checkOpSize(cmdlog, op, size, 0);
+            cmdlog->frameCount++;
+            return true;
+        case CMDLOG_EXTENT: {
+            uint32_t extent[2];
+            checkOpSize(cmdlog, op, size, sizeof(extent));
+            readBytes(cmdlog, extent, sizeof(extent));
+            cmdlog->extent.width = extent[0];
+            cmdlog->extent.height = extent[1];
+            break;
+        }
+        case CMDLOG_MATERIAL:
+            checkOpSize(cmdlog, op, size, sizeof(cmdlog->material));
+            readBytes(cmdlog, &cmdlog->material, sizeof(cmdlog->material));
+            oo->material = cmdlog->material;
+            break;
+        case CMDLOG_DRAWS:
+            checkOpSize(cmdlog, op, size,
+                        sizeof(uint32_t) * (1 + 2 * MESH_MAX_LODS));
+            readBytes(cmdlog, &cmdlog->lodCount, sizeof(uint32_t));
+            readBytes(cmdlog, cmdlog->lodFirst, sizeof(cmdlog->lodFirst));
+            readBytes(cmdlog, cmdlog->lodVisible, sizeof(cmdlog->lodVisible));
+            if (cmdlog->lodCount > oo->mesh.lodCount) {
+                error_log("%s draws %u levels of detail, the mesh has %u",
+                          cmdlog->path, cmdlog->lodCount, oo->mesh.lodCount);
+                exit(1);
+            }
+            break;
+        case CMDLOG_INSTANCES: {
+            uint32_t count;
+            readBytes(cmdlog, &count, sizeof(count));
+            /* the writer never has more than its capacity */
+            if (count > cmdlog->header.instanceCapacity) {
+                error_log("%s is corrupt, %u instances in a frame of at most "
+                          "%u",
+                          cmdlog->path, count, cmdlog->header.instanceCapacity);
+                exit(1);
+            }
+            uint64_t instanceSize =
+                sizeof(struct sl_instance) +
+                (cmdlog->header.occlusion ? sizeof(uint32_t) : 0);
+            checkOpSize(cmdlog, op, size,
+                        sizeof(count) + instanceSize * count);
+            reserveInstances(cmdlog, count);
+            readBytes(cmdlog, cmdlog->instances,
+                      sizeof(struct sl_instance) * count);
+            if (cmdlog->header.occlusion) {
+                readBytes(cmdlog, cmdlog->ids, sizeof(uint32_t) * count);
+            }
+            cmdlog->instanceCount = count;
+            break;
+        }
+        case CMDLOG_SPRITES: {
+            uint32_t count;
+            readBytes(cmdlog, &count, sizeof(count));
+            if (count > SPRITE_MAX_SPRITES) {
+                error_log("%s is corrupt, %u sprites in a frame of at most "
+                          "%d",
+                          cmdlog->path, count, SPRITE_MAX_SPRITES);
+                exit(1);
+            }
+            checkOpSize(cmdlog, op, size,
+                        sizeof(count) +
+                            (uint64_t)count * 10 * sizeof(uint32_t));
+            reserveSprites(cmdlog, count);
+            readBytes(cmdlog, cmdlog->spriteKeys, sizeof(uint32_t) * count);
+            readBytes(cmdlog, cmdlog->spriteRects,
+                      sizeof(float) * 4 * count);
+            readBytes(cmdlog, cmdlog->spriteUvs, sizeof(float) * 4 * count);
+            readBytes(cmdlog, cmdlog->spriteColors,
+                      sizeof(uint32_t) * count);
+            /* kept until the next sprites op, like the application's */
+            clearSprites(oo);
+            for (uint32_t i = 0; i < count; i++) {
+                pushSprite(oo, cmdlog->spriteKeys[i],
+                           &cmdlog->spriteRects[i * 4],
+                           &cmdlog->spriteUvs[i * 4],
+                           cmdlog->spriteColors[i]);
+            }
+            break;
+        }
+        default:
+            /* from a newer build, whatever it was */
+            if (fseek(cmdlog->fp, size, SEEK_CUR) != 0) {
+                error_log("%s is truncated", cmdlog->path);
+                exit(1);
+            }
+            break;
+        }
+    }
+}
+
+void rewindCmdlog(struct sl_oo *oo) {
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    if (fseek(cmdlog->fp, cmdlog->firstFrame, SEEK_SET) != 0) {
+        error_log("failed to rewind %s!", cmdlog->path);
+        exit(1);
+    }
+    forgetState(cmdlog);
+    cmdlog->frameCount = 0;
+    clearSprites(oo);
+}
+
+void replayCmdlogFrame(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "replayCmdlogFrame");
+    struct sl_cmdlog *cmdlog = &oo->cmdlog;
+    struct sl_cull *cull = &oo->cull;
+
+    /* a smaller buffer than the recording had, the memory budget decides
+       that, draws what fits */
+    uint32_t count = cmdlog->instanceCount;
+    if (count > oo->instanceCapacity) {
+        count = oo->instanceCapacity;
+    }
+    memcpy(oo->instances + (size_t)oo->instanceCapacity * oo->currentFrame,
+           cmdlog->instances, sizeof(struct sl_instance) * count);
+    /* the tests keep their visibility by these, like after cullInstances.
+       a device without occlusion culling reads them and draws everything */
+    if (oo->occlusion.active) {
+        memcpy(oo->occlusion.ids +
+                   (size_t)oo->instanceCapacity * oo->currentFrame,
+               cmdlog->ids, sizeof(uint32_t) * count);
+    }
+
+    memset(cull->lodFirst, 0, sizeof(cull->lodFirst));
+    memset(cull->lodVisible, 0, sizeof(cull->lodVisible));
+    for (uint32_t lod = 0; lod < cmdlog->lodCount; lod++) {
+        uint32_t first = cmdlog->lodFirst[lod];
+        uint32_t visible = cmdlog->lodVisible[lod];
+        if (first >= count) {
+            continue;
+        }
+        cull->lodFirst[lod] = first;
+        cull->lodVisible[lod] = first + visible > count ? count - first
+                                                        : visible;
+    }
+    cull->visible = cmdlog->lodCount > 0 ? count : 0;
+    oo->stats.visibleInstances = cull->visible;
+    /* collectOcclusion counts them otherwise */
+    if (!oo->occlusion.active) {
+        oo->stats.drawnInstances = cull->visible;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef CMDLOG_H
+#define CMDLOG_H
+
+#include "config.h"
+#include "meshfile.h"
+#include "pipeline.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* what recordCommandBuffer drew, frame by frame, written with --record
+   and played back by ./replay. not vulkan commands but the state they
+   are recorded from: the primary target's size, the material, the range
+   of every level of detail, the instances the culling wrote and the
+   sprites. an op is only written when its state differs from the frame
+   before, so a still scene costs a few bytes a frame. no handle is ever
+   written, the replay creates its own and records with the same code as
+   the application, so a file keeps working across builds as long as its
+   version does. little endian, like the meshes. */
+
+struct sl_oo;
+struct sl_instance;
+
+/* "SLCL" */
+#define CMDLOG_MAGIC 0x4c434c53u
+#define CMDLOG_VERSION 2
+#define CMDLOG_PATH_LEN 256
+
+/* every op is its kind, the size of what follows and then that, a
+   reader skips kinds it does not know */
+enum CmdlogOp {
+    /* the last op of a frame, nothing follows */
+    CMDLOG_END,
+    /* width and height of the primary target */
+    CMDLOG_EXTENT,
+    /* a struct sl_pipeline_key */
+    CMDLOG_MATERIAL,
+    /* lodCount, then lodFirst and lodVisible, MESH_MAX_LODS each */
+    CMDLOG_DRAWS,
+    /* a count, then that many struct sl_instance and, with occlusion in
+       the header, the instance every slot is */
+    CMDLOG_INSTANCES,
+    /* a count, then that many keys, rects, uvs and colors */
+    CMDLOG_SPRITES,
+};
+
+/* what the renderer was created with, the replay creates the same */
+struct sl_cmdlog_header {
+    uint32_t magic;
+    uint32_t version;
+    /* written when the recording ends, 0 if it never did */
+    uint32_t frameCount;
+    uint32_t width;
+    uint32_t height;
+    uint32_t msaaSamples;
+    uint32_t depthPrepass;
+    uint32_t dynamicState;
+    /* occlusion culling ran, it splits the passes and tests on the gpu */
+    uint32_t occlusion;
+    /* no frame draws more instances than this */
+    uint32_t instanceCapacity;
+    uint32_t postPassCount;
+    uint32_t postPasses[POST_MAX_PASSES];
+    /* --mesh, empty for the triangle */
+    char meshPath[CMDLOG_PATH_LEN];
+};
+
+struct sl_cmdlog {
+    /* options, set before createCmdlog. frames 0 records until exit */
+    const char *path;
+    uint32_t frames;
+
+    bool recording;
+    bool replaying;
+    FILE *fp;
+    struct sl_cmdlog_header header;
+    /* where the first frame starts, for rewindCmdlog */
+    long firstFrame;
+    uint32_t frameCount;
+
+    /* the state of the last frame written or read */
+    VkExtent2D extent;
+    struct sl_pipeline_key material;
+    uint32_t lodCount;
+    uint32_t lodFirst[MESH_MAX_LODS];
+    uint32_t lodVisible[MESH_MAX_LODS];
+    struct sl_instance *instances;
+    /* with occlusion, occlusion.ids of the same slots */
+    uint32_t *ids;
+    uint32_t instanceCount;
+    uint32_t instanceCapacity;
+    /* recording only, the replay pushes them right away */
+    uint32_t spriteCount;
+    uint32_t spriteCapacity;
+    uint32_t *spriteKeys;
+    float *spriteRects;
+    float *spriteUvs;
+    uint32_t *spriteColors;
+};
+
+/* recording. after createSprites, does nothing without cmdlog.path */
+void createCmdlog(struct sl_oo *oo);
+/* ends the recording or closes the replay */
+void destroyCmdlog(struct sl_oo *oo);
+/* after recordCommandBuffer, what it recorded for the primary target */
+void recordCmdlogFrame(struct sl_oo *oo);
+
+/* replay. reads the header before anything is created, the caller sets
+   the renderer up the way it says */
+void openCmdlog(struct sl_oo *oo, const char *path);
+/* the next frame into cmdlog, the material and the sprites, false after
+   the last one. the caller resizes to cmdlog.extent */
+bool readCmdlogFrame(struct sl_oo *oo);
+/* back to the first frame */
+void rewindCmdlog(struct sl_oo *oo);
+/* in drawFrame instead of cullInstances, the frame's instances and
+   draws as they were recorded */
+void replayCmdlogFrame(struct sl_oo *oo);
+
+#endif /* CMDLOG_H */
@@ -10,6 +10,28 @@
 static const int WIDTH = 800;
 static const int HEIGHT = 600;
 
+/* --device overrides this, both take an index, a name or a uuid */
+#define DEVICE_ENV "SL_DEVICE"
+/* weights used by rateDeviceSuitability. every step of the device type,
+   cpu, virtual, integrated and discrete, is worth a tier, everything
+   else together less than one */
+#define DEVICE_SCORE_TIER 1000000000ll
+#define DEVICE_SCORE_QUEUE 100
+
+/* --validation overrides this: off, error, warning, info or verbose */
+#define VALIDATION_ENV "SL_VALIDATION"
+/* validation messages go through a ring drained by a background thread,
+   both sizes must be powers of two */
+#define LOG_RING_SIZE 256
+#define LOG_RATE_SLOTS 64
+/* at most LOG_RATE_LIMIT messages per id every LOG_RATE_WINDOW_MS */
+#define LOG_RATE_LIMIT 8
+#define LOG_RATE_WINDOW_MS 1000
+/* while messages keep coming they are written in batches this far
+   apart, an empty ring puts the drain thread to sleep until the next */
+#define LOG_DRAIN_INTERVAL_MS 10
+#define LOG_WRITE_BUFFER 65536
+
 #define QUEUE_CREATE_INFOS_SIZE 2
 static const char *validationLayers[] = { "VK_LAYER_KHRONOS_validation" };
 
@@ -25,4 +47,164 @@ static const char *deviceExtensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
 static const int MAX_FRAMES_IN_FLIGHT = 2;
 
+/* windows one process can render to, --windows picks how many */
+#define MAX_TARGETS 4
+
+/* samples per pixel, clamped to what the device supports, 1 turns msaa
+   off */
+#define MSAA_SAMPLES 4
+
+/* --instances and every batch job draw at most this many, the memory
+   budget may leave room for fewer */
+#define MAX_INSTANCES 16777216
+/* instances are spread between depth 1 and this */
+#define SCENE_DEPTH 20.0f
+/* draw depth only first, then shade with an EQUAL test */
+#define DEPTH_PREPASS false
+
+/* pipeline variants that can exist at once, a power of two */
+#define PIPELINE_REGISTRY_SIZE 256
+/* threads compiling variants, fewer on small machines */
+#define PIPELINE_WORKERS 4
+/* VkPipelineCache contents, kept between runs */
+#define PIPELINE_CACHE_PATH "pipeline.cache"
+/* shader generations alive at once, the current one, the one still drawn
+   with while it compiles and whatever is left of older ones */
+#define PIPELINE_SHADER_SETS 4
+
+/* sets and descriptors of every type in a per-frame descriptor pool */
+#define DESCRIPTOR_POOL_SETS 256
+#define DESCRIPTOR_POOL_DESCRIPTORS 1024
+/* pools one frame may chain when it needs more than that */
+#define DESCRIPTOR_MAX_POOLS 8
+
+/* cull mode, topology, depth and blend state set in the command buffer
+   where the device can, so they are not a pipeline variant each.
+   --no-dynamic-state bakes everything */
+#define PIPELINE_DYNAMIC_STATE true
+
+/* frames are only drawn when something changed: input, a window event,
+   a screenshot, the video stream or pipelines that are still switching.
+   --continuous draws as fast as it can */
+#define ON_DEMAND_RENDERING true
+/* with nothing changing, how long the main loop sleeps in
+   SDL_WaitEventTimeout before it looks at shader reloads and pipelines
+   again */
+#define IDLE_WAIT_MS 250
+
+/* --pacing, with VK_KHR_present_wait every frame starts once the one
+   before is on screen and as late as its measured time allows */
+#define LATCH_PACING false
+/* started this much earlier than the frame time says is needed */
+#define LATCH_MARGIN_MS 2.0
+/* presents the refresh interval is the shortest gap of */
+#define LATCH_INTERVAL_FRAMES 60
+/* per frame, how fast the frame time forgets a slow frame */
+#define LATCH_WORK_DECAY 0.98
+/* a present that never shows up, a hidden window, does not hang us */
+#define LATCH_WAIT_TIMEOUT_NS 100000000ull
+
+/* watch shaders/ with inotify and rebuild the pipelines when the spv files
+   change, linux only */
+#define SHADER_RELOAD true
+/* quiet time before a reload, so vert and frag from one make arrive
+   together */
+#define SHADER_RELOAD_SETTLE_MS 100
+
+/* pass counting VkAllocationCallbacks to every vkCreate */
+#define HOST_ALLOCATOR true
+/* sites listed per allocation scope by --alloc-stats */
+#define ALLOC_HOT_SITES 3
+/* first block of an arena, it grows on reset when it overflowed */
+#define ARENA_MIN_SIZE 4096
+
+/* percent of a device local heap's budget, above the high water mark
+   memory that is not needed right now is released, until usage is back
+   under the low water mark */
+#define BUDGET_HIGH_WATER 90
+#define BUDGET_LOW_WATER 80
+/* without VK_EXT_memory_budget, percent of the heap size we assume we
+   can have */
+#define BUDGET_FALLBACK_SHARE 75
+/* vkAllocateMemory calls tracked at first, the table doubles when more
+   are alive */
+#define BUDGET_INITIAL_ALLOCATIONS 64
+
+/* trace events waiting for the writer thread, a power of two. a full
+   ring drops events instead of waiting */
+#define TRACE_RING_SIZE 16384
+#define TRACE_FLUSH_INTERVAL_MS 50
+/* frames between two gpu clock calibrations, the clocks drift apart */
+#define TRACE_CALIBRATE_INTERVAL 300
+
+/* quads per frame, the streaming buffer holds this many for every frame
+   in flight */
+#define SPRITE_MAX_SPRITES 65536
+/* draw order groups, each with a pipeline per blend mode */
+#define SPRITE_LAYERS 16
+/* texels per side of a cell of the built in atlas */
+#define SPRITE_ATLAS_CELL 32
+
+/* threads testing instances against the frustum next to the render
+   thread, fewer on small machines */
+#define CULL_WORKERS 3
+/* instances a thread takes at once, a multiple of four */
+#define CULL_BLOCK 1024
+/* instances whose bounding sphere is smaller than this part of the
+   screen width are drawn with the next level of detail, and so on with
+   half of it for the level after */
+#define CULL_LOD_SIZE 0.1f
+/* --occlusion, on the gpu after the frustum: what was visible last frame
+   is drawn first, the rest is tested against a depth pyramid of it and
+   whatever passes is drawn after */
+#define OCCLUSION_CULLING false
+/* mips of the depth pyramid at most, the first one is at most the size
+   of the target */
+#define OCCLUSION_MAX_LEVELS 14
+
+/* offscreen targets used instead of a swapchain when headless */
+#define HEADLESS_IMAGE_COUNT 3
+#define HEADLESS_FORMAT VK_FORMAT_B8G8R8A8_SRGB
+
+/* host visible buffers screenshots are copied into, a capture request
+   waits for a free one instead of blocking */
+#define CAPTURE_RING_SIZE 3
+#define CAPTURE_PATH_LEN 256
+
+/* readback buffers for the video stream, larger than MAX_FRAMES_IN_FLIGHT
+   so the writer can fall behind a little before rendering waits for it */
+#define STREAM_RING_SIZE 6
+/* only written to the y4m header */
+#define STREAM_FPS 60
+
+/* the scene of a post-processing chain, kept above 1 until the tonemap */
+#define POST_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+/* passes after --post, and the dispatches they may turn into */
+#define POST_MAX_PASSES 4
+#define POST_MAX_STEPS 32
+/* bloom levels, the first at half the scene */
+#define POST_BLOOM_LEVELS 4
+/* only what is brighter spreads out */
+#define POST_BLOOM_THRESHOLD 0.8f
+/* the bloom is added back scaled by this */
+#define POST_BLOOM_INTENSITY 0.6f
+#define POST_EXPOSURE 1.0f
+
+/* threads rendering batch jobs, each with its own command pool, target
+   and readback. fewer on small machines, --workers overrides it */
+#define BATCH_WORKERS 4
+/* every worker has its own target and command pool, --workers is clamped
+   to this */
+#define BATCH_MAX_WORKERS 64
+
+/* passes ./replay makes over a recording, the first only warms up */
+#define REPLAY_RUNS 3
+
+/* benchmark defaults, all of them can be changed on the command line */
+#define BENCH_FRAMES 1000
+#define BENCH_WARMUP_FRAMES 60
+#define BENCH_INSTANCES 10000
+#define BENCH_RESIZE_INTERVAL 10
+#define BENCH_SPRITES 20000
+
 #endif /* CONFIG_H */
@@ -7,9 +7,9 @@ LIBS = $(shell pkg-config --libs sdl2)
 
 # flags
 CFLAGS = $(INCS) -O2 -std=c99
-LDFLAGS = $(LIBS) -lvulkan -lpthread
+LDFLAGS = $(LIBS) -lvulkan -lpthread -lm
 
 UNAME := $(shell uname -s)
 ifeq ($(UNAME), Darwin)
-	LDFLAGS = $(LIBS) -ldl -lpthread -lvulkan
+	LDFLAGS = $(LIBS) -ldl -lpthread -lm -lvulkan
 endif
@@ -0,0 +1,339 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "cull.h"
+
+#include <math.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* spheres per test, sse2 and neon both have four floats a register. avx
+   would need a runtime check and the loop waits on memory anyway */
+#define CULL_LANES 4
+
+/* the near plane of shader.vert */
+#define CULL_NEAR 0.1f
+
+/* the side planes are |x| = z and |y| = z, their normals are 45 degrees
+   off the axes, so a sphere reaches sqrt(2) r further along x or y */
+#define CULL_SQRT2 1.41421356f
+
+/* the level of CULL_LANES spheres starting at i, -1 for the hidden ones.
+   visible means inside all four side planes and not all of it in front
+   of the near plane, there is no far plane */
+static void cullGroup(const struct sl_cull *cull, uint32_t i,
+                      int32_t lod[CULL_LANES]) {
+#if defined(__SSE2__)
+    __m128 x = _mm_sub_ps(_mm_loadu_ps(&cull->centerX[i]),
+                          _mm_set1_ps(cull->camera[0]));
+    __m128 y = _mm_sub_ps(_mm_loadu_ps(&cull->centerY[i]),
+                          _mm_set1_ps(cull->camera[1]));
+    __m128 z = _mm_sub_ps(_mm_loadu_ps(&cull->centerZ[i]),
+                          _mm_set1_ps(cull->camera[2]));
+    __m128 r = _mm_loadu_ps(&cull->radius[i]);
+
+    __m128 reach = _mm_add_ps(z, _mm_mul_ps(r, _mm_set1_ps(CULL_SQRT2)));
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 in = _mm_and_ps(_mm_cmple_ps(_mm_andnot_ps(sign, x), reach),
+                           _mm_cmple_ps(_mm_andnot_ps(sign, y), reach));
+    in = _mm_and_ps(in, _mm_cmpge_ps(_mm_add_ps(z, r),
+                                     _mm_set1_ps(CULL_NEAR)));
+
+    /* a true compare is -1, one level further for each size it is under */
+    __m128i level = _mm_setzero_si128();
+    for (uint32_t k = 0; k + 1 < cull->lodCount; k++) {
+        __m128 small =
+            _mm_cmplt_ps(r, _mm_mul_ps(z, _mm_set1_ps(cull->lodSize[k])));
+        level = _mm_sub_epi32(level, _mm_castps_si128(small));
+    }
+    __m128i mask = _mm_castps_si128(in);
+    level = _mm_or_si128(_mm_and_si128(mask, level),
+                         _mm_andnot_si128(mask, _mm_set1_epi32(-1)));
+    _mm_storeu_si128((__m128i *)lod, level);
+#elif defined(__ARM_NEON)
+    float32x4_t x =
+        vsubq_f32(vld1q_f32(&cull->centerX[i]), vdupq_n_f32(cull->camera[0]));
+    float32x4_t y =
+        vsubq_f32(vld1q_f32(&cull->centerY[i]), vdupq_n_f32(cull->camera[1]));
+    float32x4_t z =
+        vsubq_f32(vld1q_f32(&cull->centerZ[i]), vdupq_n_f32(cull->camera[2]));
+    float32x4_t r = vld1q_f32(&cull->radius[i]);
+
+    float32x4_t reach = vmlaq_n_f32(z, r, CULL_SQRT2);
+    uint32x4_t in = vandq_u32(vcleq_f32(vabsq_f32(x), reach),
+                              vcleq_f32(vabsq_f32(y), reach));
+    in = vandq_u32(in, vcgeq_f32(vaddq_f32(z, r), vdupq_n_f32(CULL_NEAR)));
+
+    int32x4_t level = vdupq_n_s32(0);
+    for (uint32_t k = 0; k + 1 < cull->lodCount; k++) {
+        uint32x4_t small = vcltq_f32(r, vmulq_n_f32(z, cull->lodSize[k]));
+        level = vsubq_s32(level, vreinterpretq_s32_u32(small));
+    }
+    level = vbslq_s32(in, level, vdupq_n_s32(-1));
+    vst1q_s32(lod, level);
+#else
+    for (int l = 0; l < CULL_LANES; l++) {
+        float x = cull->centerX[i + l] - cull->camera[0];
+        float y = cull->centerY[i + l] - cull->camera[1];
+        float z = cull->centerZ[i + l] - cull->camera[2];
+        float r = cull->radius[i + l];
+        float reach = z + r * CULL_SQRT2;
+        if (fabsf(x) > reach || fabsf(y) > reach || z + r < CULL_NEAR) {
+            lod[l] = -1;
+            continue;
+        }
+        lod[l] = 0;
+        for (uint32_t k = 0; k + 1 < cull->lodCount; k++) {
+            lod[l] += r < z * cull->lodSize[k];
+        }
+    }
+#endif
+}
+
+static void testBlock(struct sl_cull *cull, uint32_t block) {
+    uint32_t start = block * CULL_BLOCK;
+    uint32_t end = start + CULL_BLOCK < cull->count ? start + CULL_BLOCK
+                                                    : cull->count;
+    uint32_t *counts = cull->blockCounts[block];
+    memset(counts, 0, sizeof(uint32_t) * MESH_MAX_LODS);
+
+    for (uint32_t i = start; i < end; i += CULL_LANES) {
+        int32_t lod[CULL_LANES];
+        cullGroup(cull, i, lod);
+        /* the lanes past count are padding or instances not drawn now */
+        uint32_t lanes = end - i < CULL_LANES ? end - i : CULL_LANES;
+        for (uint32_t l = 0; l < lanes; l++) {
+            cull->lods[i + l] = lod[l] < 0 ? CULL_HIDDEN : (uint8_t)lod[l];
+            if (lod[l] >= 0) {
+                counts[lod[l]]++;
+            }
+        }
+    }
+}
+
+/* relative to the camera, so the shader needs no view transform. in the
+   order of the instances, the front to back sort survives in every
+   level */
+static void writeBlock(struct sl_cull *cull, uint32_t block) {
+    uint32_t start = block * CULL_BLOCK;
+    uint32_t end = start + CULL_BLOCK < cull->count ? start + CULL_BLOCK
+                                                    : cull->count;
+    uint32_t *offsets = cull->blockCounts[block];
+    float x = cull->meshCenter[0] + cull->camera[0];
+    float y = cull->meshCenter[1] + cull->camera[1];
+    float z = cull->meshCenter[2] + cull->camera[2];
+
+    for (uint32_t i = start; i < end; i++) {
+        uint8_t lod = cull->lods[i];
+        if (lod == CULL_HIDDEN) {
+            continue;
+        }
+        uint32_t slot = offsets[lod]++;
+        if (cull->outIds != NULL) {
+            cull->outIds[slot] = i;
+        }
+        struct sl_instance *instance = &cull->out[slot];
+        instance->x = cull->centerX[i] - x;
+        instance->y = cull->centerY[i] - y;
+        instance->depth = cull->centerZ[i] - z;
+    }
+}
+
+static void runBlock(struct sl_cull *cull, enum CullPhase phase,
+                     uint32_t block) {
+    if (phase == CULL_PHASE_TEST) {
+        testBlock(cull, block);
+    } else {
+        writeBlock(cull, block);
+    }
+}
+
+/* called and returns with the lock held. a worker that was slow to wake
+   up may find the next phase already started, it goes back to waiting
+   instead of running a block of it as the phase it woke up for */
+static void workBlocks(struct sl_cull *cull, uint64_t generation) {
+    while (cull->generation == generation &&
+           cull->nextBlock < cull->blockCount) {
+        uint32_t block = cull->nextBlock++;
+        enum CullPhase phase = cull->phase;
+        pthread_mutex_unlock(&cull->lock);
+
+        runBlock(cull, phase, block);
+
+        pthread_mutex_lock(&cull->lock);
+        if (++cull->finishedBlocks == cull->blockCount) {
+            pthread_cond_broadcast(&cull->done);
+        }
+    }
+}
+
+static void *cullWorker(void *arg) {
+    struct sl_oo *oo = arg;
+    struct sl_cull *cull = &oo->cull;
+    traceThreadName(oo, "cull worker");
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&cull->lock);
+    for (;;) {
+        while (cull->generation == seen && !cull->stopping) {
+            pthread_cond_wait(&cull->cond, &cull->lock);
+        }
+        if (cull->stopping) {
+            pthread_mutex_unlock(&cull->lock);
+            return NULL;
+        }
+        seen = cull->generation;
+        workBlocks(cull, seen);
+    }
+}
+
+/* the render thread takes blocks too, and waits for the last one */
+static void runPhase(struct sl_cull *cull, enum CullPhase phase) {
+    /* waking the workers costs more than a block */
+    if (cull->workerCount == 0 || cull->blockCount <= 1) {
+        for (uint32_t block = 0; block < cull->blockCount; block++) {
+            runBlock(cull, phase, block);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&cull->lock);
+    cull->phase = phase;
+    cull->nextBlock = 0;
+    cull->finishedBlocks = 0;
+    cull->generation++;
+    pthread_cond_broadcast(&cull->cond);
+    workBlocks(cull, cull->generation);
+    while (cull->finishedBlocks < cull->blockCount) {
+        pthread_cond_wait(&cull->done, &cull->lock);
+    }
+    pthread_mutex_unlock(&cull->lock);
+}
+
+void createCulling(struct sl_oo *oo, const struct sl_instance *instances,
+                   uint32_t count) {
+    TRACE_ZONE(oo, "createCulling");
+    struct sl_cull *cull = &oo->cull;
+
+    /* every group of lanes can be loaded whole */
+    cull->capacity = (count + CULL_LANES - 1) / CULL_LANES * CULL_LANES;
+    cull->centerX = calloc(cull->capacity, sizeof(float));
+    cull->centerY = calloc(cull->capacity, sizeof(float));
+    cull->centerZ = calloc(cull->capacity, sizeof(float));
+    cull->radius = calloc(cull->capacity, sizeof(float));
+    cull->lods = malloc(cull->capacity);
+    uint32_t blocks = (count + CULL_BLOCK - 1) / CULL_BLOCK;
+    cull->blockCounts = malloc(sizeof(*cull->blockCounts) * blocks);
+
+    /* a sphere around the bounds, not the tightest one but close enough
+       for meshes that are about as wide as they are deep */
+    const struct sl_mesh *mesh = &oo->mesh;
+    float radius = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        float extent = mesh->boundsMax[k] - mesh->boundsMin[k];
+        cull->meshCenter[k] = (mesh->boundsMin[k] + mesh->boundsMax[k]) * 0.5f;
+        radius += extent * extent;
+    }
+    radius = sqrtf(radius) * 0.5f;
+    for (uint32_t i = 0; i < count; i++) {
+        cull->centerX[i] = instances[i].x + cull->meshCenter[0];
+        cull->centerY[i] = instances[i].y + cull->meshCenter[1];
+        cull->centerZ[i] = instances[i].depth + cull->meshCenter[2];
+        cull->radius[i] = radius;
+    }
+    for (int k = 0; k < MESH_MAX_LODS - 1; k++) {
+        cull->lodSize[k] = CULL_LOD_SIZE / (float)(1 << k);
+    }
+
+    pthread_mutex_init(&cull->lock, NULL);
+    pthread_cond_init(&cull->cond, NULL);
+    pthread_cond_init(&cull->done, NULL);
+
+    /* the render thread is one of them */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cull->workerCount = CULL_WORKERS;
+    if (cpus > 0 && cpus - 1 < cull->workerCount) {
+        cull->workerCount = (int)cpus - 1;
+    }
+    for (int i = 0; i < cull->workerCount; i++) {
+        if (pthread_create(&cull->workers[i], NULL, cullWorker, oo) != 0) {
+            error_log("failed to start cull thread!");
+            exit(1);
+        }
+    }
+
+    cull->active = true;
+}
+
+void destroyCulling(struct sl_oo *oo) {
+    struct sl_cull *cull = &oo->cull;
+    if (!cull->active) {
+        return;
+    }
+
+    pthread_mutex_lock(&cull->lock);
+    cull->stopping = true;
+    pthread_cond_broadcast(&cull->cond);
+    pthread_mutex_unlock(&cull->lock);
+    for (int i = 0; i < cull->workerCount; i++) {
+        pthread_join(cull->workers[i], NULL);
+    }
+    pthread_cond_destroy(&cull->done);
+    pthread_cond_destroy(&cull->cond);
+    pthread_mutex_destroy(&cull->lock);
+
+    free(cull->blockCounts);
+    free(cull->lods);
+    free(cull->radius);
+    free(cull->centerZ);
+    free(cull->centerY);
+    free(cull->centerX);
+    cull->active = false;
+}
+
+void cullInstances(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "cullInstances");
+    struct sl_cull *cull = &oo->cull;
+
+    cull->count = oo->instanceCount < oo->instanceCapacity
+                      ? oo->instanceCount
+                      : oo->instanceCapacity;
+    cull->lodCount = oo->mesh.lodCount;
+    memcpy(cull->camera, oo->camera, sizeof(cull->camera));
+    /* the fence of this frame signaled, the gpu is done with its region */
+    cull->out = oo->instances + (size_t)oo->instanceCapacity *
+                                    oo->currentFrame;
+    /* the occlusion tests keep a flag per instance, not per slot */
+    cull->outIds = oo->occlusion.active
+                       ? oo->occlusion.ids + (size_t)oo->instanceCapacity *
+                                                 oo->currentFrame
+                       : NULL;
+    cull->blockCount = (cull->count + CULL_BLOCK - 1) / CULL_BLOCK;
+
+    runPhase(cull, CULL_PHASE_TEST);
+
+    /* one level after the other, and within a level the blocks in order */
+    uint32_t first = 0;
+    for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++) {
+        cull->lodFirst[lod] = first;
+        for (uint32_t block = 0; block < cull->blockCount; block++) {
+            uint32_t n = cull->blockCounts[block][lod];
+            cull->blockCounts[block][lod] = first;
+            first += n;
+        }
+        cull->lodVisible[lod] = first - cull->lodFirst[lod];
+    }
+    cull->visible = first;
+    oo->stats.visibleInstances = first;
+    /* collectOcclusion counts them otherwise */
+    if (!oo->occlusion.active) {
+        oo->stats.drawnInstances = first;
+    }
+
+    runPhase(cull, CULL_PHASE_WRITE);
+}
@@ -0,0 +1,91 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include "config.h"
+#include "meshfile.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* which instances are drawn this frame, and with which level of detail.
+   the bounding spheres are kept one array per component so they can be
+   tested against the frustum four at a time, the survivors get a level
+   by how large they are on screen and are written grouped by level into
+   the frame's region of the instance buffer, one instanced draw each.
+   the instances are cut into blocks the cull workers and the render
+   thread take turns on. */
+
+struct sl_oo;
+struct sl_instance;
+
+/* lods entry of an instance outside the frustum */
+#define CULL_HIDDEN 0xff
+
+enum CullPhase {
+    /* spheres against the frustum, a level per instance and how many of
+       each level every block has */
+    CULL_PHASE_TEST,
+    /* the visible instances into the instance buffer */
+    CULL_PHASE_WRITE,
+};
+
+struct sl_cull {
+    bool active;
+
+    /* padded to a multiple of the simd width */
+    uint32_t capacity;
+    float *centerX;
+    float *centerY;
+    float *centerZ;
+    float *radius;
+    /* from the center of a sphere back to where its mesh is placed */
+    float meshCenter[3];
+    /* a level per instance, CULL_HIDDEN when it is not drawn */
+    uint8_t *lods;
+    /* smaller on screen than this and the next level is picked, every
+       one half of the one before */
+    float lodSize[MESH_MAX_LODS - 1];
+
+    /* the job, written by the render thread before a phase starts */
+    uint32_t count;
+    uint32_t lodCount;
+    float camera[3];
+    struct sl_instance *out;
+    /* which instance every one of out is, NULL when nobody asks */
+    uint32_t *outIds;
+    uint32_t blockCount;
+    /* instances of every level in a block, turned into where the block
+       writes them between the phases */
+    uint32_t (*blockCounts)[MESH_MAX_LODS];
+
+    pthread_t workers[CULL_WORKERS];
+    int workerCount;
+    pthread_mutex_t lock;
+    /* a new phase, or stopping */
+    pthread_cond_t cond;
+    /* the last block of a phase is finished */
+    pthread_cond_t done;
+    /* a worker only claims blocks of the phase it woke up for */
+    uint64_t generation;
+    enum CullPhase phase;
+    uint32_t nextBlock;
+    uint32_t finishedBlocks;
+    bool stopping;
+
+    /* this frame's draws, a range of the frame's region per level */
+    uint32_t lodFirst[MESH_MAX_LODS];
+    uint32_t lodVisible[MESH_MAX_LODS];
+    uint32_t visible;
+};
+
+/* after createMesh, the spheres are the mesh bounds around every one of
+   count instances */
+void createCulling(struct sl_oo *oo, const struct sl_instance *instances,
+                   uint32_t count);
+void destroyCulling(struct sl_oo *oo);
+
+/* after the frame's fence, writes its instances for recordCommandBuffer */
+void cullInstances(struct sl_oo *oo);
+
+#endif /* CULL_H */
@@ -0,0 +1,127 @@
+#include "renderer.h"
+#include "descriptor.h"
+
+/* a bit of every type anything here binds, a set of one layout takes
+   what it needs from them */
+static VkDescriptorPool createFramePool(struct sl_oo *oo) {
+    VkDescriptorPoolSize poolSizes[5] = { 0 };
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[4].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    for (int i = 0; i < 5; i++) {
+        poolSizes[i].descriptorCount = DESCRIPTOR_POOL_DESCRIPTORS;
+    }
+
+    /* no FREE_DESCRIPTOR_SET_BIT, sets only go with a reset */
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 5;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &pool) != VK_SUCCESS) {
+        error_log("failed to create frame descriptor pool!");
+        exit(1);
+    }
+    return pool;
+}
+
+void createFrameDescriptors(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createFrameDescriptors");
+
+    struct sl_descriptors *descriptors = &oo->descriptors;
+    descriptors->frames =
+        calloc(MAX_FRAMES_IN_FLIGHT, sizeof(struct sl_descriptor_chain));
+    /* one pool each up front, more only if a frame needs them */
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        struct sl_descriptor_chain *chain = &descriptors->frames[i];
+        chain->pools[0] = createFramePool(oo);
+        chain->poolCount = 1;
+    }
+}
+
+void destroyFrameDescriptors(struct sl_oo *oo) {
+    struct sl_descriptors *descriptors = &oo->descriptors;
+    if (descriptors->frames == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        struct sl_descriptor_chain *chain = &descriptors->frames[i];
+        for (uint32_t p = 0; p < chain->poolCount; p++) {
+            vkDestroyDescriptorPool(oo->device, chain->pools[p],
+                                    hostAllocator(oo, ALLOC_DESCRIPTORS));
+        }
+    }
+    free(descriptors->frames);
+    descriptors->frames = NULL;
+}
+
+void resetFrameDescriptors(struct sl_oo *oo) {
+    struct sl_descriptors *descriptors = &oo->descriptors;
+    if (descriptors->frames == NULL) {
+        return;
+    }
+
+    /* only the pools the frame got to, usually just the first */
+    struct sl_descriptor_chain *chain = &descriptors->frames[oo->currentFrame];
+    if (chain->setCount == 0) {
+        return;
+    }
+    for (uint32_t p = 0; p <= chain->current; p++) {
+        vkResetDescriptorPool(oo->device, chain->pools[p], 0);
+    }
+    chain->current = 0;
+    chain->setCount = 0;
+}
+
+VkDescriptorSet allocateFrameDescriptorSet(struct sl_oo *oo,
+                                           VkDescriptorSetLayout layout) {
+    struct sl_descriptor_chain *chain =
+        &oo->descriptors.frames[oo->currentFrame];
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set;
+    /* every pool after the current one is empty */
+    bool empty = chain->setCount == 0;
+    for (;;) {
+        allocInfo.descriptorPool = chain->pools[chain->current];
+        VkResult result = vkAllocateDescriptorSets(oo->device, &allocInfo,
+                                                   &set);
+        if (result == VK_SUCCESS) {
+            chain->setCount++;
+            return set;
+        }
+        /* anything else is not about this pool being full, and a fresh
+           pool that cannot hold one set never will */
+        if ((result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+             result != VK_ERROR_FRAGMENTED_POOL) ||
+            empty) {
+            error_log("failed to allocate frame descriptor set: %d!",
+                      result);
+            exit(1);
+        }
+
+        /* on to the next pool, kept for the frames after this one */
+        chain->current++;
+        empty = true;
+        if (chain->current == chain->poolCount) {
+            if (chain->poolCount == DESCRIPTOR_MAX_POOLS) {
+                error_log("frame needs more than %d descriptor pools, raise "
+                          "DESCRIPTOR_POOL_SETS!",
+                          DESCRIPTOR_MAX_POOLS);
+                exit(1);
+            }
+            chain->pools[chain->poolCount++] = createFramePool(oo);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef DESCRIPTOR_H
+#define DESCRIPTOR_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* descriptor sets that only live for one frame. every frame in flight
+   has its own chain of pools, sets are taken from the last one until it
+   runs out and the next one is created, and nothing is ever freed on its
+   own: once the frame's fence has signaled, drawFrame resets the pools
+   it used. the pools are kept, after the first few frames allocating is
+   all the driver does. render thread only, like recordCommandBuffer */
+
+struct sl_oo;
+
+struct sl_descriptor_chain {
+    VkDescriptorPool pools[DESCRIPTOR_MAX_POOLS];
+    uint32_t poolCount;
+    /* the pool sets are taken from, the ones before it are full */
+    uint32_t current;
+    /* since the last reset */
+    uint32_t setCount;
+};
+
+struct sl_descriptors {
+    /* one per frame in flight, indexed by currentFrame */
+    struct sl_descriptor_chain *frames;
+};
+
+void createFrameDescriptors(struct sl_oo *oo);
+void destroyFrameDescriptors(struct sl_oo *oo);
+
+/* after the fence of currentFrame, frees every set it allocated */
+void resetFrameDescriptors(struct sl_oo *oo);
+/* valid until currentFrame comes around again, never VK_NULL_HANDLE */
+VkDescriptorSet allocateFrameDescriptorSet(struct sl_oo *oo,
+                                           VkDescriptorSetLayout layout);
+
+#endif /* DESCRIPTOR_H */
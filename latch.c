@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "latch.h"
+
+#include <time.h>
+
+void checkPresentWaitSupport(struct sl_oo *oo) {
+    struct sl_latch *latch = &oo->latch;
+    latch->presentWait = false;
+    if (!latch->pacing || oo->headless) {
+        return;
+    }
+
+    /* the features are queried through vkGetPhysicalDeviceFeatures2 */
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_1 ||
+        !checkDeviceExtension(oo->physicalDevice,
+                              VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+        !checkDeviceExtension(oo->physicalDevice,
+                              VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        fprintf(stderr, "no VK_KHR_present_wait, frames are not paced\n");
+        return;
+    }
+
+    VkPhysicalDevicePresentIdFeaturesKHR idFeatures = { 0 };
+    idFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR waitFeatures = { 0 };
+    waitFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    idFeatures.pNext = &waitFeatures;
+    VkPhysicalDeviceFeatures2 features2 = { 0 };
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &idFeatures;
+    vkGetPhysicalDeviceFeatures2(oo->physicalDevice, &features2);
+
+    latch->presentWait = idFeatures.presentId && waitFeatures.presentWait;
+    if (!latch->presentWait) {
+        fprintf(stderr, "no VK_KHR_present_wait, frames are not paced\n");
+    }
+}
+
+void loadPresentWait(struct sl_oo *oo) {
+    struct sl_latch *latch = &oo->latch;
+    if (!latch->presentWait) {
+        return;
+    }
+    latch->waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+        oo->device, "vkWaitForPresentKHR");
+    latch->presentWait = latch->waitForPresent != NULL;
+}
+
+void createLatch(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createLatch");
+    struct sl_latch *latch = &oo->latch;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    VkDeviceSize align = properties.limits.minUniformBufferOffsetAlignment;
+    if (align == 0) {
+        align = 1;
+    }
+    latch->slotSize =
+        (sizeof(struct sl_latch_data) + align - 1) / align * align;
+
+    /* coherent, so the write right before the submit needs no flush */
+    createBuffer(oo, latch->slotSize * MAX_FRAMES_IN_FLIGHT,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &latch->buffer, &latch->memory);
+    vkMapMemory(oo->device, latch->memory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&latch->mapped);
+    /* recordings that never latch, the batch workers', read zeros */
+    memset(latch->mapped, 0, latch->slotSize * MAX_FRAMES_IN_FLIGHT);
+
+    VkDescriptorSetLayoutBinding binding = { 0 };
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    binding.descriptorCount = 1;
+    /* the occlusion tests place the instances like the vertex shader */
+    binding.stageFlags =
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &latch->descriptorSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create latch descriptor set layout!");
+        exit(1);
+    }
+
+    /* one set for every frame, the dynamic offset picks the slot */
+    VkDescriptorPoolSize poolSize = { 0 };
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &latch->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create latch descriptor pool!");
+        exit(1);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = latch->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &latch->descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(oo->device, &allocInfo,
+                                 &latch->descriptorSet) != VK_SUCCESS) {
+        error_log("failed to allocate latch descriptor set!");
+        exit(1);
+    }
+
+    VkDescriptorBufferInfo bufferInfo = { 0 };
+    bufferInfo.buffer = latch->buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(struct sl_latch_data);
+
+    VkWriteDescriptorSet write = { 0 };
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = latch->descriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(oo->device, 1, &write, 0, NULL);
+}
+
+void destroyLatch(struct sl_oo *oo) {
+    struct sl_latch *latch = &oo->latch;
+    if (latch->buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDestroyDescriptorPool(oo->device, latch->descriptorPool,
+                            hostAllocator(oo, ALLOC_DESCRIPTORS));
+    vkDestroyDescriptorSetLayout(oo->device, latch->descriptorSetLayout,
+                                 hostAllocator(oo, ALLOC_PIPELINES));
+    vkUnmapMemory(oo->device, latch->memory);
+    vkDestroyBuffer(oo->device, latch->buffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, latch->memory);
+    latch->buffer = VK_NULL_HANDLE;
+}
+
+void bindLatch(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+               uint32_t slot) {
+    struct sl_latch *latch = &oo->latch;
+    uint32_t offset = (uint32_t)(latch->slotSize * slot);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            oo->pipelineLayout, 0, 1, &latch->descriptorSet,
+                            1, &offset);
+}
+
+/* a present that was waited for, and the one before it was too, gives
+   the time between two refreshes */
+static void presentShown(struct sl_latch *latch, double shown) {
+    if (latch->shownId + 1 == latch->presentId && latch->lastShown > 0.0) {
+        double gap = shown - latch->lastShown;
+        if (latch->windowFrames == 0 || gap < latch->windowMinMs) {
+            latch->windowMinMs = gap;
+        }
+        /* the shortest gap, a missed refresh makes one twice as long */
+        if (++latch->windowFrames == LATCH_INTERVAL_FRAMES) {
+            latch->intervalMs = latch->windowMinMs;
+            latch->windowFrames = 0;
+        }
+    }
+    latch->lastShown = shown;
+    latch->shownId = latch->presentId;
+}
+
+void paceFrame(struct sl_oo *oo) {
+    struct sl_latch *latch = &oo->latch;
+    struct sl_target *primary = &oo->targets[0];
+    if (!latch->presentWait || primary->hidden ||
+        latch->presentedSwapChain == VK_NULL_HANDLE ||
+        latch->presentedSwapChain != primary->swapChain) {
+        latch->frameStart = nowMs();
+        return;
+    }
+    TRACE_ZONE(oo, "paceFrame");
+
+    /* the frame before is on screen, this one is shown a refresh later */
+    VkResult result = latch->waitForPresent(oo->device, primary->swapChain,
+                                            latch->presentId,
+                                            LATCH_WAIT_TIMEOUT_NS);
+    bool shown = result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+    if (shown) {
+        presentShown(latch, nowMs());
+    } else if (result != VK_TIMEOUT && result != VK_ERROR_OUT_OF_DATE_KHR) {
+        error_log("failed to wait for present: %d!", result);
+        exit(1);
+    }
+
+    /* and has to be done by then, so start no earlier than needed */
+    if (shown && latch->intervalMs > 0.0) {
+        double sleep = latch->intervalMs - latch->workMs - LATCH_MARGIN_MS;
+        if (sleep > 0.0) {
+            struct timespec ts;
+            ts.tv_sec = (time_t)(sleep / 1000.0);
+            ts.tv_nsec = (long)((sleep - ts.tv_sec * 1000.0) * 1e6);
+            nanosleep(&ts, NULL);
+        }
+    }
+    latch->frameStart = nowMs();
+}
+
+void latchFrame(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "latchFrame");
+    struct sl_latch *latch = &oo->latch;
+
+    if (latch->update != NULL) {
+        latch->update(oo, latch->user);
+    }
+
+    /* the instances already moved by the camera culling saw */
+    struct sl_latch_data data = { 0 };
+    for (int i = 0; i < 3; i++) {
+        data.camera[i] = oo->camera[i] - oo->cull.camera[i];
+    }
+    memcpy(latch->mapped + latch->slotSize * oo->currentFrame, &data,
+           sizeof(data));
+
+    /* the cpu part of the frame, and the gpu part of the last one that
+       came back, the worst one decays slowly */
+    double work = nowMs() - latch->frameStart;
+    if (oo->stats.gpuFrameValid) {
+        work += oo->stats.gpuFrameMs;
+    }
+    latch->workMs *= LATCH_WORK_DECAY;
+    if (work > latch->workMs) {
+        latch->workMs = work;
+    }
+}
+
+uint64_t latchPresentId(struct sl_oo *oo) {
+    struct sl_latch *latch = &oo->latch;
+    if (!latch->presentWait) {
+        return 0;
+    }
+    return ++latch->presentId;
+}
@@ -0,0 +1,89 @@
+#ifndef LATCH_H
+#define LATCH_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* per-frame data written after the frame is recorded, right before
+   vkQueueSubmit. the command buffer only points at the frame's slot of a
+   persistently mapped uniform buffer, with a dynamic offset, and the
+   frame's fence says when the slot can be written again. the camera
+   moves made after cullInstances go in as an offset shader.vert
+   subtracts, so input that arrives while a frame is recorded still
+   moves that frame. with VK_KHR_present_wait, pacing also starts every
+   frame as late as it can: once the previous present is on screen, and
+   after sleeping through the part of the refresh the frame does not
+   need. */
+
+struct sl_oo;
+
+/* std140, the Latch block of shader.vert */
+struct sl_latch_data {
+    /* how far the camera moved since the culling, w unused */
+    float camera[4];
+};
+
+struct sl_latch {
+    /* option, set before createLogicalDevice */
+    bool pacing;
+    /* called right before the submit to take the newest input, may move
+       oo->camera */
+    void (*update)(struct sl_oo *oo, void *user);
+    void *user;
+
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint8_t *mapped;
+    /* a slot per frame in flight, aligned for a dynamic offset */
+    VkDeviceSize slotSize;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+
+    /* VK_KHR_present_id and VK_KHR_present_wait are enabled */
+    bool presentWait;
+    PFN_vkWaitForPresentKHR waitForPresent;
+    /* the id of the last present of the primary target, and the
+       swapchain it went to, a new swapchain has seen none */
+    uint64_t presentId;
+    VkSwapchainKHR presentedSwapChain;
+    /* ms on CLOCK_MONOTONIC, and the id that was seen on screen last */
+    double frameStart;
+    double lastShown;
+    uint64_t shownId;
+    /* the shortest time between two presents, over the last
+       LATCH_INTERVAL_FRAMES and the ones being measured now */
+    double intervalMs;
+    double windowMinMs;
+    uint32_t windowFrames;
+    /* from the frame start to the gpu being done, the worst one and
+       slowly back down from it */
+    double workMs;
+};
+
+/* fills in latch.presentWait before createLogicalDevice, which enables
+   it when pacing is asked for */
+void checkPresentWaitSupport(struct sl_oo *oo);
+/* after it, vkWaitForPresentKHR */
+void loadPresentWait(struct sl_oo *oo);
+
+/* from createGraphicsPipeline, the pipeline layout takes its set */
+void createLatch(struct sl_oo *oo);
+void destroyLatch(struct sl_oo *oo);
+
+/* with the graphics pipeline layout, slot is the frame in flight */
+void bindLatch(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+               uint32_t slot);
+
+/* first thing in drawFrame, waits for the last present and then for the
+   moment the frame has to start. returns right away without pacing */
+void paceFrame(struct sl_oo *oo);
+/* right before vkQueueSubmit, writes the frame's slot */
+void latchFrame(struct sl_oo *oo);
+/* the id the primary target's present carries, 0 without present wait */
+uint64_t latchPresentId(struct sl_oo *oo);
+
+#endif /* LATCH_H */
@@ -0,0 +1,320 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "config.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* a bounded multi producer single consumer ring, every slot carries a
+   sequence number so producers only need one CAS on the head and never
+   wait for each other (Vyukov's bounded queue) */
+struct log_slot {
+    uint32_t seq;
+    uint32_t severity;
+    int32_t id;
+    char message[MSG_LEN];
+};
+
+/* per message id counters, racy on purpose: a lost update only makes the
+   limit slightly fuzzy, which is fine for a log */
+struct log_rate {
+    int32_t id;
+    uint32_t window;
+    uint32_t count;
+    uint32_t suppressed;
+};
+
+static struct log_slot ring[LOG_RING_SIZE];
+static uint32_t ringHead;
+static uint32_t ringTail;
+static uint32_t dropped;
+
+static struct log_rate rates[LOG_RATE_SLOTS];
+
+static pthread_t drainThread;
+static bool initialized;
+static bool stopping;
+
+/* the drain thread waits on wakeCond while the ring is empty. producers
+   only take the lock when it says it is asleep, so the callback stays
+   lock free while messages flow */
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;
+static bool sleeping;
+
+/* after publishing, the fence pairs with the one in drain_sleep so either
+   the producer sees sleeping or the drain thread sees the message */
+static void wake_drain(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleeping, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&wakeLock);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&wakeLock);
+    }
+}
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static const char *severity_name(uint32_t severity) {
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        return "error";
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        return "warning";
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        return "info";
+    }
+    return "verbose";
+}
+
+static bool rate_limited(int32_t id) {
+    struct log_rate *rate =
+        &rates[((uint32_t)id * 2654435761u) & (LOG_RATE_SLOTS - 1)];
+    uint32_t window = now_ms() / LOG_RATE_WINDOW_MS;
+
+    if (__atomic_load_n(&rate->id, __ATOMIC_RELAXED) != id ||
+        __atomic_load_n(&rate->window, __ATOMIC_RELAXED) != window) {
+        /* a new window or a colliding id starts counting from zero */
+        __atomic_store_n(&rate->id, id, __ATOMIC_RELAXED);
+        __atomic_store_n(&rate->window, window, __ATOMIC_RELAXED);
+        __atomic_store_n(&rate->count, 0, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_fetch_add(&rate->count, 1, __ATOMIC_RELAXED) <
+        LOG_RATE_LIMIT) {
+        return false;
+    }
+
+    /* the first one of a window is reported right away */
+    if (__atomic_fetch_add(&rate->suppressed, 1, __ATOMIC_RELAXED) == 0) {
+        wake_drain();
+    }
+    return true;
+}
+
+void log_push(uint32_t severity, int32_t id, const char *message) {
+    if (!initialized || rate_limited(id)) {
+        return;
+    }
+
+    uint32_t pos = __atomic_load_n(&ringHead, __ATOMIC_RELAXED);
+    struct log_slot *slot;
+    for (;;) {
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ringHead, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* full, never block the thread that called into vulkan */
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            wake_drain();
+            return;
+        } else {
+            pos = __atomic_load_n(&ringHead, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->severity = severity;
+    slot->id = id;
+    strncpy(slot->message, message, MSG_LEN - 1);
+    slot->message[MSG_LEN - 1] = '\0';
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    wake_drain();
+}
+
+/* everything below runs on the drain thread only */
+
+struct log_output {
+    char buffer[LOG_WRITE_BUFFER];
+    size_t size;
+
+    /* the last printed message, for folding repeats */
+    int32_t lastId;
+    char last[MSG_LEN];
+    uint32_t repeats;
+};
+
+static void output_flush(struct log_output *out) {
+    if (out->size > 0) {
+        fwrite(out->buffer, 1, out->size, stderr);
+        fflush(stderr);
+        out->size = 0;
+    }
+}
+
+static void output_append(struct log_output *out, const char *format, ...) {
+    va_list argptr;
+    va_start(argptr, format);
+    int n = vsnprintf(out->buffer + out->size,
+                      sizeof(out->buffer) - out->size, format, argptr);
+    va_end(argptr);
+
+    if (n < 0) {
+        return;
+    }
+    if (out->size + n >= sizeof(out->buffer)) {
+        /* did not fit, flush and format again into the empty buffer */
+        output_flush(out);
+        va_start(argptr, format);
+        n = vsnprintf(out->buffer, sizeof(out->buffer), format, argptr);
+        va_end(argptr);
+        if (n < 0) {
+            return;
+        }
+        if (n >= (int)sizeof(out->buffer)) {
+            n = sizeof(out->buffer) - 1;
+        }
+    }
+    out->size += n;
+}
+
+static void output_repeats(struct log_output *out) {
+    if (out->repeats > 0) {
+        output_append(out, "validation layer: last message repeated %u times\n",
+                      out->repeats);
+        out->repeats = 0;
+    }
+}
+
+static bool drain(struct log_output *out) {
+    bool any = false;
+
+    for (;;) {
+        struct log_slot *slot = &ring[ringTail & (LOG_RING_SIZE - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if ((int32_t)(seq - (ringTail + 1)) < 0) {
+            break;
+        }
+
+        if (slot->id == out->lastId && strcmp(slot->message, out->last) == 0) {
+            out->repeats++;
+        } else {
+            output_repeats(out);
+            output_append(out, "validation layer (%s): %s\n",
+                          severity_name(slot->severity), slot->message);
+            out->lastId = slot->id;
+            memcpy(out->last, slot->message, MSG_LEN);
+        }
+
+        __atomic_store_n(&slot->seq, ringTail + LOG_RING_SIZE,
+                         __ATOMIC_RELEASE);
+        ringTail++;
+        any = true;
+    }
+
+    for (int i = 0; i < LOG_RATE_SLOTS; i++) {
+        uint32_t suppressed =
+            __atomic_exchange_n(&rates[i].suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed > 0) {
+            output_repeats(out);
+            output_append(out,
+                          "validation layer: suppressed %u messages with id "
+                          "0x%08x\n",
+                          suppressed, (uint32_t)rates[i].id);
+        }
+    }
+
+    uint32_t lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+    if (lost > 0) {
+        output_repeats(out);
+        output_append(out, "validation layer: dropped %u messages, ring full\n",
+                      lost);
+    }
+
+    output_flush(out);
+    return any;
+}
+
+/* whether anything is waiting in the ring, the counters included */
+static bool pending(void) {
+    struct log_slot *slot = &ring[ringTail & (LOG_RING_SIZE - 1)];
+    if ((int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) -
+                  (ringTail + 1)) >= 0 ||
+        __atomic_load_n(&dropped, __ATOMIC_RELAXED) > 0) {
+        return true;
+    }
+    for (int i = 0; i < LOG_RATE_SLOTS; i++) {
+        if (__atomic_load_n(&rates[i].suppressed, __ATOMIC_RELAXED) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* no wakeups at all while nothing is logged */
+static void drain_sleep(void) {
+    pthread_mutex_lock(&wakeLock);
+    __atomic_store_n(&sleeping, true, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!pending() && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&wakeCond, &wakeLock);
+    }
+    __atomic_store_n(&sleeping, false, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&wakeLock);
+}
+
+static void *drain_main(void *arg) {
+    struct log_output *out = calloc(1, sizeof(struct log_output));
+    out->lastId = -1;
+
+    struct timespec interval = { 0, LOG_DRAIN_INTERVAL_MS * 1000000L };
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        if (drain(out)) {
+            /* more is likely on its way, written in one go */
+            nanosleep(&interval, NULL);
+        } else {
+            drain_sleep();
+        }
+    }
+
+    drain(out);
+    output_repeats(out);
+    output_flush(out);
+    free(out);
+    return NULL;
+}
+
+void log_init(void) {
+    if (initialized) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+        ring[i].seq = i;
+    }
+
+    if (pthread_create(&drainThread, NULL, drain_main, NULL) != 0) {
+        fprintf(stderr, "failed to start log thread!\n");
+        return;
+    }
+
+    initialized = true;
+    atexit(log_shutdown);
+}
+
+void log_shutdown(void) {
+    if (!initialized) {
+        return;
+    }
+    initialized = false;
+
+    __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&wakeLock);
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&wakeLock);
+    pthread_join(drainThread, NULL);
+}
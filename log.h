@@ -0,0 +1,16 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+/* asynchronous logger for the validation layer callback. log_push never
+   blocks and never touches stdio, a background thread drains the ring,
+   folds repeated messages and prints everything in large writes. */
+
+void log_init(void);
+void log_push(uint32_t severity, int32_t id, const char *message);
+/* drains whatever is left and joins the thread, registered with atexit
+   by log_init so messages survive an exit(1) */
+void log_shutdown(void);
+
+#endif /* LOG_H */
@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "mesh.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* the triangle the shader used to have built in, already quantized. the
+   normals are not the geometric ones, they keep its red, green and blue
+   corners: x, y and z are 1,0 0,1 and 0,0 in octahedral */
+static void createTriangleMesh(struct sl_oo *oo, struct sl_mesh *mesh) {
+    struct {
+        struct sl_mesh_vertex vertices[3];
+        uint16_t indices[3];
+    } data = {
+        {
+            { { 32768, 0, 0, 0 }, { 32767, 0 }, { 32768, 0 } },
+            { { 65535, 65535, 0, 0 }, { 0, 32767 }, { 65535, 65535 } },
+            { { 0, 65535, 0, 0 }, { 0, 0 }, { 0, 65535 } },
+        },
+        { 0, 1, 2 },
+    };
+
+    struct sl_mesh_header header = { 0 };
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexCount = 3;
+    header.vertexStride = sizeof(struct sl_mesh_vertex);
+    header.indexCount = 3;
+    header.indexSize = sizeof(uint16_t);
+    header.vertexOffset = 0;
+    header.indexOffset = sizeof(data.vertices);
+    header.dataSize = sizeof(data);
+    header.boundsMin[0] = -0.5f;
+    header.boundsMin[1] = -0.5f;
+    header.boundsMax[0] = 0.5f;
+    header.boundsMax[1] = 0.5f;
+    header.uvMax[0] = 1.0f;
+    header.uvMax[1] = 1.0f;
+    header.lodCount = 1;
+    header.lods[0].indexCount = 3;
+
+    uploadMesh(oo, &header, &data, mesh);
+}
+
+void createMesh(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createMesh");
+
+    if (oo->meshPath != NULL && loadMesh(oo, oo->meshPath, &oo->mesh)) {
+        return;
+    }
+    createTriangleMesh(oo, &oo->mesh);
+}
+
+/* everything a broken or truncated file could get wrong, checked before
+   a byte of it is copied */
+static bool checkHeader(const struct sl_mesh_header *header,
+                        uint64_t fileSize) {
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION) {
+        return false;
+    }
+    if (header->vertexStride != sizeof(struct sl_mesh_vertex) ||
+        (header->indexSize != 2 && header->indexSize != 4)) {
+        return false;
+    }
+    if (header->vertexOffset < sizeof(struct sl_mesh_header) ||
+        header->vertexOffset % MESH_ALIGN != 0 ||
+        header->vertexOffset > fileSize ||
+        header->dataSize > fileSize - header->vertexOffset) {
+        return false;
+    }
+    uint64_t end = header->vertexOffset + header->dataSize;
+    uint64_t vertexEnd = header->vertexOffset +
+                         (uint64_t)header->vertexCount * header->vertexStride;
+    uint64_t indexEnd = header->indexOffset +
+                        (uint64_t)header->indexCount * header->indexSize;
+    if (vertexEnd > header->indexOffset ||
+        header->indexOffset % MESH_ALIGN != 0 || indexEnd > end) {
+        return false;
+    }
+    if (header->lodCount == 0 || header->lodCount > MESH_MAX_LODS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header->lodCount; i++) {
+        const struct sl_mesh_lod *lod = &header->lods[i];
+        if (lod->indexCount == 0 ||
+            (uint64_t)lod->firstIndex + lod->indexCount >
+                header->indexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadMesh(struct sl_oo *oo, const char *path, struct sl_mesh *mesh) {
+    TRACE_ZONE(oo, "loadMesh");
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error_log("cannot open mesh %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (uint64_t)st.st_size < sizeof(struct sl_mesh_header)) {
+        error_log("%s is not a mesh", path);
+        close(fd);
+        return false;
+    }
+
+    /* no read into a buffer of our own, the page cache is the buffer */
+    void *file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        error_log("cannot map mesh %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct sl_mesh_header header;
+    memcpy(&header, file, sizeof(header));
+    if (!checkHeader(&header, st.st_size)) {
+        error_log("%s is not a version %d mesh", path, MESH_VERSION);
+        munmap(file, st.st_size);
+        return false;
+    }
+
+    /* read front to back exactly once, by the memcpy into staging */
+    posix_madvise((uint8_t *)file + header.vertexOffset, header.dataSize,
+                  POSIX_MADV_SEQUENTIAL);
+    uploadMesh(oo, &header, (uint8_t *)file + header.vertexOffset, mesh);
+    munmap(file, st.st_size);
+    return true;
+}
+
+void uploadMesh(struct sl_oo *oo, const struct sl_mesh_header *header,
+                const void *data, struct sl_mesh *mesh) {
+    VkDeviceSize bufferSize = header->dataSize;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(oo, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &stagingBuffer, &stagingBufferMemory);
+
+    void *mapped;
+    vkMapMemory(oo->device, stagingBufferMemory, 0, bufferSize, 0, &mapped);
+    memcpy(mapped, data, bufferSize);
+    vkUnmapMemory(oo->device, stagingBufferMemory);
+
+    createBuffer(oo, bufferSize,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->buffer,
+                 &mesh->memory);
+    copyBuffer(oo, stagingBuffer, mesh->buffer, bufferSize);
+
+    vkDestroyBuffer(oo->device, stagingBuffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, stagingBufferMemory);
+
+    mesh->vertexOffset = 0;
+    mesh->indexOffset = header->indexOffset - header->vertexOffset;
+    mesh->indexType = header->indexSize == 2 ? VK_INDEX_TYPE_UINT16
+                                             : VK_INDEX_TYPE_UINT32;
+    mesh->vertexCount = header->vertexCount;
+    mesh->indexCount = header->indexCount;
+    mesh->lodCount = header->lodCount;
+    memcpy(mesh->lods, header->lods, sizeof(mesh->lods));
+    memcpy(mesh->boundsMin, header->boundsMin, sizeof(mesh->boundsMin));
+    memcpy(mesh->boundsMax, header->boundsMax, sizeof(mesh->boundsMax));
+
+    struct sl_mesh_decode *decode = &mesh->decode;
+    for (int i = 0; i < 3; i++) {
+        decode->positionMin[i] = header->boundsMin[i];
+        decode->positionExtent[i] =
+            header->boundsMax[i] - header->boundsMin[i];
+    }
+    for (int i = 0; i < 2; i++) {
+        decode->uvMin[i] = header->uvMin[i];
+        decode->uvExtent[i] = header->uvMax[i] - header->uvMin[i];
+    }
+}
+
+void destroyMesh(struct sl_oo *oo, struct sl_mesh *mesh) {
+    if (mesh->buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyBuffer(oo->device, mesh->buffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, mesh->memory);
+    mesh->buffer = VK_NULL_HANDLE;
+}
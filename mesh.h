@@ -0,0 +1,51 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "config.h"
+#include "meshfile.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* what the instances are drawn with, a mesh file from --mesh or the
+   original triangle. vertices and indices share one device local
+   buffer, laid out like the file. */
+
+struct sl_oo;
+
+/* push constants of the mesh pipelines, turns the quantized attributes
+   back into view space units and texture coordinates */
+struct sl_mesh_decode {
+    float positionMin[4];
+    float positionExtent[4];
+    float uvMin[2];
+    float uvExtent[2];
+};
+
+struct sl_mesh {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    /* offsets into buffer */
+    VkDeviceSize vertexOffset;
+    VkDeviceSize indexOffset;
+    VkIndexType indexType;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    struct sl_mesh_lod lods[MESH_MAX_LODS];
+    float boundsMin[3];
+    float boundsMax[3];
+    struct sl_mesh_decode decode;
+};
+
+/* after createCommandPool, loads oo->meshPath or makes the triangle */
+void createMesh(struct sl_oo *oo);
+/* false if the file is missing or not a mesh of this version */
+bool loadMesh(struct sl_oo *oo, const char *path, struct sl_mesh *mesh);
+/* data is the blobs as they are in the file, from vertexOffset on */
+void uploadMesh(struct sl_oo *oo, const struct sl_mesh_header *header,
+                const void *data, struct sl_mesh *mesh);
+void destroyMesh(struct sl_oo *oo, struct sl_mesh *mesh);
+
+#endif /* MESH_H */
@@ -0,0 +1,72 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <stdint.h>
+
+/* the prebaked mesh format written by tools/meshconv and read by
+   loadMesh. a header, then the vertex and index blobs exactly as they go
+   into the gpu buffer, so loading is an mmap and one memcpy. little
+   endian, which is every platform we run on.
+
+   positions are in view space units: x right, y down, z away from the
+   camera, the converter flips obj and gltf into that. front faces are
+   clockwise on screen, like the triangle.
+
+   attributes are quantized to 16 bytes a vertex, shader.vert decodes
+   them with the ranges from the header. triangles are ordered for the
+   post-transform cache and then for overdraw, vertices in the order the
+   triangles first use them.
+
+   lower levels of detail follow the full mesh in the index blob, they
+   index the same vertices. */
+
+/* "SLMS" */
+#define MESH_MAGIC 0x534d4c53u
+#define MESH_VERSION 3
+/* the header is padded to this and both blobs start on it, enough for
+   any minStorageBufferOffsetAlignment or vertex offset we care about */
+#define MESH_ALIGN 256
+/* the full mesh and up to three simplified ones */
+#define MESH_MAX_LODS 4
+
+struct sl_mesh_vertex {
+    /* unorm across boundsMin to boundsMax, the fourth is padding since
+       three component 16 bit formats are rarely supported for vertices */
+    uint16_t position[4];
+    /* snorm, octahedral */
+    int16_t normal[2];
+    /* unorm across uvMin to uvMax */
+    uint16_t uv[2];
+};
+
+/* a range of the index blob */
+struct sl_mesh_lod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+struct sl_mesh_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    /* of every lod together */
+    uint32_t indexCount;
+    /* 2 or 4 */
+    uint32_t indexSize;
+    /* from the start of the file, the data from vertexOffset to the end of
+       the file is uploaded as is */
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t dataSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    float uvMin[2];
+    float uvMax[2];
+    /* lod 0 is the full mesh, every one after it has roughly half the
+       triangles of the one before */
+    uint32_t lodCount;
+    struct sl_mesh_lod lods[MESH_MAX_LODS];
+};
+
+#endif /* MESHFILE_H */
@@ -0,0 +1,768 @@
+#include "renderer.h"
+#include "occlusion.h"
+
+/* local sizes of the shaders, the dispatches are counted in them */
+#define OCCLUSION_GROUP 64
+#define OCCLUSION_TILE 8
+
+/* the early set's commands, then the late set's */
+#define OCCLUSION_DRAWS (2 * MESH_MAX_LODS)
+
+/* the depth is sampled between the passes, the pyramid written and read
+   in compute, all of it on the graphics queue */
+static bool supportsOcclusion(struct sl_oo *oo) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(
+        oo->physicalDevice, findDepthFormat(oo->physicalDevice),
+        &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        return false;
+    }
+    vkGetPhysicalDeviceFormatProperties(oo->physicalDevice,
+                                        VK_FORMAT_R32_SFLOAT,
+                                        &formatProperties);
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if ((formatProperties.optimalTilingFeatures & features) != features) {
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    if (!(properties.limits.sampledImageDepthSampleCounts &
+          oo->msaaSamples)) {
+        return false;
+    }
+
+    return graphicsQueueSupportsCompute(oo);
+}
+
+void createOcclusion(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createOcclusion");
+
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    if (!occlusion->enabled) {
+        return;
+    }
+    if (!supportsOcclusion(oo)) {
+        error_log("occlusion culling is not supported by this device, "
+                  "rendering without it");
+        return;
+    }
+
+    /* every texel is fetched, nothing is filtered */
+    VkSamplerCreateInfo samplerInfo = { 0 };
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(oo->device, &samplerInfo,
+                        hostAllocator(oo, ALLOC_DESCRIPTORS),
+                        &occlusion->sampler) != VK_SUCCESS) {
+        error_log("failed to create occlusion sampler!");
+        exit(1);
+    }
+
+    /* the level above, or the depth buffer, and the level written */
+    VkDescriptorSetLayoutBinding bindings[2] = { 0 };
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &occlusion->reduceSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create occlusion descriptor set layout!");
+        exit(1);
+    }
+
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(struct sl_occlusion_reduce);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &occlusion->reduceSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &occlusion->reduceLayout) != VK_SUCCESS) {
+        error_log("failed to create occlusion pipeline layout!");
+        exit(1);
+    }
+
+    occlusion->reduce = createComputePipeline(
+        oo, "shaders/occlusion_reduce.spv", occlusion->reduceLayout);
+    if (oo->msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        occlusion->reduceSamples = createComputePipeline(
+            oo, "shaders/occlusion_reduce_ms.spv", occlusion->reduceLayout);
+    }
+
+    occlusion->active = true;
+    fprintf(stderr, "occlusion culling with a depth pyramid\n");
+}
+
+void destroyOcclusion(struct sl_oo *oo) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    if (occlusion->reduceLayout == VK_NULL_HANDLE) {
+        return;
+    }
+
+    if (occlusion->testLayout != VK_NULL_HANDLE) {
+        vkDestroyPipeline(oo->device, occlusion->early,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyPipeline(oo->device, occlusion->late,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyPipelineLayout(oo->device, occlusion->testLayout,
+                                hostAllocator(oo, ALLOC_PIPELINES));
+        /* the set goes with the pool */
+        vkDestroyDescriptorPool(oo->device, occlusion->descriptorPool,
+                                hostAllocator(oo, ALLOC_DESCRIPTORS));
+        vkDestroyDescriptorSetLayout(oo->device, occlusion->testSetLayout,
+                                     hostAllocator(oo, ALLOC_PIPELINES));
+
+        VkBuffer buffers[5] = { occlusion->idBuffer,
+                                occlusion->visibilityBuffer,
+                                occlusion->drawBuffer,
+                                occlusion->indirectBuffer,
+                                occlusion->readbackBuffer };
+        VkDeviceMemory memory[5] = { occlusion->idMemory,
+                                     occlusion->visibilityMemory,
+                                     occlusion->drawMemory,
+                                     occlusion->indirectMemory,
+                                     occlusion->readbackMemory };
+        vkUnmapMemory(oo->device, occlusion->idMemory);
+        vkUnmapMemory(oo->device, occlusion->readbackMemory);
+        for (int i = 0; i < 5; i++) {
+            vkDestroyBuffer(oo->device, buffers[i],
+                            hostAllocator(oo, ALLOC_BUFFERS));
+            freeDeviceMemory(oo, memory[i]);
+        }
+        free(occlusion->readbackPending);
+    }
+
+    if (occlusion->reduceSamples != VK_NULL_HANDLE) {
+        vkDestroyPipeline(oo->device, occlusion->reduceSamples,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    vkDestroyPipeline(oo->device, occlusion->reduce,
+                      hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroyPipelineLayout(oo->device, occlusion->reduceLayout,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroyDescriptorSetLayout(oo->device, occlusion->reduceSetLayout,
+                                 hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroySampler(oo->device, occlusion->sampler,
+                     hostAllocator(oo, ALLOC_DESCRIPTORS));
+    memset(occlusion, 0, sizeof(*occlusion));
+}
+
+/* the late test reads the primary target's pyramid, which is made again
+   with its swapchain */
+static void writePyramid(struct sl_oo *oo) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    struct sl_occlusion_target *ot = &oo->targets[0].occlusion;
+    if (occlusion->set == VK_NULL_HANDLE || ot->pyramid == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkDescriptorImageInfo imageInfo = { 0 };
+    imageInfo.sampler = occlusion->sampler;
+    imageInfo.imageView = ot->pyramidView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet write = { 0 };
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = occlusion->set;
+    write.dstBinding = 6;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(oo->device, 1, &write, 0, NULL);
+}
+
+void createOcclusionBuffers(struct sl_oo *oo) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    if (!occlusion->active) {
+        return;
+    }
+    TRACE_ZONE(oo, "createOcclusionBuffers");
+
+    VkDeviceSize capacity = oo->instanceCapacity;
+    VkDeviceSize drawsSize =
+        sizeof(VkDrawIndexedIndirectCommand) * OCCLUSION_DRAWS;
+
+    /* written by the culling next to the instances, like them */
+    createBuffer(oo, sizeof(uint32_t) * capacity * MAX_FRAMES_IN_FLIGHT,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &occlusion->idBuffer, &occlusion->idMemory);
+    vkMapMemory(oo->device, occlusion->idMemory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&occlusion->ids);
+    createBuffer(oo, sizeof(uint32_t) * capacity,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 &occlusion->visibilityBuffer, &occlusion->visibilityMemory);
+    occlusion->visibilityCleared = false;
+    createBuffer(oo, sizeof(struct sl_instance) * capacity * 2,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &occlusion->drawBuffer,
+                 &occlusion->drawMemory);
+    createBuffer(oo, drawsSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 &occlusion->indirectBuffer, &occlusion->indirectMemory);
+    createBuffer(oo, drawsSize * MAX_FRAMES_IN_FLIGHT,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &occlusion->readbackBuffer, &occlusion->readbackMemory);
+    vkMapMemory(oo->device, occlusion->readbackMemory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&occlusion->readback);
+    occlusion->readbackPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+
+    /* the instances and their ids, the flags, both sets, the draws and
+       the pyramid */
+    VkDescriptorSetLayoutBinding bindings[7] = { 0 };
+    for (uint32_t i = 0; i < 7; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 7;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &occlusion->testSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create occlusion descriptor set layout!");
+        exit(1);
+    }
+
+    VkDescriptorPoolSize poolSizes[2] = { 0 };
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 6;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &occlusion->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create occlusion descriptor pool!");
+        exit(1);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = occlusion->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &occlusion->testSetLayout;
+
+    if (vkAllocateDescriptorSets(oo->device, &allocInfo, &occlusion->set) !=
+        VK_SUCCESS) {
+        error_log("failed to allocate occlusion descriptor set!");
+        exit(1);
+    }
+
+    /* whole buffers, the push constants say where the frame's region is */
+    VkBuffer buffers[6] = { oo->instanceBuffer,
+                            occlusion->idBuffer,
+                            occlusion->visibilityBuffer,
+                            occlusion->drawBuffer,
+                            occlusion->drawBuffer,
+                            occlusion->indirectBuffer };
+    VkDeviceSize setSize = sizeof(struct sl_instance) * capacity;
+    VkDescriptorBufferInfo bufferInfos[6] = { 0 };
+    VkWriteDescriptorSet writes[6] = { 0 };
+    for (int i = 0; i < 6; i++) {
+        bufferInfos[i].buffer = buffers[i];
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = occlusion->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    /* the early set, and the late one after it */
+    bufferInfos[3].range = setSize;
+    bufferInfos[4].offset = setSize;
+    bufferInfos[4].range = setSize;
+    vkUpdateDescriptorSets(oo->device, 6, writes, 0, NULL);
+    writePyramid(oo);
+
+    VkDescriptorSetLayout setLayouts[2] = { occlusion->testSetLayout,
+                                            oo->latch.descriptorSetLayout };
+
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(struct sl_occlusion_params);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &occlusion->testLayout) != VK_SUCCESS) {
+        error_log("failed to create occlusion pipeline layout!");
+        exit(1);
+    }
+
+    occlusion->early = createComputePipeline(
+        oo, "shaders/occlusion_early.spv", occlusion->testLayout);
+    occlusion->late = createComputePipeline(
+        oo, "shaders/occlusion_late.spv", occlusion->testLayout);
+}
+
+bool occlusionSplitsPass(struct sl_oo *oo, struct sl_target *target) {
+    return oo->occlusion.active && target == &oo->targets[0];
+}
+
+/* the largest power of two not above v */
+static uint32_t floorPow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p * 2 <= v && p * 2 != 0) {
+        p *= 2;
+    }
+    return p;
+}
+
+void createOcclusionTarget(struct sl_oo *oo, struct sl_target *target) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    if (!occlusionSplitsPass(oo, target)) {
+        return;
+    }
+    TRACE_ZONE(oo, "createOcclusionTarget");
+
+    /* a power of two, every level after the first is exactly a 2x2
+       reduction and a texel of any level covers the same part of the
+       screen */
+    struct sl_occlusion_target *ot = &target->occlusion;
+    ot->extent.width = floorPow2(target->swapChainExtent.width);
+    ot->extent.height = floorPow2(target->swapChainExtent.height);
+    uint32_t size = ot->extent.width > ot->extent.height
+                        ? ot->extent.width
+                        : ot->extent.height;
+    ot->levels = 1;
+    while ((size >> ot->levels) > 0 && ot->levels < OCCLUSION_MAX_LEVELS) {
+        ot->levels++;
+    }
+
+    VkImageCreateInfo imageInfo = { 0 };
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = ot->extent.width;
+    imageInfo.extent.height = ot->extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = ot->levels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage =
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(oo->device, &imageInfo, hostAllocator(oo, ALLOC_IMAGES),
+                      &ot->pyramid) != VK_SUCCESS) {
+        error_log("failed to create depth pyramid!");
+        exit(1);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(oo->device, ot->pyramid, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex =
+        findMemoryType(oo->physicalDevice, memRequirements.memoryTypeBits,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (allocateDeviceMemory(oo, &allocInfo, &ot->pyramidMemory) !=
+        VK_SUCCESS) {
+        error_log("failed to allocate depth pyramid memory!");
+        exit(1);
+    }
+    vkBindImageMemory(oo->device, ot->pyramid, ot->pyramidMemory, 0);
+
+    VkImageViewCreateInfo viewInfo = { 0 };
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = ot->pyramid;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = ot->levels;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(oo->device, &viewInfo,
+                          hostAllocator(oo, ALLOC_IMAGES),
+                          &ot->pyramidView) != VK_SUCCESS) {
+        error_log("failed to create depth pyramid view!");
+        exit(1);
+    }
+    viewInfo.subresourceRange.levelCount = 1;
+    for (uint32_t i = 0; i < ot->levels; i++) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        if (vkCreateImageView(oo->device, &viewInfo,
+                              hostAllocator(oo, ALLOC_IMAGES),
+                              &ot->levelViews[i]) != VK_SUCCESS) {
+            error_log("failed to create depth pyramid view!");
+            exit(1);
+        }
+    }
+
+    VkDescriptorPoolSize poolSizes[2] = { 0 };
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = ot->levels;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = ot->levels;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = ot->levels;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &ot->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create occlusion descriptor pool!");
+        exit(1);
+    }
+
+    /* the first level reads the depth as the early pass left it, every
+       other one the level before */
+    VkExtent2D src = target->swapChainExtent;
+    for (uint32_t i = 0; i < ot->levels; i++) {
+        VkExtent2D dst = { ot->extent.width >> i, ot->extent.height >> i };
+        dst.width = dst.width > 0 ? dst.width : 1;
+        dst.height = dst.height > 0 ? dst.height : 1;
+        struct sl_occlusion_reduce *reduce = &ot->reduce[i];
+        reduce->srcWidth = src.width;
+        reduce->srcHeight = src.height;
+        reduce->dstWidth = dst.width;
+        reduce->dstHeight = dst.height;
+        reduce->samples = i == 0 ? (uint32_t)oo->msaaSamples : 1;
+        src = dst;
+
+        VkDescriptorSetAllocateInfo setInfo = { 0 };
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = ot->descriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &occlusion->reduceSetLayout;
+        if (vkAllocateDescriptorSets(oo->device, &setInfo, &ot->sets[i]) !=
+            VK_SUCCESS) {
+            error_log("failed to allocate occlusion descriptor set!");
+            exit(1);
+        }
+
+        VkDescriptorImageInfo imageInfos[2] = { 0 };
+        imageInfos[0].sampler = occlusion->sampler;
+        imageInfos[0].imageView =
+            i == 0 ? target->depthImageView : ot->levelViews[i - 1];
+        imageInfos[0].imageLayout =
+            i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                   : VK_IMAGE_LAYOUT_GENERAL;
+        imageInfos[1].imageView = ot->levelViews[i];
+        imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2] = { 0 };
+        for (int w = 0; w < 2; w++) {
+            writes[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[w].dstSet = ot->sets[i];
+            writes[w].dstBinding = w;
+            writes[w].descriptorCount = 1;
+            writes[w].pImageInfo = &imageInfos[w];
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        vkUpdateDescriptorSets(oo->device, 2, writes, 0, NULL);
+    }
+
+    writePyramid(oo);
+}
+
+void destroyOcclusionTarget(struct sl_oo *oo, struct sl_target *target) {
+    struct sl_occlusion_target *ot = &target->occlusion;
+    if (ot->pyramid == VK_NULL_HANDLE) {
+        return;
+    }
+
+    /* the sets go with the pool */
+    vkDestroyDescriptorPool(oo->device, ot->descriptorPool,
+                            hostAllocator(oo, ALLOC_DESCRIPTORS));
+    for (uint32_t i = 0; i < ot->levels; i++) {
+        vkDestroyImageView(oo->device, ot->levelViews[i],
+                           hostAllocator(oo, ALLOC_IMAGES));
+    }
+    vkDestroyImageView(oo->device, ot->pyramidView,
+                       hostAllocator(oo, ALLOC_IMAGES));
+    vkDestroyImage(oo->device, ot->pyramid, hostAllocator(oo, ALLOC_IMAGES));
+    freeDeviceMemory(oo, ot->pyramidMemory);
+    memset(ot, 0, sizeof(*ot));
+}
+
+static void memoryBarrier(VkCommandBuffer commandBuffer,
+                          VkPipelineStageFlags srcStage,
+                          VkAccessFlags srcAccess,
+                          VkPipelineStageFlags dstStage,
+                          VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier = { 0 };
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0,
+                         NULL, 0, NULL);
+}
+
+/* one invocation per instance the frustum let through */
+static void dispatchTest(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         VkPipeline pipeline) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    struct sl_occlusion_target *ot = &oo->targets[0].occlusion;
+    struct sl_cull *cull = &oo->cull;
+
+    struct sl_occlusion_params params = { 0 };
+    for (int k = 0; k < 3; k++) {
+        params.sphere[k] = cull->meshCenter[k];
+    }
+    /* every instance has the same sphere */
+    params.sphere[3] = cull->radius[0];
+    params.pyramidWidth = ot->extent.width;
+    params.pyramidHeight = ot->extent.height;
+    params.pyramidLevels = ot->levels;
+    params.base = oo->instanceCapacity * oo->currentFrame;
+    params.count = cull->visible;
+    params.lodCount = cull->lodCount;
+    memcpy(params.lodFirst, cull->lodFirst, sizeof(params.lodFirst));
+
+    /* the late test takes the camera moves the latch adds */
+    VkDescriptorSet sets[2] = { occlusion->set, oo->latch.descriptorSet };
+    uint32_t offset = (uint32_t)(oo->latch.slotSize * oo->currentFrame);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            occlusion->testLayout, 0, 2, sets, 1, &offset);
+    vkCmdPushConstants(commandBuffer, occlusion->testLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params),
+                       &params);
+    vkCmdDispatch(commandBuffer,
+                  (cull->visible + OCCLUSION_GROUP - 1) / OCCLUSION_GROUP, 1,
+                  1);
+}
+
+void recordOcclusionEarly(struct sl_oo *oo, VkCommandBuffer commandBuffer) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    struct sl_mesh *mesh = &oo->mesh;
+    struct sl_cull *cull = &oo->cull;
+
+    /* the last frame is done drawing from the buffers and testing into
+       them, its flags are visible */
+    memoryBarrier(commandBuffer,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                      VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    /* nothing was visible before the first frame */
+    if (!occlusion->visibilityCleared) {
+        vkCmdFillBuffer(commandBuffer, occlusion->visibilityBuffer, 0,
+                        VK_WHOLE_SIZE, 0);
+        occlusion->visibilityCleared = true;
+    }
+
+    /* a draw per level for each set, the tests count the instances */
+    VkDrawIndexedIndirectCommand draws[OCCLUSION_DRAWS] = { 0 };
+    for (uint32_t set = 0; set < 2; set++) {
+        for (uint32_t lod = 0; lod < mesh->lodCount; lod++) {
+            VkDrawIndexedIndirectCommand *draw =
+                &draws[set * MESH_MAX_LODS + lod];
+            draw->indexCount = mesh->lods[lod].indexCount;
+            draw->firstIndex = mesh->lods[lod].firstIndex;
+            draw->firstInstance = cull->lodFirst[lod];
+        }
+    }
+    vkCmdUpdateBuffer(commandBuffer, occlusion->indirectBuffer, 0,
+                      sizeof(draws), draws);
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    dispatchTest(oo, commandBuffer, occlusion->early);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void recordOcclusionLate(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         struct sl_target *target) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    struct sl_occlusion_target *ot = &target->occlusion;
+
+    /* rebuilt every frame, the last frame's test is done reading it. the
+       early pass made its depth readable on the way out */
+    VkImageMemoryBarrier barrier = { 0 };
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = ot->pyramid;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = ot->levels;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    /* every level is the farthest depth of what it covers in the one
+       before */
+    bool samples = oo->msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t i = 0; i < ot->levels; i++) {
+        if (i <= 1) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              i == 0 && samples ? occlusion->reduceSamples
+                                                : occlusion->reduce);
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                occlusion->reduceLayout, 0, 1, &ot->sets[i],
+                                0, NULL);
+        vkCmdPushConstants(commandBuffer, occlusion->reduceLayout,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(ot->reduce[i]), &ot->reduce[i]);
+        vkCmdDispatch(commandBuffer,
+                      (ot->reduce[i].dstWidth + OCCLUSION_TILE - 1) /
+                          OCCLUSION_TILE,
+                      (ot->reduce[i].dstHeight + OCCLUSION_TILE - 1) /
+                          OCCLUSION_TILE,
+                      1);
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    dispatchTest(oo, commandBuffer, occlusion->late);
+
+    /* the late pass and the other targets draw it, the stats read back
+       how much */
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                      VK_ACCESS_TRANSFER_READ_BIT);
+
+    VkDeviceSize drawsSize =
+        sizeof(VkDrawIndexedIndirectCommand) * OCCLUSION_DRAWS;
+    VkBufferCopy region = { 0 };
+    region.dstOffset = drawsSize * oo->currentFrame;
+    region.size = drawsSize;
+    vkCmdCopyBuffer(commandBuffer, occlusion->indirectBuffer,
+                    occlusion->readbackBuffer, 1, &region);
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                  VK_ACCESS_HOST_READ_BIT);
+    occlusion->readbackPending[oo->currentFrame] = true;
+}
+
+void drawOcclusionSet(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                      enum OcclusionSet set, uint32_t lod) {
+    uint32_t draw = (set == OCCLUSION_LATE ? MESH_MAX_LODS : 0) + lod;
+    vkCmdDrawIndexedIndirect(
+        commandBuffer, oo->occlusion.indirectBuffer,
+        sizeof(VkDrawIndexedIndirectCommand) * draw, 1,
+        sizeof(VkDrawIndexedIndirectCommand));
+}
+
+VkBuffer occlusionInstances(struct sl_oo *oo, enum OcclusionSet set,
+                            VkDeviceSize *offset) {
+    VkDeviceSize region = sizeof(struct sl_instance) * oo->instanceCapacity;
+    switch (set) {
+    case OCCLUSION_EARLY:
+        *offset = 0;
+        return oo->occlusion.drawBuffer;
+    case OCCLUSION_LATE:
+        *offset = region;
+        return oo->occlusion.drawBuffer;
+    default:
+        *offset = region * oo->currentFrame;
+        return oo->instanceBuffer;
+    }
+}
+
+void collectOcclusion(struct sl_oo *oo) {
+    struct sl_occlusion *occlusion = &oo->occlusion;
+    if (occlusion->readbackPending == NULL ||
+        !occlusion->readbackPending[oo->currentFrame]) {
+        return;
+    }
+
+    const VkDrawIndexedIndirectCommand *draws =
+        occlusion->readback + OCCLUSION_DRAWS * oo->currentFrame;
+    uint32_t drawn = 0;
+    for (uint32_t i = 0; i < OCCLUSION_DRAWS; i++) {
+        drawn += draws[i].instanceCount;
+    }
+    oo->stats.drawnInstances = drawn;
+    occlusion->readbackPending[oo->currentFrame] = false;
+}
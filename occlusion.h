@@ -0,0 +1,158 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "config.h"
+#include "meshfile.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* occlusion culling on the gpu, after cullInstances took out what is
+   outside the frustum. every instance keeps a flag of whether it was
+   visible last frame. the early compute pass copies the frustum's
+   survivors that were into the draw buffer and the primary target draws
+   them. a compute min-reduction then turns that depth into a pyramid,
+   reverse-z so the smallest value is the farthest. the late pass tests
+   the bounding sphere of every survivor against the pyramid level
+   where it covers at most 2x2 texels, writes the new flags and copies
+   the ones that just became visible, which are drawn in a second render
+   pass. both passes count their instances per level of detail into
+   indirect draws, the instances in the draw buffer keep the ranges
+   cullInstances gave every level. the other targets draw both sets,
+   the view is the same, only their size differs. */
+
+struct sl_oo;
+struct sl_target;
+
+enum OcclusionSet {
+    /* what cullInstances wrote, drawn directly */
+    OCCLUSION_NONE,
+    /* visible last frame */
+    OCCLUSION_EARLY,
+    /* passed the depth pyramid of the early set */
+    OCCLUSION_LATE,
+};
+
+/* push constants of occlusion.comp */
+struct sl_occlusion_params {
+    /* from an instance to the center of its bounding sphere, w is the
+       radius */
+    float sphere[4];
+    /* of the pyramid's first level */
+    uint32_t pyramidWidth;
+    uint32_t pyramidHeight;
+    uint32_t pyramidLevels;
+    /* the frame's region of the instance and id buffers */
+    uint32_t base;
+    uint32_t count;
+    uint32_t lodCount;
+    uint32_t lodFirst[MESH_MAX_LODS];
+};
+
+/* push constants of occlusion_reduce.comp */
+struct sl_occlusion_reduce {
+    uint32_t srcWidth;
+    uint32_t srcHeight;
+    uint32_t dstWidth;
+    uint32_t dstHeight;
+    uint32_t samples;
+};
+
+/* the primary target's depth pyramid, made again with its swapchain */
+struct sl_occlusion_target {
+    VkImage pyramid;
+    VkDeviceMemory pyramidMemory;
+    /* every level, for the test */
+    VkImageView pyramidView;
+    /* one level each, for the reduction */
+    VkImageView levelViews[OCCLUSION_MAX_LEVELS];
+    uint32_t levels;
+    VkExtent2D extent;
+
+    /* a set and its sizes per level, the first one reads the depth */
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[OCCLUSION_MAX_LEVELS];
+    struct sl_occlusion_reduce reduce[OCCLUSION_MAX_LEVELS];
+};
+
+struct sl_occlusion {
+    /* option, set before createOcclusion */
+    bool enabled;
+
+    /* enabled and the device can run it */
+    bool active;
+    VkSampler sampler;
+    VkDescriptorSetLayout reduceSetLayout;
+    VkPipelineLayout reduceLayout;
+    VkPipeline reduce;
+    /* the first level from a multisampled depth buffer */
+    VkPipeline reduceSamples;
+
+    /* the tests, the latch is their second set */
+    VkDescriptorSetLayout testSetLayout;
+    VkPipelineLayout testLayout;
+    VkPipeline early;
+    VkPipeline late;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+
+    /* persistently mapped, instanceCapacity per frame in flight, which
+       instance every slot of the instance buffer is */
+    VkBuffer idBuffer;
+    VkDeviceMemory idMemory;
+    uint32_t *ids;
+    /* one uint per instance, whether it was visible last frame */
+    VkBuffer visibilityBuffer;
+    VkDeviceMemory visibilityMemory;
+    bool visibilityCleared;
+    /* instanceCapacity for each set */
+    VkBuffer drawBuffer;
+    VkDeviceMemory drawMemory;
+    /* a VkDrawIndexedIndirectCommand per level for each set */
+    VkBuffer indirectBuffer;
+    VkDeviceMemory indirectMemory;
+    /* the frames' indirect commands once they ran, for the stats */
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackMemory;
+    VkDrawIndexedIndirectCommand *readback;
+    bool *readbackPending;
+
+    /* the frame being recorded tests, the primary target has an image
+       and there is something to draw */
+    bool frame;
+};
+
+/* after createLogicalDevice and before createSwapChain, does nothing
+   unless enabled */
+void createOcclusion(struct sl_oo *oo);
+void destroyOcclusion(struct sl_oo *oo);
+
+/* from createInstanceBuffer, after the latch */
+void createOcclusionBuffers(struct sl_oo *oo);
+
+/* with the primary target's depth buffer, which it reads */
+void createOcclusionTarget(struct sl_oo *oo, struct sl_target *target);
+void destroyOcclusionTarget(struct sl_oo *oo, struct sl_target *target);
+
+/* the target's pass is split around the tests, its depth is sampled
+   and its attachments are stored in between, none of them transient */
+bool occlusionSplitsPass(struct sl_oo *oo, struct sl_target *target);
+
+/* before the primary target's early pass, the early test */
+void recordOcclusionEarly(struct sl_oo *oo, VkCommandBuffer commandBuffer);
+/* between its passes, the pyramid and the late test */
+void recordOcclusionLate(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         struct sl_target *target);
+/* the set's draws, inside a render pass with the mesh and the pipeline
+   bound */
+void drawOcclusionSet(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                      enum OcclusionSet set, uint32_t lod);
+/* the instance buffer and its offset to bind for a set */
+VkBuffer occlusionInstances(struct sl_oo *oo, enum OcclusionSet set,
+                            VkDeviceSize *offset);
+
+/* after the frame's fence, the instances its tests let through */
+void collectOcclusion(struct sl_oo *oo);
+
+#endif /* OCCLUSION_H */
@@ -0,0 +1,851 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "pipeline.h"
+
+#include <unistd.h>
+
+/* fnv-1a over the key bytes */
+static uint64_t hashKey(const struct sl_pipeline_key *key) {
+    const uint8_t *bytes = (const uint8_t *)key;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* the entry for key, or the slot it would go into, the first tombstone
+   on the way if there is one. the load limit keeps an empty slot around,
+   so this always finds something */
+static struct sl_pipeline_entry *findEntry(struct sl_pipelines *pipelines,
+                                           const struct sl_pipeline_key *key,
+                                           uint64_t hash) {
+    uint32_t mask = PIPELINE_REGISTRY_SIZE - 1;
+    struct sl_pipeline_entry *tombstone = NULL;
+    uint32_t i = (uint32_t)hash & mask;
+    for (int probe = 0; probe < PIPELINE_REGISTRY_SIZE; probe++) {
+        struct sl_pipeline_entry *entry = &pipelines->entries[i];
+        uint32_t state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        if (state == PIPELINE_EMPTY) {
+            return tombstone != NULL ? tombstone : entry;
+        }
+        if (state == PIPELINE_RETIRED) {
+            if (tombstone == NULL) {
+                tombstone = entry;
+            }
+        } else if (entry->hash == hash &&
+                   memcmp(&entry->key, key, sizeof(*key)) == 0) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+    return tombstone;
+}
+
+/* rehashes without the tombstones. entry indices change, so the workers
+   must have drained the queue. without wait it gives up instead of
+   stalling the frame. only happens after many reloads */
+static bool compactRegistry(struct sl_pipelines *pipelines, bool wait) {
+    pthread_mutex_lock(&pipelines->lock);
+    while (wait && pipelines->building > 0) {
+        pthread_cond_wait(&pipelines->cond, &pipelines->lock);
+    }
+    bool idle = pipelines->building == 0;
+    pthread_mutex_unlock(&pipelines->lock);
+    if (!idle) {
+        return false;
+    }
+
+    static struct sl_pipeline_entry live[PIPELINE_REGISTRY_SIZE];
+    uint32_t liveCount = 0;
+    for (int i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+        struct sl_pipeline_entry *entry = &pipelines->entries[i];
+        if (entry->state != PIPELINE_EMPTY &&
+            entry->state != PIPELINE_RETIRED) {
+            live[liveCount++] = *entry;
+        }
+    }
+    memset(pipelines->entries, 0, sizeof(pipelines->entries));
+    for (uint32_t i = 0; i < liveCount; i++) {
+        *findEntry(pipelines, &live[i].key, live[i].hash) = live[i];
+    }
+    pipelines->used = liveCount;
+    return true;
+}
+
+/* once, however often the frame asks */
+static void deferPipeline(struct sl_pipelines *pipelines,
+                          const struct sl_pipeline_key *key) {
+    for (uint32_t i = 0; i < pipelines->deferredCount; i++) {
+        if (memcmp(&pipelines->deferred[i], key, sizeof(*key)) == 0) {
+            return;
+        }
+    }
+    if (pipelines->deferredCount < PIPELINE_REGISTRY_SIZE) {
+        pipelines->deferred[pipelines->deferredCount++] = *key;
+    }
+}
+
+static int findShaderSet(struct sl_pipelines *pipelines, uint32_t generation) {
+    for (int i = 0; i < PIPELINE_SHADER_SETS; i++) {
+        if (pipelines->shaders[i].used &&
+            pipelines->shaders[i].generation == generation) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* frame is the first selectPipelines call that may destroy it */
+static void retirePipeline(struct sl_pipelines *pipelines,
+                           struct sl_pipeline_entry *entry, uint64_t frame) {
+    if (entry->state == PIPELINE_READY) {
+        if (pipelines->retiredCount == PIPELINE_REGISTRY_SIZE) {
+            error_log("too many retired pipelines!");
+            exit(1);
+        }
+        struct sl_retired_pipeline *retired =
+            &pipelines->retired[pipelines->retiredCount++];
+        retired->pipeline = entry->pipeline;
+        retired->frame = frame;
+    }
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->state = PIPELINE_RETIRED;
+    pipelines->count--;
+    pipelines->shaders[entry->shaderSet].users--;
+}
+
+static void *pipelineWorker(void *arg) {
+    struct sl_oo *oo = arg;
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    traceThreadName(oo, "pipeline worker");
+
+    for (;;) {
+        pthread_mutex_lock(&pipelines->lock);
+        while (pipelines->queueCount == 0 && !pipelines->stopping) {
+            pthread_cond_wait(&pipelines->cond, &pipelines->lock);
+        }
+        if (pipelines->stopping) {
+            pthread_mutex_unlock(&pipelines->lock);
+            return NULL;
+        }
+        int index = pipelines->queue[pipelines->queueHead];
+        pipelines->queueHead =
+            (pipelines->queueHead + 1) % PIPELINE_REGISTRY_SIZE;
+        pipelines->queueCount--;
+        pthread_mutex_unlock(&pipelines->lock);
+
+        /* the key is not written again once the entry is queued */
+        struct sl_pipeline_entry *entry = &pipelines->entries[index];
+        struct sl_shader_set *shaders = &pipelines->shaders[entry->shaderSet];
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        struct sl_trace_zone zone = traceZoneBegin(oo, "compile pipeline");
+        VkResult result = buildGraphicsPipeline(
+            oo, &entry->key, shaders->vertShaderModule,
+            shaders->fragShaderModule, &pipeline);
+        traceZoneEnd(&zone);
+        if (result != VK_SUCCESS) {
+            error_log("failed to create graphics pipeline variant: %d",
+                      result);
+        }
+        entry->pipeline = pipeline;
+        __atomic_store_n(&entry->state,
+                         result == VK_SUCCESS ? PIPELINE_READY
+                                              : PIPELINE_FAILED,
+                         __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&pipelines->lock);
+        pipelines->building--;
+        pthread_cond_broadcast(&pipelines->cond);
+        pthread_mutex_unlock(&pipelines->lock);
+    }
+}
+
+/* a cache from another driver or device is not an error, the driver
+   would ignore it anyway, so it is dropped before it gets there */
+static void *loadPipelineCache(struct sl_oo *oo, size_t *size) {
+    *size = 0;
+    FILE *fp = fopen(PIPELINE_CACHE_PATH, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (length < (long)sizeof(VkPipelineCacheHeaderVersionOne)) {
+        fclose(fp);
+        return NULL;
+    }
+
+    void *data = malloc(length);
+    if (fread(data, 1, length, fp) != (size_t)length) {
+        fclose(fp);
+        free(data);
+        return NULL;
+    }
+    fclose(fp);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data, sizeof(header));
+    if (header.headerSize < sizeof(header) ||
+        header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.vendorID != properties.vendorID ||
+        header.deviceID != properties.deviceID ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+               VK_UUID_SIZE) != 0) {
+        error_log("ignoring %s, it was written by another device or driver",
+                  PIPELINE_CACHE_PATH);
+        free(data);
+        return NULL;
+    }
+
+    *size = length;
+    return data;
+}
+
+static void savePipelineCache(struct sl_oo *oo) {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(oo->device, oo->pipelines.cache, &size,
+                               NULL) != VK_SUCCESS ||
+        size == 0) {
+        return;
+    }
+    void *data = malloc(size);
+    if (vkGetPipelineCacheData(oo->device, oo->pipelines.cache, &size,
+                               data) != VK_SUCCESS) {
+        free(data);
+        return;
+    }
+
+    /* written next to the old one and renamed, a crash never leaves a
+       truncated cache behind */
+    const char *tmpPath = PIPELINE_CACHE_PATH ".tmp";
+    FILE *fp = fopen(tmpPath, "wb");
+    if (fp == NULL) {
+        error_log("failed to open %s!", tmpPath);
+        free(data);
+        return;
+    }
+    bool written = fwrite(data, 1, size, fp) == size;
+    if (fclose(fp) != 0 || !written) {
+        error_log("failed to write %s!", tmpPath);
+        remove(tmpPath);
+    } else if (rename(tmpPath, PIPELINE_CACHE_PATH) != 0) {
+        error_log("failed to rename %s!", tmpPath);
+        remove(tmpPath);
+    }
+    free(data);
+}
+
+void checkDynamicStateSupport(struct sl_oo *oo) {
+    struct sl_dynamic_state *dynamic = &oo->pipelines.dynamic;
+    if (!dynamic->enabled) {
+        return;
+    }
+
+    /* the features are queried through vkGetPhysicalDeviceFeatures2 */
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_1) {
+        return;
+    }
+
+    bool extended = checkDeviceExtension(
+        oo->physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    bool blend = checkDeviceExtension(
+        oo->physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+    /* only what the device knows goes into the chain */
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedFeatures = { 0 };
+    extendedFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT blendFeatures = { 0 };
+    blendFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features2 = { 0 };
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    void **next = &features2.pNext;
+    if (extended) {
+        *next = &extendedFeatures;
+        next = &extendedFeatures.pNext;
+    }
+    if (blend) {
+        *next = &blendFeatures;
+    }
+    vkGetPhysicalDeviceFeatures2(oo->physicalDevice, &features2);
+
+    dynamic->extended = extended && extendedFeatures.extendedDynamicState;
+    dynamic->blend = blend &&
+                     blendFeatures.extendedDynamicState3ColorBlendEnable &&
+                     blendFeatures.extendedDynamicState3ColorBlendEquation;
+
+    if (dynamic->extended && blend) {
+        VkPhysicalDeviceExtendedDynamicState3PropertiesEXT blendProperties = {
+            0
+        };
+        blendProperties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2 = { 0 };
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &blendProperties;
+        vkGetPhysicalDeviceProperties2(oo->physicalDevice, &properties2);
+        dynamic->anyTopology =
+            blendProperties.dynamicPrimitiveTopologyUnrestricted;
+    }
+
+    if (dynamic->extended || dynamic->blend) {
+        fprintf(stderr, "dynamic pipeline state:%s%s\n",
+                dynamic->extended ? " cull, topology, depth" : "",
+                dynamic->blend ? " blend" : "");
+    }
+}
+
+void loadDynamicState(struct sl_oo *oo) {
+    struct sl_dynamic_state *dynamic = &oo->pipelines.dynamic;
+    if (dynamic->extended) {
+        dynamic->setCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(
+            oo->device, "vkCmdSetCullModeEXT");
+        dynamic->setFrontFace = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(
+            oo->device, "vkCmdSetFrontFaceEXT");
+        dynamic->setPrimitiveTopology =
+            (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetPrimitiveTopologyEXT");
+        dynamic->setDepthTestEnable =
+            (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetDepthTestEnableEXT");
+        dynamic->setDepthWriteEnable =
+            (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetDepthWriteEnableEXT");
+        dynamic->setDepthCompareOp =
+            (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetDepthCompareOpEXT");
+        /* the variants are not built yet, they can still bake it */
+        dynamic->extended =
+            dynamic->setCullMode != NULL && dynamic->setFrontFace != NULL &&
+            dynamic->setPrimitiveTopology != NULL &&
+            dynamic->setDepthTestEnable != NULL &&
+            dynamic->setDepthWriteEnable != NULL &&
+            dynamic->setDepthCompareOp != NULL;
+    }
+    if (dynamic->blend) {
+        dynamic->setColorBlendEnable =
+            (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetColorBlendEnableEXT");
+        dynamic->setColorBlendEquation =
+            (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(
+                oo->device, "vkCmdSetColorBlendEquationEXT");
+        dynamic->blend = dynamic->setColorBlendEnable != NULL &&
+                         dynamic->setColorBlendEquation != NULL;
+    }
+    dynamic->anyTopology = dynamic->anyTopology && dynamic->extended;
+}
+
+void createPipelineRegistry(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createPipelineRegistry");
+
+    struct sl_pipelines *pipelines = &oo->pipelines;
+
+    uint32_t vertShaderSize = 0;
+    char *vertShaderCode = readFile("shaders/vert.spv", &vertShaderSize);
+    uint32_t fragShaderSize = 0;
+    char *fragShaderCode = readFile("shaders/frag.spv", &fragShaderSize);
+
+    /* variants are built long after this returns, so the modules live as
+       long as their generation */
+    struct sl_shader_set *shaders = &pipelines->shaders[0];
+    shaders->vertShaderModule =
+        createShaderModule(oo, vertShaderCode, vertShaderSize);
+    shaders->fragShaderModule =
+        createShaderModule(oo, fragShaderCode, fragShaderSize);
+    shaders->used = true;
+    free(vertShaderCode);
+    free(fragShaderCode);
+
+    size_t cacheSize = 0;
+    void *cacheData = loadPipelineCache(oo, &cacheSize);
+
+    VkPipelineCacheCreateInfo cacheInfo = { 0 };
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheSize;
+    cacheInfo.pInitialData = cacheData;
+
+    if (vkCreatePipelineCache(oo->device, &cacheInfo,
+                              hostAllocator(oo, ALLOC_PIPELINES),
+                              &pipelines->cache) != VK_SUCCESS) {
+        error_log("failed to create pipeline cache!");
+        exit(1);
+    }
+    free(cacheData);
+
+    pthread_mutex_init(&pipelines->lock, NULL);
+    pthread_cond_init(&pipelines->cond, NULL);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pipelines->workerCount = PIPELINE_WORKERS;
+    if (cpus > 0 && cpus < pipelines->workerCount) {
+        pipelines->workerCount = (int)cpus;
+    }
+    for (int i = 0; i < pipelines->workerCount; i++) {
+        if (pthread_create(&pipelines->workers[i], NULL, pipelineWorker,
+                           oo) != 0) {
+            error_log("failed to start pipeline thread!");
+            exit(1);
+        }
+    }
+}
+
+void destroyPipelineRegistry(struct sl_oo *oo) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+
+    /* variants still queued are simply never built */
+    pthread_mutex_lock(&pipelines->lock);
+    pipelines->stopping = true;
+    pthread_cond_broadcast(&pipelines->cond);
+    pthread_mutex_unlock(&pipelines->lock);
+    for (int i = 0; i < pipelines->workerCount; i++) {
+        pthread_join(pipelines->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pipelines->cond);
+    pthread_mutex_destroy(&pipelines->lock);
+
+    savePipelineCache(oo);
+
+    /* the device is idle by now, nothing has to wait for its frame */
+    for (uint32_t i = 0; i < pipelines->retiredCount; i++) {
+        vkDestroyPipeline(oo->device, pipelines->retired[i].pipeline,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    for (int i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+        if (pipelines->entries[i].state == PIPELINE_READY) {
+            vkDestroyPipeline(oo->device, pipelines->entries[i].pipeline,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        }
+    }
+    vkDestroyPipelineCache(oo->device, pipelines->cache,
+                           hostAllocator(oo, ALLOC_PIPELINES));
+    for (int i = 0; i < PIPELINE_SHADER_SETS; i++) {
+        struct sl_shader_set *shaders = &pipelines->shaders[i];
+        if (shaders->used) {
+            vkDestroyShaderModule(oo->device, shaders->fragShaderModule,
+                                  hostAllocator(oo, ALLOC_PIPELINES));
+            vkDestroyShaderModule(oo->device, shaders->vertShaderModule,
+                                  hostAllocator(oo, ALLOC_PIPELINES));
+        }
+    }
+}
+
+struct sl_pipeline_key pipelineKeyDefault(struct sl_oo *oo) {
+    struct sl_pipeline_key key;
+    memset(&key, 0, sizeof(key));
+    key.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    key.cullMode = VK_CULL_MODE_BACK_BIT;
+    key.blend = PIPELINE_BLEND_OPAQUE;
+    key.samples = oo->msaaSamples;
+    key.depth = PIPELINE_DEPTH_WRITE;
+    pipelineKeySetFloat(&key, SPEC_TRIANGLE_SCALE, 1.0f);
+    key.spec[SPEC_COLOR_MODE] = COLOR_MODE_VERTEX;
+    pipelineKeySetFloat(&key, SPEC_ALPHA, 1.0f);
+    return key;
+}
+
+void pipelineKeySetFloat(struct sl_pipeline_key *key, enum PipelineSpec spec,
+                         float value) {
+    memcpy(&key->spec[spec], &value, sizeof(value));
+}
+
+void pipelineDepthState(uint32_t depth, VkBool32 *write,
+                        VkCompareOp *compareOp) {
+    /* reverse-z, nearer is greater. after a pre-pass the depth buffer is
+       final and only the visible fragment of each pixel passes EQUAL */
+    *write = depth == PIPELINE_DEPTH_EQUAL ? VK_FALSE : VK_TRUE;
+    *compareOp = depth == PIPELINE_DEPTH_EQUAL ? VK_COMPARE_OP_EQUAL
+                                               : VK_COMPARE_OP_GREATER;
+}
+
+void pipelineBlendState(uint32_t blend, VkBool32 *enable,
+                        VkColorBlendEquationEXT *equation) {
+    *enable = blend != PIPELINE_BLEND_OPAQUE;
+    equation->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    equation->dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    equation->colorBlendOp = VK_BLEND_OP_ADD;
+    equation->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    equation->dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    equation->alphaBlendOp = VK_BLEND_OP_ADD;
+    if (blend == PIPELINE_BLEND_ALPHA) {
+        equation->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        equation->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    } else if (blend == PIPELINE_BLEND_ADDITIVE) {
+        equation->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    }
+}
+
+void recordPipelineState(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         const struct sl_pipeline_key *key) {
+    const struct sl_dynamic_state *dynamic = &oo->pipelines.dynamic;
+    if (dynamic->extended) {
+        VkBool32 write;
+        VkCompareOp compareOp;
+        pipelineDepthState(key->depth, &write, &compareOp);
+        dynamic->setCullMode(commandBuffer, key->cullMode);
+        /* never part of the key, buildGraphicsPipeline bakes the same */
+        dynamic->setFrontFace(commandBuffer, VK_FRONT_FACE_CLOCKWISE);
+        dynamic->setPrimitiveTopology(commandBuffer, key->topology);
+        dynamic->setDepthTestEnable(commandBuffer, VK_TRUE);
+        dynamic->setDepthWriteEnable(commandBuffer, write);
+        dynamic->setDepthCompareOp(commandBuffer, compareOp);
+    }
+    if (dynamic->blend) {
+        VkBool32 enable;
+        VkColorBlendEquationEXT equation;
+        pipelineBlendState(key->blend, &enable, &equation);
+        dynamic->setColorBlendEnable(commandBuffer, 0, 1, &enable);
+        dynamic->setColorBlendEquation(commandBuffer, 0, 1, &equation);
+    }
+}
+
+/* topologies of one class, a pipeline baked with one of them can draw
+   any of the others */
+static uint32_t topologyClass(uint32_t topology) {
+    switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+        return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+        return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+/* the key without what recordPipelineState sets, the registry only ever
+   sees these */
+static struct sl_pipeline_key bakedKey(const struct sl_pipelines *pipelines,
+                                       const struct sl_pipeline_key *key) {
+    struct sl_pipeline_key baked = *key;
+    const struct sl_dynamic_state *dynamic = &pipelines->dynamic;
+    if (dynamic->extended) {
+        baked.cullMode = VK_CULL_MODE_NONE;
+        baked.topology = dynamic->anyTopology
+                             ? VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+                             : topologyClass(key->topology);
+        /* the pre-pass stays its own variant, it has no fragment
+           shader */
+        if (baked.depth == PIPELINE_DEPTH_EQUAL) {
+            baked.depth = PIPELINE_DEPTH_WRITE;
+        }
+    }
+    if (dynamic->blend) {
+        baked.blend = PIPELINE_BLEND_OPAQUE;
+    }
+    return baked;
+}
+
+static void queuePipeline(struct sl_oo *oo, const struct sl_pipeline_key *key,
+                          bool wait) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    struct sl_pipeline_key baked = bakedKey(pipelines, key);
+    key = &baked;
+    uint64_t hash = hashKey(key);
+    struct sl_pipeline_entry *entry = findEntry(pipelines, key, hash);
+    if (entry->state != PIPELINE_EMPTY && entry->state != PIPELINE_RETIRED) {
+        return;
+    }
+    /* a generation that is already gone */
+    int set = findShaderSet(pipelines, key->shaders);
+    if (set < 0) {
+        return;
+    }
+
+    /* probes stay short and always end on an empty slot */
+    const uint32_t limit = PIPELINE_REGISTRY_SIZE / 4 * 3;
+    if (entry->state == PIPELINE_EMPTY && pipelines->used + 1 > limit) {
+        if (!compactRegistry(pipelines, wait)) {
+            deferPipeline(pipelines, key);
+            return;
+        }
+        if (pipelines->used + 1 > limit) {
+            error_log("pipeline registry full, raise PIPELINE_REGISTRY_SIZE!");
+            exit(1);
+        }
+        entry = findEntry(pipelines, key, hash);
+    }
+    if (entry->state == PIPELINE_EMPTY) {
+        pipelines->used++;
+    }
+    pipelines->count++;
+    pipelines->shaders[set].users++;
+
+    entry->hash = hash;
+    entry->key = *key;
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->shaderSet = (uint32_t)set;
+
+    pthread_mutex_lock(&pipelines->lock);
+    /* published under the lock, the workers see the key through it */
+    __atomic_store_n(&entry->state, PIPELINE_QUEUED, __ATOMIC_RELEASE);
+    int tail = (pipelines->queueHead + pipelines->queueCount) %
+               PIPELINE_REGISTRY_SIZE;
+    pipelines->queue[tail] = (int)(entry - pipelines->entries);
+    pipelines->queueCount++;
+    pipelines->building++;
+    pthread_cond_broadcast(&pipelines->cond);
+    pthread_mutex_unlock(&pipelines->lock);
+}
+
+void requestPipeline(struct sl_oo *oo, const struct sl_pipeline_key *key) {
+    queuePipeline(oo, key, false);
+}
+
+/* the ones that found the table full, once the builds are done */
+static void requestDeferred(struct sl_oo *oo) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    if (pipelines->deferredCount == 0) {
+        return;
+    }
+    pthread_mutex_lock(&pipelines->lock);
+    bool idle = pipelines->building == 0;
+    pthread_mutex_unlock(&pipelines->lock);
+    if (!idle) {
+        return;
+    }
+
+    static struct sl_pipeline_key keys[PIPELINE_REGISTRY_SIZE];
+    uint32_t keyCount = pipelines->deferredCount;
+    memcpy(keys, pipelines->deferred, sizeof(keys[0]) * keyCount);
+    pipelines->deferredCount = 0;
+    for (uint32_t i = 0; i < keyCount; i++) {
+        requestPipeline(oo, &keys[i]);
+    }
+}
+
+VkPipeline lookupPipeline(struct sl_oo *oo, const struct sl_pipeline_key *key) {
+    struct sl_pipeline_key baked = bakedKey(&oo->pipelines, key);
+    struct sl_pipeline_entry *entry =
+        findEntry(&oo->pipelines, &baked, hashKey(&baked));
+    if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != PIPELINE_READY) {
+        return VK_NULL_HANDLE;
+    }
+    return entry->pipeline;
+}
+
+VkPipeline waitForPipeline(struct sl_oo *oo,
+                           const struct sl_pipeline_key *key) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    /* it blocks anyway, so it may wait for a compaction too */
+    queuePipeline(oo, key, true);
+    struct sl_pipeline_key baked = bakedKey(pipelines, key);
+    struct sl_pipeline_entry *entry =
+        findEntry(pipelines, &baked, hashKey(&baked));
+
+    pthread_mutex_lock(&pipelines->lock);
+    uint32_t state;
+    while ((state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE)) ==
+           PIPELINE_QUEUED) {
+        pthread_cond_wait(&pipelines->cond, &pipelines->lock);
+    }
+    pthread_mutex_unlock(&pipelines->lock);
+
+    if (state != PIPELINE_READY) {
+        error_log("failed to create graphics pipeline!");
+        exit(1);
+    }
+    return entry->pipeline;
+}
+
+bool beginShaderGeneration(struct sl_oo *oo, VkShaderModule vertShaderModule,
+                           VkShaderModule fragShaderModule) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    int set = -1;
+    for (int i = 0; i < PIPELINE_SHADER_SETS; i++) {
+        if (!pipelines->shaders[i].used) {
+            set = i;
+            break;
+        }
+    }
+    if (set < 0) {
+        return false;
+    }
+
+    uint32_t previous = pipelines->generation;
+    struct sl_shader_set *shaders = &pipelines->shaders[set];
+    shaders->vertShaderModule = vertShaderModule;
+    shaders->fragShaderModule = fragShaderModule;
+    shaders->generation = ++pipelines->generation;
+    shaders->users = 0;
+    shaders->used = true;
+    pipelines->currentSet = (uint32_t)set;
+    pipelines->stale = true;
+
+    /* rebuild every variant the last generation had, not just the one on
+       screen, so switching material stays instant. requesting may compact
+       the table, so the keys are copied out first */
+    static struct sl_pipeline_key keys[PIPELINE_REGISTRY_SIZE];
+    uint32_t keyCount = 0;
+    for (int i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+        struct sl_pipeline_entry *entry = &pipelines->entries[i];
+        if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) ==
+                PIPELINE_READY &&
+            entry->key.shaders == previous) {
+            keys[keyCount] = entry->key;
+            keys[keyCount++].shaders = pipelines->generation;
+        }
+    }
+    for (uint32_t i = 0; i < keyCount; i++) {
+        requestPipeline(oo, &keys[i]);
+    }
+    return true;
+}
+
+/* destroys what the frames in flight can no longer use */
+static void collectRetired(struct sl_oo *oo) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < pipelines->retiredCount; i++) {
+        struct sl_retired_pipeline *retired = &pipelines->retired[i];
+        if (pipelines->frame >= retired->frame) {
+            vkDestroyPipeline(oo->device, retired->pipeline,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        } else {
+            pipelines->retired[kept++] = *retired;
+        }
+    }
+    pipelines->retiredCount = kept;
+}
+
+/* retires the variants of older generations once nothing draws with them
+   and frees their shader modules once nothing builds from them */
+static void retireStale(struct sl_oo *oo) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    /* the last frame that could have used them is the previous one, its
+       fence has been waited for MAX_FRAMES_IN_FLIGHT - 1 frames later */
+    uint64_t frame = pipelines->frame + MAX_FRAMES_IN_FLIGHT - 1;
+    bool stale = false;
+
+    for (int i = 0; i < PIPELINE_REGISTRY_SIZE; i++) {
+        struct sl_pipeline_entry *entry = &pipelines->entries[i];
+        uint32_t state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        if (state == PIPELINE_EMPTY || state == PIPELINE_RETIRED ||
+            entry->key.shaders == pipelines->generation) {
+            continue;
+        }
+        bool bound = state == PIPELINE_READY &&
+                     (entry->pipeline == oo->graphicsPipeline ||
+                      entry->pipeline == oo->depthPrepassPipeline);
+        if (state == PIPELINE_QUEUED || bound) {
+            stale = true;
+            continue;
+        }
+        retirePipeline(pipelines, entry, frame);
+    }
+
+    for (int i = 0; i < PIPELINE_SHADER_SETS; i++) {
+        struct sl_shader_set *shaders = &pipelines->shaders[i];
+        if (!shaders->used || i == (int)pipelines->currentSet) {
+            continue;
+        }
+        if (shaders->users > 0) {
+            stale = true;
+            continue;
+        }
+        /* pipelines do not need their modules after creation */
+        vkDestroyShaderModule(oo->device, shaders->fragShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyShaderModule(oo->device, shaders->vertShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        shaders->used = false;
+    }
+    pipelines->stale = stale;
+}
+
+/* the variants oo->material asks for with the current shaders */
+static void materialKeys(struct sl_oo *oo, struct sl_pipeline_key *key,
+                         struct sl_pipeline_key *depthKey) {
+    *key = oo->material;
+    key->samples = oo->msaaSamples;
+    key->depth =
+        oo->depthPrepass ? PIPELINE_DEPTH_EQUAL : PIPELINE_DEPTH_WRITE;
+    key->shaders = oo->pipelines.generation;
+
+    /* the pre-pass only depends on what moves vertices, one variant serves
+       every color mode */
+    *depthKey = *key;
+    depthKey->blend = PIPELINE_BLEND_OPAQUE;
+    depthKey->depth = PIPELINE_DEPTH_ONLY;
+    depthKey->spec[SPEC_COLOR_MODE] = COLOR_MODE_VERTEX;
+    pipelineKeySetFloat(depthKey, SPEC_ALPHA, 1.0f);
+}
+
+void selectPipelines(struct sl_oo *oo, bool wait) {
+    struct sl_pipelines *pipelines = &oo->pipelines;
+    struct sl_pipeline_key key;
+    struct sl_pipeline_key depthKey;
+    materialKeys(oo, &key, &depthKey);
+
+    if (wait) {
+        oo->graphicsPipeline = waitForPipeline(oo, &key);
+        oo->graphicsKey = key;
+        if (oo->depthPrepass) {
+            oo->depthPrepassPipeline = waitForPipeline(oo, &depthKey);
+            oo->depthPrepassKey = depthKey;
+        }
+        return;
+    }
+
+    collectRetired(oo);
+    requestDeferred(oo);
+
+    requestPipeline(oo, &key);
+    VkPipeline pipeline = lookupPipeline(oo, &key);
+    VkPipeline depthPipeline = VK_NULL_HANDLE;
+    if (oo->depthPrepass) {
+        requestPipeline(oo, &depthKey);
+        depthPipeline = lookupPipeline(oo, &depthKey);
+    }
+
+    /* both or neither, the EQUAL test needs the matching pre-pass */
+    if (pipeline != VK_NULL_HANDLE &&
+        (!oo->depthPrepass || depthPipeline != VK_NULL_HANDLE)) {
+        oo->graphicsPipeline = pipeline;
+        oo->depthPrepassPipeline = depthPipeline;
+        oo->graphicsKey = key;
+        oo->depthPrepassKey = depthKey;
+    }
+
+    if (pipelines->stale) {
+        retireStale(oo);
+    }
+    pipelines->frame++;
+}
+
+static bool pipelineFailed(struct sl_oo *oo,
+                           const struct sl_pipeline_key *key) {
+    struct sl_pipeline_key baked = bakedKey(&oo->pipelines, key);
+    struct sl_pipeline_entry *entry =
+        findEntry(&oo->pipelines, &baked, hashKey(&baked));
+    return __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) ==
+           PIPELINE_FAILED;
+}
+
+bool pipelinesSettled(struct sl_oo *oo) {
+    struct sl_pipeline_key key;
+    struct sl_pipeline_key depthKey;
+    materialKeys(oo, &key, &depthKey);
+    /* a variant that failed to build is never switched to, what is bound
+       now stays until the next reload or material change */
+    if (pipelineFailed(oo, &key) ||
+        (oo->depthPrepass && pipelineFailed(oo, &depthKey))) {
+        return true;
+    }
+    return !oo->pipelines.stale &&
+           memcmp(&key, &oo->graphicsKey, sizeof(key)) == 0;
+}
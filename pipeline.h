@@ -0,0 +1,209 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* every graphics pipeline the renderer uses is a variant of the one in
+   createGraphicsPipeline, described by a key. variants are compiled by a
+   few worker threads into one shared VkPipelineCache and looked up by
+   hash, so switching state on the draw path never compiles anything.
+   reloaded shaders start a new generation of variants, the old ones are
+   destroyed once the frames that used them are done. with extended
+   dynamic state, the parts of a key the command buffer sets are dropped
+   before it is looked up, so those variants collapse into one. */
+
+struct sl_oo;
+
+enum PipelineBlend {
+    PIPELINE_BLEND_OPAQUE,
+    PIPELINE_BLEND_ALPHA,
+    PIPELINE_BLEND_ADDITIVE,
+};
+
+enum PipelineDepth {
+    /* reverse-z test and write */
+    PIPELINE_DEPTH_WRITE,
+    /* after a pre-pass, only the visible fragment passes */
+    PIPELINE_DEPTH_EQUAL,
+    /* the pre-pass itself, no fragment shader and no color */
+    PIPELINE_DEPTH_ONLY,
+};
+
+/* specialization constants, the index is the constant_id in the shaders */
+enum PipelineSpec {
+    /* float, size of the triangle */
+    SPEC_TRIANGLE_SCALE,
+    /* one of ColorMode */
+    SPEC_COLOR_MODE,
+    /* float, alpha written by the fragment shader */
+    SPEC_ALPHA,
+    PIPELINE_SPEC_COUNT,
+};
+
+enum ColorMode {
+    COLOR_MODE_VERTEX,
+    /* vertex colors darkened with distance */
+    COLOR_MODE_DEPTH,
+    COLOR_MODE_WHITE,
+    COLOR_MODE_COUNT,
+};
+
+/* only uint32_t fields, no padding, so it is hashed and compared as bytes.
+   always start from pipelineKeyDefault */
+struct sl_pipeline_key {
+    uint32_t topology;
+    uint32_t cullMode;
+    uint32_t blend;
+    uint32_t samples;
+    uint32_t depth;
+    uint32_t spec[PIPELINE_SPEC_COUNT];
+    /* shader generation, filled in by selectPipelines */
+    uint32_t shaders;
+};
+
+enum PipelineState {
+    PIPELINE_EMPTY,
+    PIPELINE_QUEUED,
+    PIPELINE_READY,
+    PIPELINE_FAILED,
+    /* destroyed, a tombstone so probes keep going */
+    PIPELINE_RETIRED,
+};
+
+/* what the device lets us set in the command buffer, found by
+   checkDynamicStateSupport. anything else stays baked in */
+struct sl_dynamic_state {
+    /* option, the extensions are left alone without it */
+    bool enabled;
+    /* VK_EXT_extended_dynamic_state: cull mode, front face, topology and
+       the depth test, write and compare op */
+    bool extended;
+    /* any topology instead of only one of the same class */
+    bool anyTopology;
+    /* VK_EXT_extended_dynamic_state3: blend enable and equation */
+    bool blend;
+
+    PFN_vkCmdSetCullModeEXT setCullMode;
+    PFN_vkCmdSetFrontFaceEXT setFrontFace;
+    PFN_vkCmdSetPrimitiveTopologyEXT setPrimitiveTopology;
+    PFN_vkCmdSetDepthTestEnableEXT setDepthTestEnable;
+    PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable;
+    PFN_vkCmdSetDepthCompareOpEXT setDepthCompareOp;
+    PFN_vkCmdSetColorBlendEnableEXT setColorBlendEnable;
+    PFN_vkCmdSetColorBlendEquationEXT setColorBlendEquation;
+};
+
+struct sl_pipeline_entry {
+    uint64_t hash;
+    struct sl_pipeline_key key;
+    VkPipeline pipeline;
+    /* index into sl_pipelines.shaders */
+    uint32_t shaderSet;
+    /* written by the workers with release, read with acquire */
+    uint32_t state;
+};
+
+struct sl_shader_set {
+    VkShaderModule vertShaderModule;
+    VkShaderModule fragShaderModule;
+    uint32_t generation;
+    /* entries built or being built from these, the set is freed at 0 */
+    uint32_t users;
+    bool used;
+};
+
+/* a pipeline that may still be in use by a frame in flight */
+struct sl_retired_pipeline {
+    VkPipeline pipeline;
+    uint64_t frame;
+};
+
+struct sl_pipelines {
+    VkPipelineCache cache;
+    struct sl_dynamic_state dynamic;
+
+    /* the current generation and older ones that still have variants */
+    struct sl_shader_set shaders[PIPELINE_SHADER_SETS];
+    uint32_t currentSet;
+    uint32_t generation;
+    bool stale;
+
+    /* open addressing, never resized and only inserted into by the render
+       thread, so lookups need no lock. used counts tombstones too */
+    struct sl_pipeline_entry entries[PIPELINE_REGISTRY_SIZE];
+    uint32_t count;
+    uint32_t used;
+    /* requests that found the table full while builds were in flight,
+       compacting would have to wait for them. selectPipelines tries
+       again every frame */
+    struct sl_pipeline_key deferred[PIPELINE_REGISTRY_SIZE];
+    uint32_t deferredCount;
+
+    /* selectPipelines calls, one per submitted frame */
+    uint64_t frame;
+    struct sl_retired_pipeline retired[PIPELINE_REGISTRY_SIZE];
+    uint32_t retiredCount;
+
+    pthread_t workers[PIPELINE_WORKERS];
+    int workerCount;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int queue[PIPELINE_REGISTRY_SIZE];
+    int queueHead;
+    int queueCount;
+    /* queued or compiling */
+    int building;
+    bool stopping;
+};
+
+/* fills in pipelines.dynamic before createLogicalDevice, which enables
+   what was found */
+void checkDynamicStateSupport(struct sl_oo *oo);
+/* after it, the entry points of what was enabled */
+void loadDynamicState(struct sl_oo *oo);
+
+void createPipelineRegistry(struct sl_oo *oo);
+void destroyPipelineRegistry(struct sl_oo *oo);
+
+struct sl_pipeline_key pipelineKeyDefault(struct sl_oo *oo);
+void pipelineKeySetFloat(struct sl_pipeline_key *key, enum PipelineSpec spec,
+                         float value);
+
+/* what a key tests depth and blends with, baked in or set in the
+   command buffer */
+void pipelineDepthState(uint32_t depth, VkBool32 *write,
+                        VkCompareOp *compareOp);
+void pipelineBlendState(uint32_t blend, VkBool32 *enable,
+                        VkColorBlendEquationEXT *equation);
+/* after binding a variant of key, whatever of it is dynamic */
+void recordPipelineState(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         const struct sl_pipeline_key *key);
+
+/* queues the variant unless it is known already, never blocks. a full
+   table with builds in flight defers it to a later selectPipelines */
+void requestPipeline(struct sl_oo *oo, const struct sl_pipeline_key *key);
+/* VK_NULL_HANDLE while the variant is still compiling or unknown */
+VkPipeline lookupPipeline(struct sl_oo *oo, const struct sl_pipeline_key *key);
+/* requests the variant and blocks until it is built, for startup */
+VkPipeline waitForPipeline(struct sl_oo *oo,
+                           const struct sl_pipeline_key *key);
+
+/* starts a new generation built from these modules, the registry owns
+   them if it returns true. false while every shader set is taken */
+bool beginShaderGeneration(struct sl_oo *oo, VkShaderModule vertShaderModule,
+                           VkShaderModule fragShaderModule);
+
+/* points graphicsPipeline (and the pre-pass) at the variants for
+   oo->material. keeps the current ones while they compile, unless wait */
+void selectPipelines(struct sl_oo *oo, bool wait);
+/* false until selectPipelines drew with what oo->material asks for and
+   older generations are gone, each takes frames. true right away when
+   that variant failed to build, waiting would never end */
+bool pipelinesSettled(struct sl_oo *oo);
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,563 @@
+#include "renderer.h"
+#include "post.h"
+
+/* local sizes of the shaders, the dispatches are counted in them */
+#define POST_DOWN_TILE 4
+#define POST_TILE 8
+#define POST_BLUR_RUN 128
+
+static const char *postPassNames[POST_PASS_COUNT] = {
+    "bloom",
+    "blur",
+    "tonemap",
+};
+
+bool parsePostPasses(const char *list, struct sl_post *post) {
+    post->passCount = 0;
+    while (*list != '\0') {
+        size_t length = strcspn(list, ",");
+        int pass = -1;
+        for (int i = 0; i < POST_PASS_COUNT; i++) {
+            if (strlen(postPassNames[i]) == length &&
+                strncmp(list, postPassNames[i], length) == 0) {
+                pass = i;
+                break;
+            }
+        }
+        if (pass < 0 || post->passCount == POST_MAX_PASSES) {
+            return false;
+        }
+        /* after it nothing is above 1 any more */
+        if (post->passCount > 0 &&
+            post->passes[post->passCount - 1] == POST_TONEMAP) {
+            return false;
+        }
+        post->passes[post->passCount++] = (enum PostPass)pass;
+        list += length;
+        if (*list == ',') {
+            list++;
+        }
+    }
+    return post->passCount > 0;
+}
+
+/* the intermediate images are drawn to, stored, filtered and blitted */
+static bool supportsPostProcess(struct sl_oo *oo) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(oo->physicalDevice, POST_FORMAT,
+                                        &formatProperties);
+    VkFormatFeatureFlags features =
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+    return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+/* the downsample maps every quad of a subgroup onto a 2x2 block, so the
+   subgroups have to tile its 64 invocations exactly */
+static bool supportsQuadSubgroups(struct sl_oo *oo) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_1) {
+        return false;
+    }
+
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = { 0 };
+    subgroupProperties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = { 0 };
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(oo->physicalDevice, &properties2);
+
+    uint32_t size = subgroupProperties.subgroupSize;
+    return (subgroupProperties.supportedStages &
+            VK_SHADER_STAGE_COMPUTE_BIT) &&
+           (subgroupProperties.supportedOperations &
+            VK_SUBGROUP_FEATURE_QUAD_BIT) &&
+           size >= 4 && size <= 64 && (size & (size - 1)) == 0;
+}
+
+void createPostProcess(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createPostProcess");
+
+    struct sl_post *post = &oo->post;
+    if (post->passCount == 0) {
+        return;
+    }
+    /* everything is recorded into the graphics command buffer, right after
+       the render pass */
+    if (!supportsPostProcess(oo) || !graphicsQueueSupportsCompute(oo)) {
+        error_log("post-processing is not supported by this device, "
+                  "rendering without it");
+        return;
+    }
+
+    /* what a step reads, and what it writes. both stay in the general
+       layout for the whole chain */
+    VkDescriptorSetLayoutBinding bindings[2] = { 0 };
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &post->descriptorSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create post descriptor set layout!");
+        exit(1);
+    }
+
+    /* bilinear, the upsample takes four texels per fetch */
+    VkSamplerCreateInfo samplerInfo = { 0 };
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(oo->device, &samplerInfo,
+                        hostAllocator(oo, ALLOC_DESCRIPTORS),
+                        &post->sampler) != VK_SUCCESS) {
+        error_log("failed to create post sampler!");
+        exit(1);
+    }
+
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(struct sl_post_params);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &post->descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &post->pipelineLayout) != VK_SUCCESS) {
+        error_log("failed to create post pipeline layout!");
+        exit(1);
+    }
+
+    post->subgroups = supportsQuadSubgroups(oo);
+    post->down = createComputePipeline(
+        oo,
+        post->subgroups ? "shaders/post_down.spv"
+                        : "shaders/post_down_shared.spv",
+        post->pipelineLayout);
+    post->up = createComputePipeline(oo, "shaders/post_up.spv",
+                                     post->pipelineLayout);
+    post->blur = createComputePipeline(oo, "shaders/post_blur.spv",
+                                       post->pipelineLayout);
+    post->tonemap = createComputePipeline(oo, "shaders/post_tonemap.spv",
+                                          post->pipelineLayout);
+
+    post->active = true;
+    fprintf(stderr, "post-processing with %u passes, %s downsample\n",
+            post->passCount, post->subgroups ? "subgroup" : "shared memory");
+}
+
+void destroyPostProcess(struct sl_oo *oo) {
+    struct sl_post *post = &oo->post;
+    if (post->pipelineLayout == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkPipeline pipelines[4] = { post->down, post->up, post->blur,
+                                post->tonemap };
+    for (int i = 0; i < 4; i++) {
+        vkDestroyPipeline(oo->device, pipelines[i],
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    vkDestroyPipelineLayout(oo->device, post->pipelineLayout,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroySampler(oo->device, post->sampler,
+                     hostAllocator(oo, ALLOC_DESCRIPTORS));
+    vkDestroyDescriptorSetLayout(oo->device, post->descriptorSetLayout,
+                                 hostAllocator(oo, ALLOC_PIPELINES));
+    post->pipelineLayout = VK_NULL_HANDLE;
+    post->active = false;
+}
+
+VkFormat sceneFormat(struct sl_oo *oo, struct sl_target *target) {
+    return oo->post.active ? POST_FORMAT : target->swapChainImageFormat;
+}
+
+VkImageUsageFlags postSwapchainUsage(struct sl_oo *oo, VkFormat format,
+                                     VkImageUsageFlags supportedUsage) {
+    if (!oo->post.active) {
+        return 0;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(oo->physicalDevice, format,
+                                        &formatProperties);
+    if ((supportedUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+        (formatProperties.optimalTilingFeatures &
+         VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+        return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
+    /* the render pass and the targets already render into the scene */
+    if (oo->renderPass != VK_NULL_HANDLE) {
+        error_log("the swapchain can no longer be post-processed!");
+        exit(1);
+    }
+    error_log("the swapchain cannot be blitted to, rendering without "
+              "post-processing");
+    oo->post.active = false;
+    return 0;
+}
+
+static void createPostImage(struct sl_oo *oo, VkExtent2D extent,
+                            VkImageUsageFlags usage, VkImage *image,
+                            VkDeviceMemory *memory, VkImageView *view) {
+    createImage(oo, extent.width, extent.height, VK_SAMPLE_COUNT_1_BIT,
+                POST_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+                usage | VK_IMAGE_USAGE_STORAGE_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+    *view = createImageView(oo, *image, POST_FORMAT,
+                            VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+static void destroyPostImage(struct sl_oo *oo, VkImage image,
+                             VkDeviceMemory memory, VkImageView view) {
+    vkDestroyImageView(oo->device, view, hostAllocator(oo, ALLOC_IMAGES));
+    vkDestroyImage(oo->device, image, hostAllocator(oo, ALLOC_IMAGES));
+    freeDeviceMemory(oo, memory);
+}
+
+/* src is sampled, dst written, groups are how many tiles dst is */
+static void addStep(struct sl_oo *oo, struct sl_post_target *pt,
+                    VkPipeline pipeline, VkImageView src, VkImageView dst,
+                    VkExtent2D size, uint32_t tile, float a,
+                    uint32_t flags) {
+    if (pt->stepCount == POST_MAX_STEPS) {
+        error_log("post chain needs more than %d steps!", POST_MAX_STEPS);
+        exit(1);
+    }
+    struct sl_post_step *step = &pt->steps[pt->stepCount++];
+    step->pipeline = pipeline;
+    step->params.width = size.width;
+    step->params.height = size.height;
+    step->params.a = a;
+    step->params.b = 0.0f;
+    step->params.flags = flags;
+    step->groups[0] = (size.width + tile - 1) / tile;
+    step->groups[1] = (size.height + tile - 1) / tile;
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pt->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &oo->post.descriptorSetLayout;
+    if (vkAllocateDescriptorSets(oo->device, &allocInfo, &step->set) !=
+        VK_SUCCESS) {
+        error_log("failed to allocate post descriptor set!");
+        exit(1);
+    }
+
+    VkDescriptorImageInfo imageInfos[2] = { 0 };
+    imageInfos[0].sampler = oo->post.sampler;
+    imageInfos[0].imageView = src;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfos[1].imageView = dst;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet writes[2] = { 0 };
+    for (int i = 0; i < 2; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = step->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    vkUpdateDescriptorSets(oo->device, 2, writes, 0, NULL);
+}
+
+/* down the levels with the threshold on the first step, back up adding
+   every level onto the one above, and the last one onto the scene */
+static void addBloomSteps(struct sl_oo *oo, struct sl_post_target *pt,
+                          VkExtent2D extent) {
+    struct sl_post *post = &oo->post;
+
+    VkImageView src = pt->sceneView;
+    for (uint32_t i = 0; i < pt->bloomLevels; i++) {
+        addStep(oo, pt, post->down, src, pt->bloomViews[i],
+                pt->bloomExtents[i], POST_DOWN_TILE, POST_BLOOM_THRESHOLD,
+                i == 0 ? POST_FLAG_THRESHOLD : 0);
+        src = pt->bloomViews[i];
+    }
+    for (uint32_t i = pt->bloomLevels - 1; i > 0; i--) {
+        addStep(oo, pt, post->up, pt->bloomViews[i], pt->bloomViews[i - 1],
+                pt->bloomExtents[i - 1], POST_TILE, 1.0f, 0);
+    }
+    addStep(oo, pt, post->up, pt->bloomViews[0], pt->sceneView, extent,
+            POST_TILE, POST_BLOOM_INTENSITY, 0);
+}
+
+/* a row of runs for the horizontal half and a column of them for the
+   vertical one, the groups are laid out by hand */
+static void addBlurSteps(struct sl_oo *oo, struct sl_post_target *pt,
+                         VkExtent2D extent) {
+    struct sl_post *post = &oo->post;
+
+    addStep(oo, pt, post->blur, pt->sceneView, pt->tempView, extent, 1,
+            0.0f, 0);
+    struct sl_post_step *step = &pt->steps[pt->stepCount - 1];
+    step->groups[0] = (extent.width + POST_BLUR_RUN - 1) / POST_BLUR_RUN;
+    step->groups[1] = extent.height;
+
+    addStep(oo, pt, post->blur, pt->tempView, pt->sceneView, extent, 1,
+            0.0f, POST_FLAG_VERTICAL);
+    step = &pt->steps[pt->stepCount - 1];
+    step->groups[0] = (extent.height + POST_BLUR_RUN - 1) / POST_BLUR_RUN;
+    step->groups[1] = extent.width;
+}
+
+void createPostTarget(struct sl_oo *oo, struct sl_target *target) {
+    struct sl_post *post = &oo->post;
+    if (!post->active) {
+        return;
+    }
+    TRACE_ZONE(oo, "createPostTarget");
+
+    struct sl_post_target *pt = &target->post;
+    VkExtent2D extent = target->swapChainExtent;
+
+    createPostImage(oo, extent,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    &pt->scene, &pt->sceneMemory, &pt->sceneView);
+
+    bool bloom = false;
+    bool blur = false;
+    for (uint32_t i = 0; i < post->passCount; i++) {
+        bloom |= post->passes[i] == POST_BLOOM;
+        blur |= post->passes[i] == POST_BLUR;
+    }
+    if (blur) {
+        createPostImage(oo, extent, 0, &pt->temp, &pt->tempMemory,
+                        &pt->tempView);
+    }
+    /* stops while a level is still large enough to be worth spreading */
+    pt->bloomLevels = 0;
+    VkExtent2D level = extent;
+    while (bloom && pt->bloomLevels < POST_BLOOM_LEVELS) {
+        level.width = level.width > 1 ? level.width / 2 : 1;
+        level.height = level.height > 1 ? level.height / 2 : 1;
+        uint32_t i = pt->bloomLevels++;
+        pt->bloomExtents[i] = level;
+        createPostImage(oo, level, 0, &pt->bloom[i], &pt->bloomMemory[i],
+                        &pt->bloomViews[i]);
+        if (level.width < 2 * POST_TILE || level.height < 2 * POST_TILE) {
+            break;
+        }
+    }
+
+    VkDescriptorPoolSize poolSizes[2] = { 0 };
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = POST_MAX_STEPS;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = POST_MAX_STEPS;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = POST_MAX_STEPS;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &pt->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create post descriptor pool!");
+        exit(1);
+    }
+
+    /* the whole chain is fixed until the next resize, recording only
+       replays it */
+    pt->stepCount = 0;
+    for (uint32_t i = 0; i < post->passCount; i++) {
+        switch (post->passes[i]) {
+        case POST_BLOOM:
+            addBloomSteps(oo, pt, extent);
+            break;
+        case POST_BLUR:
+            addBlurSteps(oo, pt, extent);
+            break;
+        case POST_TONEMAP:
+            addStep(oo, pt, post->tonemap, pt->sceneView, pt->sceneView,
+                    extent, POST_TILE, POST_EXPOSURE, 0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void destroyPostTarget(struct sl_oo *oo, struct sl_target *target) {
+    struct sl_post_target *pt = &target->post;
+    if (pt->scene == VK_NULL_HANDLE) {
+        return;
+    }
+
+    /* the sets go with the pool */
+    vkDestroyDescriptorPool(oo->device, pt->descriptorPool,
+                            hostAllocator(oo, ALLOC_DESCRIPTORS));
+    for (uint32_t i = 0; i < pt->bloomLevels; i++) {
+        destroyPostImage(oo, pt->bloom[i], pt->bloomMemory[i],
+                         pt->bloomViews[i]);
+    }
+    if (pt->temp != VK_NULL_HANDLE) {
+        destroyPostImage(oo, pt->temp, pt->tempMemory, pt->tempView);
+    }
+    destroyPostImage(oo, pt->scene, pt->sceneMemory, pt->sceneView);
+    memset(pt, 0, sizeof(*pt));
+}
+
+static void initImageBarrier(VkImageMemoryBarrier *barrier, VkImage image,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                             VkImageLayout oldLayout,
+                             VkImageLayout newLayout) {
+    memset(barrier, 0, sizeof(*barrier));
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->srcAccessMask = srcAccess;
+    barrier->dstAccessMask = dstAccess;
+    barrier->oldLayout = oldLayout;
+    barrier->newLayout = newLayout;
+    barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->image = image;
+    barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier->subresourceRange.levelCount = 1;
+    barrier->subresourceRange.layerCount = 1;
+}
+
+void recordPostProcess(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                       struct sl_target *target) {
+    struct sl_post *post = &oo->post;
+    struct sl_post_target *pt = &target->post;
+    if (!post->active) {
+        return;
+    }
+
+    /* the scene as the render pass left it, the rest only ever holds
+       this frame. computing into them waits for the last frame to be
+       done reading */
+    VkImageMemoryBarrier barriers[2 + POST_BLOOM_LEVELS];
+    uint32_t barrierCount = 0;
+    initImageBarrier(&barriers[barrierCount++], pt->scene,
+                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+    if (pt->temp != VK_NULL_HANDLE) {
+        initImageBarrier(&barriers[barrierCount++], pt->temp, 0,
+                         VK_ACCESS_SHADER_READ_BIT |
+                             VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    for (uint32_t i = 0; i < pt->bloomLevels; i++) {
+        initImageBarrier(&barriers[barrierCount++], pt->bloom[i], 0,
+                         VK_ACCESS_SHADER_READ_BIT |
+                             VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, barrierCount, barriers);
+
+    /* every step reads what the one before wrote */
+    VkMemoryBarrier memoryBarrier = { 0 };
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkPipeline bound = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < pt->stepCount; i++) {
+        struct sl_post_step *step = &pt->steps[i];
+        if (step->pipeline != bound) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              step->pipeline);
+            bound = step->pipeline;
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                post->pipelineLayout, 0, 1, &step->set, 0,
+                                NULL);
+        vkCmdPushConstants(commandBuffer, post->pipelineLayout,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(step->params), &step->params);
+        vkCmdDispatch(commandBuffer, step->groups[0], step->groups[1], 1);
+        if (i + 1 < pt->stepCount) {
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &memoryBarrier, 0, NULL, 0, NULL);
+        }
+    }
+
+    /* the swapchain image is first touched here, the acquire semaphore
+       waits for the transfer stage */
+    VkImage image = target->swapChainImages[target->imageIndex];
+    initImageBarrier(&barriers[0], pt->scene, VK_ACCESS_SHADER_WRITE_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    initImageBarrier(&barriers[1], image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         2, barriers);
+
+    /* same size, the blit is only there for the format conversion */
+    VkExtent2D extent = target->swapChainExtent;
+    VkImageBlit region = { 0 };
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffsets[1].x = (int32_t)extent.width;
+    region.srcOffsets[1].y = (int32_t)extent.height;
+    region.srcOffsets[1].z = 1;
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffsets[1] = region.srcOffsets[1];
+    vkCmdBlitImage(commandBuffer, pt->scene,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                   VK_FILTER_NEAREST);
+
+    /* where the render pass used to leave it, for the present, a
+       screenshot or the stream */
+    VkImageLayout finalLayout = oo->headless
+                                    ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    initImageBarrier(&barriers[0], image, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, NULL, 0, NULL, 1, barriers);
+}
@@ -0,0 +1,123 @@
+#ifndef POST_H
+#define POST_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* compute post-processing after the render pass. with a chain set, the
+   scene is rendered into a float image instead of the swapchain image,
+   the passes work on it in compute and a blit writes it into the
+   swapchain image, converting to its format on the way. no full screen
+   triangles, every pass reads what it needs once: bloom runs on a chain
+   of half resolution levels whose downsample sums 2x2 quads with
+   subgroup operations (shared memory without them), the blur keeps a run
+   of a row or column and its apron in shared memory. writing the
+   swapchain image from compute would save the blit, but storage usage
+   is rarely offered for the srgb formats we pick. */
+
+struct sl_oo;
+struct sl_target;
+
+enum PostPass {
+    /* bright parts spread out, on a chain of smaller levels */
+    POST_BLOOM,
+    /* separable gaussian at full resolution */
+    POST_BLUR,
+    /* exposure and back into 0..1, only as the last pass */
+    POST_TONEMAP,
+    POST_PASS_COUNT,
+};
+
+/* flags of sl_post_params, the shaders test the same bits */
+#define POST_FLAG_THRESHOLD 1u
+#define POST_FLAG_VERTICAL 2u
+
+/* push constants of every post shader, what a and b mean is up to it */
+struct sl_post_params {
+    uint32_t width;
+    uint32_t height;
+    float a;
+    float b;
+    uint32_t flags;
+};
+
+/* one dispatch, a barrier follows every one */
+struct sl_post_step {
+    VkPipeline pipeline;
+    VkDescriptorSet set;
+    struct sl_post_params params;
+    uint32_t groups[2];
+};
+
+/* a target's images and the chain compiled against them, made again with
+   its swapchain */
+struct sl_post_target {
+    /* the render pass resolves or renders into this */
+    VkImage scene;
+    VkDeviceMemory sceneMemory;
+    VkImageView sceneView;
+    /* between the two directions of the blur */
+    VkImage temp;
+    VkDeviceMemory tempMemory;
+    VkImageView tempView;
+    /* level 0 is half the scene, every one after half of that */
+    VkImage bloom[POST_BLOOM_LEVELS];
+    VkDeviceMemory bloomMemory[POST_BLOOM_LEVELS];
+    VkImageView bloomViews[POST_BLOOM_LEVELS];
+    VkExtent2D bloomExtents[POST_BLOOM_LEVELS];
+    uint32_t bloomLevels;
+
+    VkDescriptorPool descriptorPool;
+    struct sl_post_step steps[POST_MAX_STEPS];
+    uint32_t stepCount;
+};
+
+struct sl_post {
+    /* options, set before createPostProcess */
+    enum PostPass passes[POST_MAX_PASSES];
+    uint32_t passCount;
+
+    /* a chain is set and the device can run it */
+    bool active;
+    /* quad operations in compute, with subgroups that tile a group */
+    bool subgroups;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkPipelineLayout pipelineLayout;
+    /* linear, clamped to the edge */
+    VkSampler sampler;
+    VkPipeline down;
+    VkPipeline up;
+    VkPipeline blur;
+    VkPipeline tonemap;
+};
+
+/* "bloom,blur,tonemap", false for an unknown pass or a misplaced tonemap */
+bool parsePostPasses(const char *list, struct sl_post *post);
+
+/* after createLogicalDevice and before createSwapChain, does nothing
+   without passes */
+void createPostProcess(struct sl_oo *oo);
+void destroyPostProcess(struct sl_oo *oo);
+
+/* what the render pass renders into */
+VkFormat sceneFormat(struct sl_oo *oo, struct sl_target *target);
+/* what a swapchain image needs on top for the blit. turns
+   post-processing off when the image cannot have it and nothing was
+   built for it yet */
+VkImageUsageFlags postSwapchainUsage(struct sl_oo *oo, VkFormat format,
+                                     VkImageUsageFlags supportedUsage);
+
+/* with the target's other attachments */
+void createPostTarget(struct sl_oo *oo, struct sl_target *target);
+void destroyPostTarget(struct sl_oo *oo, struct sl_target *target);
+
+/* after the target's render pass, leaves the swapchain image in the
+   layout the pass used to */
+void recordPostProcess(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                       struct sl_target *target);
+
+#endif /* POST_H */
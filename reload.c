@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "reload.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+
+#define SHADER_DIR "shaders"
+
+/* NULL if the file is missing, half written or not spir-v at all, which
+   happens while make is still running */
+static VkShaderModule loadShader(struct sl_oo *oo, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return VK_NULL_HANDLE;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 20 || size % 4 != 0) {
+        fclose(fp);
+        return VK_NULL_HANDLE;
+    }
+    uint32_t *code = malloc(size);
+    size_t r = fread(code, 1, size, fp);
+    fclose(fp);
+    if (r != (size_t)size || code[0] != 0x07230203) {
+        free(code);
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(oo->device, &createInfo,
+                             hostAllocator(oo, ALLOC_PIPELINES),
+                             &shaderModule) != VK_SUCCESS) {
+        shaderModule = VK_NULL_HANDLE;
+    }
+    free(code);
+    return shaderModule;
+}
+
+static void reloadShaders(struct sl_oo *oo) {
+    struct sl_reload *reload = &oo->reload;
+
+    VkShaderModule vertShaderModule = loadShader(oo, SHADER_DIR "/vert.spv");
+    VkShaderModule fragShaderModule = loadShader(oo, SHADER_DIR "/frag.spv");
+    if (vertShaderModule == VK_NULL_HANDLE ||
+        fragShaderModule == VK_NULL_HANDLE) {
+        error_log("shaders changed but cannot be loaded, keeping the old "
+                  "ones");
+        vkDestroyShaderModule(oo->device, vertShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyShaderModule(oo->device, fragShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        return;
+    }
+
+    pthread_mutex_lock(&reload->lock);
+    /* never seen by the registry, nothing else references them */
+    if (reload->pending) {
+        vkDestroyShaderModule(oo->device, reload->vertShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyShaderModule(oo->device, reload->fragShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    reload->vertShaderModule = vertShaderModule;
+    reload->fragShaderModule = fragShaderModule;
+    __atomic_store_n(&reload->pending, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&reload->lock);
+
+    fprintf(stderr, "shaders changed, rebuilding pipelines\n");
+}
+
+static void *shaderWatcher(void *arg) {
+    struct sl_oo *oo = arg;
+    struct sl_reload *reload = &oo->reload;
+    bool changed = false;
+    char buffer[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        struct pollfd fds[2] = { { reload->fd, POLLIN, 0 },
+                                 { reload->wakeFds[0], POLLIN, 0 } };
+        /* after a change, wait until the directory has been quiet for a
+           moment before loading anything */
+        int n = poll(fds, 2, changed ? SHADER_RELOAD_SETTLE_MS : -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error_log("shader watcher failed: %s", strerror(errno));
+            return NULL;
+        }
+        if (fds[1].revents != 0) {
+            return NULL;
+        }
+        if (n == 0) {
+            changed = false;
+            reloadShaders(oo);
+            continue;
+        }
+
+        ssize_t length = read(reload->fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event *event =
+                (const struct inotify_event *)(buffer + offset);
+            if (event->len > 0 && (strcmp(event->name, "vert.spv") == 0 ||
+                                   strcmp(event->name, "frag.spv") == 0)) {
+                changed = true;
+            }
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+void createShaderReload(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createShaderReload");
+
+    struct sl_reload *reload = &oo->reload;
+    if (!reload->enabled) {
+        return;
+    }
+
+    reload->fd = inotify_init1(IN_CLOEXEC);
+    if (reload->fd < 0) {
+        error_log("shader reload disabled, inotify: %s", strerror(errno));
+        return;
+    }
+    /* make rewrites the files in place, editors and scripts often write a
+       temporary file and rename it over the old one */
+    if (inotify_add_watch(reload->fd, SHADER_DIR,
+                          IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        error_log("shader reload disabled, cannot watch %s: %s", SHADER_DIR,
+                  strerror(errno));
+        close(reload->fd);
+        return;
+    }
+    if (pipe(reload->wakeFds) != 0) {
+        error_log("failed to create shader watcher pipe!");
+        exit(1);
+    }
+
+    pthread_mutex_init(&reload->lock, NULL);
+    if (pthread_create(&reload->watcher, NULL, shaderWatcher, oo) != 0) {
+        error_log("failed to start shader watcher thread!");
+        exit(1);
+    }
+    reload->running = true;
+}
+
+void destroyShaderReload(struct sl_oo *oo) {
+    struct sl_reload *reload = &oo->reload;
+    if (!reload->running) {
+        return;
+    }
+
+    char wake = 0;
+    if (write(reload->wakeFds[1], &wake, 1) != 1) {
+        error_log("failed to wake shader watcher!");
+    }
+    pthread_join(reload->watcher, NULL);
+    close(reload->wakeFds[0]);
+    close(reload->wakeFds[1]);
+    close(reload->fd);
+
+    if (reload->pending) {
+        vkDestroyShaderModule(oo->device, reload->vertShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyShaderModule(oo->device, reload->fragShaderModule,
+                              hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    pthread_mutex_destroy(&reload->lock);
+    reload->running = false;
+}
+
+void collectShaderReload(struct sl_oo *oo) {
+    struct sl_reload *reload = &oo->reload;
+    if (!reload->running ||
+        !__atomic_load_n(&reload->pending, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    pthread_mutex_lock(&reload->lock);
+    /* stays pending while the registry still has every shader set busy
+       with older generations, it is tried again next frame */
+    if (beginShaderGeneration(oo, reload->vertShaderModule,
+                              reload->fragShaderModule)) {
+        reload->pending = false;
+    }
+    pthread_mutex_unlock(&reload->lock);
+}
+
+#else
+
+void createShaderReload(struct sl_oo *oo) {
+    if (oo->reload.enabled) {
+        error_log("shader reload needs inotify, not available here");
+    }
+}
+
+void destroyShaderReload(struct sl_oo *oo) {}
+
+void collectShaderReload(struct sl_oo *oo) {}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* shader hot reload. a watcher thread waits for the spv files in shaders/
+   to change, loads them and creates the modules, drawFrame hands those to
+   the pipeline registry between frames. the variants are compiled by the
+   registry's workers and swapped in once ready, so nothing waits. */
+
+struct sl_oo;
+
+struct sl_reload {
+    /* option, set before createShaderReload */
+    bool enabled;
+
+    bool running;
+    int fd;
+    /* written to by destroyShaderReload to wake the watcher */
+    int wakeFds[2];
+    pthread_t watcher;
+
+    /* modules loaded but not taken yet, a newer change replaces them */
+    pthread_mutex_t lock;
+    bool pending;
+    VkShaderModule vertShaderModule;
+    VkShaderModule fragShaderModule;
+};
+
+/* both do nothing unless reload.enabled is set */
+void createShaderReload(struct sl_oo *oo);
+void destroyShaderReload(struct sl_oo *oo);
+
+/* called by drawFrame before selectPipelines */
+void collectShaderReload(struct sl_oo *oo);
+
+#endif /* RELOAD_H */
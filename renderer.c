@@ -0,0 +1,2778 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "log.h"
+
+#include <errno.h>
+#include <time.h>
+
+#ifdef NDEBUG
+enum ValidationLevel validationLevel = VALIDATION_OFF;
+bool enableValidationLayers = false;
+#else
+enum ValidationLevel validationLevel = VALIDATION_WARNING;
+bool enableValidationLayers = true;
+#endif
+
+void add_to_unique_set(uint32_t *set, int *size, uint32_t value) {
+    /* TODO: make a binary search here, like a real set */
+    bool should_add = true;
+
+    for (int i = 0; i < *size; i++) {
+        if (set[i] == value) {
+            should_add = false;
+            break;
+        }
+    }
+
+    if (should_add) {
+        set[*size] = value;
+        *size += 1;
+    }
+}
+
+/* ugly workaround of the OO features in the original tutorial */
+bool QueueFamilyIndicesIsComplete(
+    struct QueueFamilyIndices *queueFamiliyIndices) {
+    return queueFamiliyIndices->graphicsFamilyHasValue &&
+           queueFamiliyIndices->presentFamilyHasValue;
+}
+
+void DestroySwapChainSupportDetails(struct SwapChainSupportDetails *details) {
+    free(details->formats);
+    free(details->presentModes);
+}
+
+bool parseValidationLevel(const char *s, enum ValidationLevel *level) {
+    static const char *names[] = { "off", "error", "warning", "info",
+                                   "verbose" };
+    for (int i = 0; i < sizeof(names) / sizeof(char *); i++) {
+        if (strcmp(s, names[i]) == 0) {
+            *level = (enum ValidationLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void error_log(const char *s, ...) {
+    va_list argptr;
+    va_start(argptr, s);
+    vfprintf(stderr, s, argptr);
+    va_end(argptr);
+    fprintf(stderr, "\n");
+}
+
+bool checkValidationLayerSupport() {
+    uint32_t layerCount;
+    vkEnumerateInstanceLayerProperties(&layerCount, NULL);
+
+    VkLayerProperties *availableLayers =
+        malloc(sizeof(VkLayerProperties) * layerCount);
+
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers);
+
+    for (int i = 0; i < sizeof(validationLayers) / sizeof(char *); i++) {
+        bool layerFound = false;
+
+        for (int j = 0; j < layerCount; j++) {
+            if (strcmp(validationLayers[i], availableLayers[j].layerName) ==
+                0) {
+                layerFound = true;
+                break;
+            }
+        }
+
+        if (!layerFound) {
+            free(availableLayers);
+            return false;
+        }
+    }
+
+    free(availableLayers);
+    return true;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL
+debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+              VkDebugUtilsMessageTypeFlagsEXT messageType,
+              const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
+              void *pUserData) {
+    /* this runs inside whatever vulkan call triggered it, so only copy
+       the message into the ring and let the log thread do the stdio */
+    log_push(messageSeverity, pCallbackData->messageIdNumber,
+             pCallbackData->pMessage);
+
+    return VK_FALSE;
+}
+
+VkResult CreateDebugUtilsMessengerEXT(
+    VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator,
+    VkDebugUtilsMessengerEXT *pDebugMessenger) {
+    PFN_vkCreateDebugUtilsMessengerEXT func =
+        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+            instance, "vkCreateDebugUtilsMessengerEXT");
+    if (func != NULL) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance,
+                                   VkDebugUtilsMessengerEXT debugMessenger,
+                                   const VkAllocationCallbacks *pAllocator) {
+    PFN_vkDestroyDebugUtilsMessengerEXT func =
+        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+            instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func != NULL) {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+void populateDebugMessengerCreateInfo(
+    VkDebugUtilsMessengerCreateInfoEXT *createInfo) {
+    memset(createInfo, 0, sizeof(VkDebugUtilsMessengerCreateInfoEXT));
+    createInfo->sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    /* each level includes everything above it */
+    createInfo->messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (validationLevel >= VALIDATION_WARNING) {
+        createInfo->messageSeverity |=
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    }
+    if (validationLevel >= VALIDATION_INFO) {
+        createInfo->messageSeverity |=
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    if (validationLevel >= VALIDATION_VERBOSE) {
+        createInfo->messageSeverity |=
+            VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
+    createInfo->messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                              VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo->pfnUserCallback = debugCallback;
+}
+
+bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    struct QueueFamilyIndices indices = findQueueFamilies(device, surface);
+
+    bool extensionsSupported = checkDeviceExtensionSupport(device);
+
+    bool swapChainAdequate = false;
+    if (surface == VK_NULL_HANDLE) {
+        /* headless, nothing to present to */
+        swapChainAdequate = true;
+    } else if (extensionsSupported) {
+        struct SwapChainSupportDetails swapChainSupport =
+            querySwapChainSupport(device, surface, NULL);
+        /* originally the tutorial check for empty vector here */
+        /* in my case, the formats and presentModes will be NULL if
+           the malloc did not happened */
+        swapChainAdequate = swapChainSupport.formats != NULL &&
+                            swapChainSupport.presentModes != NULL;
+
+        /* since we used malloc before, free it using a custom function */
+        DestroySwapChainSupportDetails(&swapChainSupport);
+    }
+
+    return QueueFamilyIndicesIsComplete(&indices) && extensionsSupported &&
+           swapChainAdequate;
+}
+
+/* the tutorial mentions rateDeviceSuitability but only uses the first
+   suitable device, which on hybrid laptops is usually the integrated
+   GPU. 0 means unusable, otherwise higher is better. */
+int64_t rateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface) {
+    if (!isDeviceSuitable(device, surface)) {
+        return 0;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+
+    /* the device type dominates everything else */
+    int64_t tier = 0;
+    switch (properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        tier = 3;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        tier = 2;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        tier = 1;
+        break;
+    default:
+        /* cpu and other are software rasterizers */
+        break;
+    }
+
+    /* the rest only breaks ties within a tier, device local memory
+       first, one point per MiB */
+    int64_t score = 0;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    VkDeviceSize deviceLocal = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (memoryProperties.memoryHeaps[i].flags &
+            VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            deviceLocal += memoryProperties.memoryHeaps[i].size;
+        }
+    }
+    score += (int64_t)(deviceLocal >> 20);
+
+    /* a few limits that roughly track the size of the chip */
+    score += properties.limits.maxImageDimension2D / 1024;
+    score += properties.limits.maxComputeSharedMemorySize / 1024;
+    score += properties.limits.maxColorAttachments;
+
+    /* queue topology: a single family doing graphics and present avoids
+       concurrent sharing, dedicated transfer/compute families are a bonus */
+    struct QueueFamilyIndices indices = findQueueFamilies(device, surface);
+    if (indices.graphicsFamily == indices.presentFamily) {
+        score += DEVICE_SCORE_QUEUE;
+    }
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties *queueFamilies =
+        malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                             queueFamilies);
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (!(flags & VK_QUEUE_GRAPHICS_BIT) &&
+            (flags & (VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT))) {
+            score += DEVICE_SCORE_QUEUE;
+        }
+    }
+    free(queueFamilies);
+
+    /* a software rasterizer's heap is system memory, however large it is
+       it must not climb a tier */
+    if (score >= DEVICE_SCORE_TIER) {
+        score = DEVICE_SCORE_TIER - 1;
+    }
+    return 1 + tier * DEVICE_SCORE_TIER + score;
+}
+
+void getDeviceUUID(VkPhysicalDevice device, uint8_t uuid[VK_UUID_SIZE]) {
+    memset(uuid, 0, VK_UUID_SIZE);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    /* deviceUUID needs 1.1, old drivers just get a zero uuid */
+    if (properties.apiVersion < VK_API_VERSION_1_1) {
+        return;
+    }
+
+    VkPhysicalDeviceIDProperties idProperties = { 0 };
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = { 0 };
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+
+    memcpy(uuid, idProperties.deviceUUID, VK_UUID_SIZE);
+}
+
+void formatUUID(const uint8_t uuid[VK_UUID_SIZE], char *s) {
+    /* 8-4-4-4-12, s must hold at least 37 chars */
+    for (int i = 0; i < VK_UUID_SIZE; i++) {
+        s += sprintf(s, "%02x", uuid[i]);
+        if (i == 3 || i == 5 || i == 7 || i == 9) {
+            *s++ = '-';
+        }
+    }
+    *s = '\0';
+}
+
+/* a selector is an index from --list-devices, a uuid with or without
+   dashes, or a case insensitive substring of the device name */
+bool deviceMatchesSelector(VkPhysicalDevice device, int index,
+                           const char *selector) {
+    char *end = NULL;
+    long n = strtol(selector, &end, 10);
+    if (end != selector && *end == '\0') {
+        return n == index;
+    }
+
+    char hex[VK_UUID_SIZE * 2 + 1] = { 0 };
+    int hexLen = 0;
+    bool isUUID = true;
+    for (const char *c = selector; *c != '\0'; c++) {
+        if (*c == '-') {
+            continue;
+        }
+        if (!isxdigit((unsigned char)*c) || hexLen == VK_UUID_SIZE * 2) {
+            isUUID = false;
+            break;
+        }
+        hex[hexLen++] = tolower((unsigned char)*c);
+    }
+
+    if (isUUID && hexLen == VK_UUID_SIZE * 2) {
+        uint8_t uuid[VK_UUID_SIZE];
+        char s[VK_UUID_SIZE * 2 + 5];
+        getDeviceUUID(device, uuid);
+        formatUUID(uuid, s);
+
+        /* compare without the dashes */
+        int j = 0;
+        for (int i = 0; s[i] != '\0'; i++) {
+            if (s[i] != '-') {
+                s[j++] = s[i];
+            }
+        }
+        s[j] = '\0';
+        return strcmp(s, hex) == 0;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    size_t selectorLen = strlen(selector);
+    for (const char *c = properties.deviceName; *c != '\0'; c++) {
+        if (strncasecmp(c, selector, selectorLen) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *deviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+
+    VkExtensionProperties *availableExtensions =
+        malloc(sizeof(VkExtensionProperties) * extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount,
+                                         availableExtensions);
+
+    /* I hate seeing the set in C++ */
+    /* again, the tutorial uses a set to eliminate duplicated data */
+
+    /* luckily, this time, it says we can use a loop like
+       checkValidationLayerSupport */
+    for (int i = 0; i < sizeof(deviceExtensions) / sizeof(char *); i++) {
+        bool found = false;
+        for (int j = 0; j < extensionCount; j++) {
+            if (strcmp(deviceExtensions[i],
+                       availableExtensions[j].extensionName) == 0) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            free(availableExtensions);
+            return false;
+        }
+    }
+
+    free(availableExtensions);
+
+    return true;
+}
+
+/* for the optional ones, enabled only when there */
+bool checkDeviceExtension(VkPhysicalDevice device, const char *name) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+
+    VkExtensionProperties *availableExtensions =
+        malloc(sizeof(VkExtensionProperties) * extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount,
+                                         availableExtensions);
+
+    bool found = false;
+    for (uint32_t i = 0; i < extensionCount; i++) {
+        if (strcmp(availableExtensions[i].extensionName, name) == 0) {
+            found = true;
+            break;
+        }
+    }
+
+    free(availableExtensions);
+    return found;
+}
+
+struct QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
+                                            VkSurfaceKHR surface) {
+    struct QueueFamilyIndices indices = { 0 };
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
+
+    VkQueueFamilyProperties *queueFamilies =
+        malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                             queueFamilies);
+    for (int i = 0; i < queueFamilyCount; i++) {
+        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            indices.graphicsFamily = i;
+            /* work around of optional */
+            indices.graphicsFamilyHasValue = true;
+        }
+
+        /* headless never presents, the graphics queue stands in */
+        VkBool32 presentSupport = false;
+        if (surface == VK_NULL_HANDLE) {
+            presentSupport = indices.graphicsFamilyHasValue &&
+                             indices.graphicsFamily == i;
+        } else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface,
+                                                 &presentSupport);
+        }
+        if (presentSupport) {
+            indices.presentFamily = i;
+            /* work around of optional */
+            indices.presentFamilyHasValue = true;
+        }
+
+        if (QueueFamilyIndicesIsComplete(&indices)) {
+            break;
+        }
+    }
+
+    free(queueFamilies);
+    return indices;
+}
+
+/* compute dispatches recorded into the graphics command buffer */
+bool graphicsQueueSupportsCompute(struct sl_oo *oo) {
+    struct QueueFamilyIndices indices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(oo->physicalDevice,
+                                             &queueFamilyCount, NULL);
+    VkQueueFamilyProperties *queueFamilies =
+        malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        oo->physicalDevice, &queueFamilyCount, queueFamilies);
+    bool compute = (queueFamilies[indices.graphicsFamily].queueFlags &
+                    VK_QUEUE_COMPUTE_BIT) != 0;
+    free(queueFamilies);
+
+    return compute;
+}
+
+struct SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device,
+                                                     VkSurfaceKHR surface,
+                                                     struct sl_arena *arena) {
+    struct SwapChainSupportDetails details = { 0 };
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface,
+                                              &details.capabilities);
+
+    uint32_t formatCount;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, NULL);
+    if (formatCount != 0) {
+        size_t size = sizeof(VkSurfaceFormatKHR) * formatCount;
+        details.formats = arena != NULL ? arenaAlloc(arena, size)
+                                        : malloc(size);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount,
+                                             details.formats);
+        details.formatsSize = formatCount;
+    }
+
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface,
+                                              &presentModeCount, NULL);
+    if (presentModeCount != 0) {
+        size_t size = sizeof(VkPresentModeKHR) * presentModeCount;
+        details.presentModes = arena != NULL ? arenaAlloc(arena, size)
+                                             : malloc(size);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(
+            device, surface, &presentModeCount, details.presentModes);
+        details.presentModesSize = presentModeCount;
+    }
+
+    return details;
+}
+
+VkSurfaceFormatKHR
+chooseSwapSurfaceFormat(const VkSurfaceFormatKHR *availableFormats, int size) {
+    /* make sure availableFormats is not NULL */
+    for (int i = 0; i < size; i++) {
+        if (availableFormats[i].format == VK_FORMAT_B8G8R8A8_SRGB &&
+            availableFormats[i].colorSpace ==
+                VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return availableFormats[i];
+        }
+    }
+
+    return availableFormats[0];
+}
+
+VkPresentModeKHR
+chooseSwapPresentMode(const VkPresentModeKHR *availablePresentModes, int size) {
+    /* make sure availablePresentModes is not NULL */
+    for (int i = 0; i < size; i++) {
+        if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+            return availablePresentModes[i];
+        }
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+/* a custom clamp function from https://stackoverflow.com/questions/427477/fastest-way-to-clamp-a-real-fixed-floating-point-value */
+uint32_t clamp(uint32_t v, uint32_t lo, uint32_t hi) {
+    const uint32_t t = v < lo ? lo : v;
+    return t > hi ? hi : t;
+}
+
+VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR *capabilities,
+                            SDL_Window *window) {
+    /* std::numeric_limits<uint32_t>::max() should equal to UINT32_MAX */
+    if (capabilities->currentExtent.width != UINT32_MAX) {
+        return capabilities->currentExtent;
+    } else {
+        int width = 0;
+        int height = 0;
+        SDL_Vulkan_GetDrawableSize(window, &width, &height);
+
+        VkExtent2D actualExtent = { (uint32_t)width, (uint32_t)height };
+        actualExtent.width = clamp(actualExtent.width,
+                                   capabilities->minImageExtent.width,
+                                   capabilities->maxImageExtent.width);
+        actualExtent.height = clamp(actualExtent.height,
+                                    capabilities->minImageExtent.height,
+                                    capabilities->maxImageExtent.height);
+
+        return actualExtent;
+    }
+}
+
+/* like findMemoryType but returns false instead of exiting */
+bool tryFindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+                       VkMemoryPropertyFlags properties, uint32_t *index) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) ==
+                properties) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+                        VkMemoryPropertyFlags properties) {
+    uint32_t index = 0;
+    if (!tryFindMemoryType(physicalDevice, typeFilter, properties, &index)) {
+        error_log("failed to find suitable memory type!");
+        exit(1);
+    }
+    return index;
+}
+
+VkFormat findSupportedFormat(VkPhysicalDevice physicalDevice,
+                             const VkFormat *candidates, int size,
+                             VkImageTiling tiling,
+                             VkFormatFeatureFlags features) {
+    for (int i = 0; i < size; i++) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, candidates[i],
+                                            &props);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR &&
+            (props.linearTilingFeatures & features) == features) {
+            return candidates[i];
+        } else if (tiling == VK_IMAGE_TILING_OPTIMAL &&
+                   (props.optimalTilingFeatures & features) == features) {
+            return candidates[i];
+        }
+    }
+
+    error_log("failed to find supported format!");
+    exit(1);
+}
+
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice) {
+    /* reverse-z only pays off with a float format, the unorm one is the
+       last resort and merely works */
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT,
+                                    VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                    VK_FORMAT_D24_UNORM_S8_UINT };
+    return findSupportedFormat(
+        physicalDevice, candidates, sizeof(candidates) / sizeof(VkFormat),
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+/* the largest supported count not above requested, requested is rounded
+   down to a power of two */
+VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice physicalDevice,
+                                              uint32_t requested) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    /* the depth attachment has the same number of samples */
+    VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+                                properties.limits.framebufferDepthSampleCounts;
+
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > 1; count >>= 1) {
+        if (count <= requested && (counts & count)) {
+            return (VkSampleCountFlagBits)count;
+        }
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+bool parseNumber(const char *s, unsigned long max, uint32_t *value) {
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(s, &end, 10);
+    if (end == s || *end != '\0' || s[0] == '-' || errno != 0 || n > max) {
+        return false;
+    }
+    *value = (uint32_t)n;
+    return true;
+}
+
+double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(double *values, uint32_t count, double p) {
+    if (count == 0) {
+        return 0.0;
+    }
+    qsort(values, count, sizeof(double), compareDouble);
+    return values[(uint32_t)(p * (count - 1) + 0.5)];
+}
+
+char *readFile(const char *filename, uint32_t *size) {
+    /* this function in not null-terminated */
+    FILE *fp = fopen(filename, "rb");
+
+    if (fp == NULL) {
+        error_log("failed to open file!");
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *s = malloc(sizeof(char) * *size);
+
+    int r = fread(s, sizeof(char), *size, fp);
+    if (r == 0) {
+        error_log("fread error!");
+    }
+
+    fclose(fp);
+
+    return s;
+}
+
+/* destroyed with the same allocator, hostAllocator(oo, ALLOC_PIPELINES) */
+VkShaderModule createShaderModule(struct sl_oo *oo, const char *code,
+                                  uint32_t size) {
+    VkShaderModuleCreateInfo createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = (uint32_t *)code;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(oo->device, &createInfo,
+                             hostAllocator(oo, ALLOC_PIPELINES),
+                             &shaderModule) != VK_SUCCESS) {
+        error_log("failed to create shader module!");
+        exit(1);
+    }
+
+    return shaderModule;
+}
+
+VkPipeline createComputePipeline(struct sl_oo *oo, const char *path,
+                                 VkPipelineLayout layout) {
+    uint32_t compShaderSize = 0;
+    char *compShaderCode = readFile(path, &compShaderSize);
+    VkShaderModule compShaderModule =
+        createShaderModule(oo, compShaderCode, compShaderSize);
+
+    VkComputePipelineCreateInfo pipelineInfo = { 0 };
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(oo->device, VK_NULL_HANDLE, 1, &pipelineInfo,
+                                 hostAllocator(oo, ALLOC_PIPELINES),
+                                 &pipeline) != VK_SUCCESS) {
+        error_log("failed to create compute pipeline %s!", path);
+        exit(1);
+    }
+
+    vkDestroyShaderModule(oo->device, compShaderModule,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    free(compShaderCode);
+    return pipeline;
+}
+
+static void beginTargetPass(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                            struct sl_target *target,
+                            VkRenderPass renderPass) {
+    VkExtent2D swapChainExtent = target->swapChainExtent;
+
+    VkRenderPassBeginInfo renderPassInfo = { 0 };
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer =
+        target->swapChainFramebuffers[target->imageIndex];
+    VkOffset2D offset = { 0, 0 };
+    renderPassInfo.renderArea.offset = offset;
+    renderPassInfo.renderArea.extent = swapChainExtent;
+
+    VkClearValue clearValues[2] = { 0 };
+    clearValues[0].color.float32[3] = 1.0f;
+    clearValues[1].depthStencil.depth = 0.0f;
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = { 0 };
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapChainExtent.width;
+    viewport.height = (float)swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = { 0 };
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+/* the instances of one set, without occlusion culling what
+   cullInstances wrote */
+static void recordScene(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                        enum OcclusionSet set) {
+    struct sl_cull *cull = &oo->cull;
+    if (cull->visible == 0) {
+        return;
+    }
+
+    struct sl_mesh *mesh = &oo->mesh;
+    VkBuffer buffers[2] = { VK_NULL_HANDLE, mesh->buffer };
+    VkDeviceSize offsets[2] = { 0, mesh->vertexOffset };
+    buffers[0] = occlusionInstances(oo, set, &offsets[0]);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, mesh->buffer, mesh->indexOffset,
+                         mesh->indexType);
+    vkCmdPushConstants(commandBuffer, oo->pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mesh->decode),
+                       &mesh->decode);
+    bindLatch(oo, commandBuffer, oo->currentFrame);
+
+    /* one draw per level of detail, each over its own range of the
+       instances and of the indices. the tests count theirs on the gpu */
+    int passes = oo->depthPrepass ? 2 : 1;
+    for (int pass = 0; pass < passes; pass++) {
+        bool prepass = pass + 1 < passes;
+        VkPipeline pipeline = prepass ? oo->depthPrepassPipeline
+                                      : oo->graphicsPipeline;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline);
+        recordPipelineState(oo, commandBuffer,
+                            prepass ? &oo->depthPrepassKey
+                                    : &oo->graphicsKey);
+        for (uint32_t lod = 0; lod < mesh->lodCount; lod++) {
+            if (cull->lodVisible[lod] == 0) {
+                continue;
+            }
+            if (set != OCCLUSION_NONE) {
+                drawOcclusionSet(oo, commandBuffer, set, lod);
+                continue;
+            }
+            vkCmdDrawIndexed(commandBuffer, mesh->lods[lod].indexCount,
+                             cull->lodVisible[lod],
+                             mesh->lods[lod].firstIndex, 0,
+                             cull->lodFirst[lod]);
+        }
+    }
+}
+
+/* the scene into one target's framebuffer, the sprites only go over the
+   primary, their coordinates are its pixels. with occlusion culling the
+   primary's pass is split around the tests, the others draw both sets
+   the primary's tests left */
+static void recordTarget(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                         struct sl_target *target) {
+    bool primary = target == &oo->targets[0];
+    if (oo->occlusion.frame && primary) {
+        recordOcclusionEarly(oo, commandBuffer);
+        beginTargetPass(oo, commandBuffer, target, oo->earlyRenderPass);
+        recordScene(oo, commandBuffer, OCCLUSION_EARLY);
+        vkCmdEndRenderPass(commandBuffer);
+
+        recordOcclusionLate(oo, commandBuffer, target);
+        beginTargetPass(oo, commandBuffer, target, oo->lateRenderPass);
+        recordScene(oo, commandBuffer, OCCLUSION_LATE);
+    } else {
+        beginTargetPass(oo, commandBuffer, target, oo->renderPass);
+        if (oo->occlusion.frame) {
+            recordScene(oo, commandBuffer, OCCLUSION_EARLY);
+            recordScene(oo, commandBuffer, OCCLUSION_LATE);
+        } else {
+            recordScene(oo, commandBuffer, OCCLUSION_NONE);
+        }
+    }
+
+    /* over the scene, what was pushed since the last frame */
+    if (primary) {
+        recordSprites(oo, commandBuffer);
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    recordPostProcess(oo, commandBuffer, target);
+}
+
+void recordCommandBuffer(struct sl_oo *oo, VkCommandBuffer commandBuffer) {
+    VkCommandBufferBeginInfo beginInfo = { 0 };
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0; // Optional
+    beginInfo.pInheritanceInfo = NULL; // Optional
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        error_log("failed to begin recording command buffer!");
+        exit(1);
+    }
+
+    uint32_t firstQuery = oo->currentFrame * 2;
+    if (oo->gpuTiming) {
+        vkCmdResetQueryPool(commandBuffer, oo->timestampQueryPool, firstQuery,
+                            2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            oo->timestampQueryPool, firstQuery);
+    }
+
+    /* the primary records first, the others draw what its tests let
+       through */
+    oo->occlusion.frame = oo->occlusion.active &&
+                          oo->targets[0].acquired && oo->cull.visible > 0;
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        if (oo->targets[i].acquired) {
+            recordTarget(oo, commandBuffer, &oo->targets[i]);
+        }
+    }
+
+    struct sl_target *primary = &oo->targets[0];
+    if (primary->acquired) {
+        recordCapture(oo, commandBuffer, primary->imageIndex);
+        recordStream(oo, commandBuffer, primary->imageIndex);
+    }
+
+    if (oo->gpuTiming) {
+        vkCmdWriteTimestamp(commandBuffer,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            oo->timestampQueryPool, firstQuery + 1);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        error_log("failed to record command buffer!");
+        exit(1);
+    }
+}
+
+/* false when the target has to be recreated first, it sits this frame
+   out */
+static bool acquireTarget(struct sl_oo *oo, struct sl_target *target) {
+    if (oo->headless) {
+        /* nothing to acquire, cycle through the offscreen images, the
+           fences already keep us from reusing one that is in flight */
+        target->imageIndex = oo->stats.frames % target->swapChainImagesCount;
+        return true;
+    }
+
+    VkResult result = vkAcquireNextImageKHR(
+        oo->device, target->swapChain, UINT64_MAX,
+        target->imageAvailableSemaphores[oo->currentFrame], VK_NULL_HANDLE,
+        &target->imageIndex);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        target->framebufferResized = true;
+        return false;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        error_log("failed to acquire swap chain image!");
+        exit(1);
+    }
+    return true;
+}
+
+void drawFrame(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "drawFrame");
+
+    /* with --pacing, until the last frame is shown and a bit after */
+    paceFrame(oo);
+
+    struct sl_trace_zone zone = traceZoneBegin(oo, "wait for fence");
+    vkWaitForFences(oo->device, 1, &oo->inFlightFences[oo->currentFrame],
+                    VK_TRUE, UINT64_MAX);
+    traceZoneEnd(&zone);
+
+    /* the fence covers the timestamps this slot wrote last time */
+    if (oo->gpuTiming && oo->stats.frames >= MAX_FRAMES_IN_FLIGHT) {
+        uint64_t timestamps[2] = { 0 };
+        if (vkGetQueryPoolResults(
+                oo->device, oo->timestampQueryPool, oo->currentFrame * 2, 2,
+                sizeof(timestamps), timestamps, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            oo->stats.gpuFrameMs = (double)(timestamps[1] - timestamps[0]) *
+                                   oo->timestampPeriod / 1e6;
+            oo->stats.gpuFrameValid = true;
+            traceGpuFrame(oo, timestamps[0], timestamps[1]);
+        }
+    }
+
+    /* the sets recorded into this slot last time are done with too */
+    resetFrameDescriptors(oo);
+
+    /* before the readbacks are handed out again, so pressure can keep
+       them from being recreated */
+    updateMemoryBudget(oo);
+
+    captureCollect(oo);
+    streamCollect(oo);
+    collectOcclusion(oo);
+
+    /* writes the region of the instance buffer the fence just freed */
+    if (oo->cmdlog.replaying) {
+        replayCmdlogFrame(oo);
+    } else {
+        cullInstances(oo);
+    }
+
+    /* every target first, so one submit and one present cover them all */
+    VkSemaphore waitSemaphores[MAX_TARGETS];
+    VkPipelineStageFlags waitStages[MAX_TARGETS];
+    VkSemaphore signalSemaphores[MAX_TARGETS];
+    VkSwapchainKHR swapChains[MAX_TARGETS];
+    uint32_t imageIndices[MAX_TARGETS];
+    struct sl_target *presented[MAX_TARGETS];
+    uint32_t acquiredCount = 0;
+    zone = traceZoneBegin(oo, "acquire");
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        struct sl_target *target = &oo->targets[i];
+        /* presenting to a minimized window can block until it is back */
+        target->acquired = !target->hidden && acquireTarget(oo, target);
+        if (!target->acquired) {
+            continue;
+        }
+        waitSemaphores[acquiredCount] =
+            target->imageAvailableSemaphores[oo->currentFrame];
+        /* post-processing blits into the image instead */
+        waitStages[acquiredCount] =
+            oo->post.active ? VK_PIPELINE_STAGE_TRANSFER_BIT
+                            : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        signalSemaphores[acquiredCount] =
+            target->renderFinishedSemaphores[oo->currentFrame];
+        swapChains[acquiredCount] = target->swapChain;
+        imageIndices[acquiredCount] = target->imageIndex;
+        presented[acquiredCount] = target;
+        acquiredCount++;
+    }
+    traceZoneEnd(&zone);
+    if (acquiredCount == 0) {
+        /* the fence is still signaled, the next try waits on nothing */
+        recreateResizedTargets(oo);
+        return;
+    }
+
+    vkResetFences(oo->device, 1, &oo->inFlightFences[oo->currentFrame]);
+
+    struct sl_target *primary = &oo->targets[0];
+    if (primary->acquired) {
+        captureBegin(oo);
+        streamBegin(oo, primary->imageIndex);
+    }
+
+    collectShaderReload(oo);
+    selectPipelines(oo, false);
+
+    zone = traceZoneBegin(oo, "record");
+    vkResetCommandBuffer(oo->commandBuffers[oo->currentFrame], 0);
+    recordCommandBuffer(oo, oo->commandBuffers[oo->currentFrame]);
+    recordCmdlogFrame(oo);
+    traceZoneEnd(&zone);
+
+    VkSubmitInfo submitInfo = { 0 };
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = oo->headless ? 0 : acquiredCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &oo->commandBuffers[oo->currentFrame];
+    submitInfo.signalSemaphoreCount = oo->headless ? 0 : acquiredCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    /* the last moment anything the frame shows can still change */
+    latchFrame(oo);
+
+    zone = traceZoneBegin(oo, "submit");
+    if (vkQueueSubmit(oo->graphicsQueue, 1, &submitInfo,
+                      oo->inFlightFences[oo->currentFrame]) != VK_SUCCESS) {
+        error_log("failed to submit draw command buffer!");
+        exit(1);
+    }
+    traceZoneEnd(&zone);
+    oo->stats.frames++;
+
+    if (oo->headless) {
+        oo->currentFrame = (oo->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return;
+    }
+
+    /* one present for every swapchain, each waiting for its own
+       semaphore of the submit */
+    VkResult results[MAX_TARGETS];
+    VkPresentInfoKHR presentInfo = { 0 };
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    presentInfo.waitSemaphoreCount = acquiredCount;
+    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.swapchainCount = acquiredCount;
+    presentInfo.pSwapchains = swapChains;
+    presentInfo.pImageIndices = imageIndices;
+    presentInfo.pResults = results;
+    /* the same id for every swapchain, paceFrame waits for the primary */
+    uint64_t presentIds[MAX_TARGETS];
+    VkPresentIdKHR presentId = { 0 };
+    presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    uint64_t id = latchPresentId(oo);
+    if (id != 0) {
+        for (uint32_t i = 0; i < acquiredCount; i++) {
+            presentIds[i] = id;
+        }
+        presentId.swapchainCount = acquiredCount;
+        presentId.pPresentIds = presentIds;
+        presentInfo.pNext = &presentId;
+    }
+    oo->latch.presentedSwapChain =
+        primary->acquired ? primary->swapChain : VK_NULL_HANDLE;
+    zone = traceZoneBegin(oo, "present");
+    VkResult result = vkQueuePresentKHR(oo->presentQueue, &presentInfo);
+    traceZoneEnd(&zone);
+    if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_DATE_KHR &&
+        result != VK_SUBOPTIMAL_KHR) {
+        error_log("failed to present swap chain image!");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < acquiredCount; i++) {
+        if (results[i] == VK_ERROR_OUT_OF_DATE_KHR ||
+            results[i] == VK_SUBOPTIMAL_KHR) {
+            presented[i]->framebufferResized = true;
+            /* an out of date present may never show */
+            if (presented[i] == primary) {
+                oo->latch.presentedSwapChain = VK_NULL_HANDLE;
+            }
+        } else if (results[i] != VK_SUCCESS) {
+            error_log("failed to present swap chain image!");
+            exit(1);
+        }
+    }
+    recreateResizedTargets(oo);
+
+    oo->currentFrame = (oo->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+/****** separation line */
+
+void createInstance(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createInstance");
+
+    if (enableValidationLayers && !checkValidationLayerSupport()) {
+        error_log("validation layers requested, but not available");
+        exit(1);
+    }
+
+    VkApplicationInfo appInfo = { 0 };
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Hello Triangle";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+    const char **extensions = malloc(sizeof(char **) * extensionCount);
+    int extensionIndex = 0;
+
+#ifdef __APPLE__
+    extensions[extensionIndex++] =
+        VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME;
+    extensions[extensionIndex++] =
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+    createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+#endif
+
+    /* headless has no window, so no surface extensions at all */
+    const char **sdlExtensions = NULL;
+    if (!oo->headless) {
+        extensions[extensionIndex++] = VK_KHR_SURFACE_EXTENSION_NAME;
+#ifdef __APPLE__
+        extensions[extensionIndex++] = VK_EXT_METAL_SURFACE_EXTENSION_NAME;
+#elif defined __linux__
+        extensions[extensionIndex++] = VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME;
+#endif
+
+        uint32_t sdlExtensionCount = 0;
+        if (SDL_Vulkan_GetInstanceExtensions(oo->targets[0].window,
+                                             &sdlExtensionCount,
+                                             NULL) == SDL_FALSE) {
+            error_log("cannot get instance extensions %s", SDL_GetError());
+            exit(1);
+        }
+        sdlExtensions = malloc(sizeof(char *) * sdlExtensionCount);
+        SDL_Vulkan_GetInstanceExtensions(oo->targets[0].window,
+                                         &sdlExtensionCount, sdlExtensions);
+
+        /* SDL asks for the surface extensions again, skip duplicates */
+        for (int i = 0; i < sdlExtensionCount; i++) {
+            bool found = false;
+            for (int j = 0; j < extensionIndex; j++) {
+                if (strcmp(extensions[j], sdlExtensions[i]) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                extensions[extensionIndex++] = sdlExtensions[i];
+            }
+        }
+    }
+    if (enableValidationLayers) {
+        /* This is from the original getRequiredExtensions() function,
+           c++ hide a lot of stuffs by extracting one-use function. */
+        extensions[extensionIndex] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+        extensionIndex += 1;
+    }
+
+    createInfo.enabledExtensionCount = extensionIndex;
+    createInfo.ppEnabledExtensionNames = extensions;
+
+    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = { 0 };
+    if (enableValidationLayers) {
+        createInfo.enabledLayerCount =
+            sizeof(validationLayers) / sizeof(char *);
+        createInfo.ppEnabledLayerNames = validationLayers;
+
+        populateDebugMessengerCreateInfo(&debugCreateInfo);
+        createInfo.pNext =
+            (VkDebugUtilsMessengerCreateInfoEXT *)&debugCreateInfo;
+    } else {
+        createInfo.enabledLayerCount = 0;
+        createInfo.pNext = NULL;
+    }
+
+    if (vkCreateInstance(&createInfo, hostAllocator(oo, ALLOC_INSTANCE),
+                         &oo->instance) != VK_SUCCESS) {
+        error_log("failed to create instance");
+        exit(1);
+    }
+
+    free(sdlExtensions);
+    free(extensions);
+}
+
+void setupDebugMessenger(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "setupDebugMessenger");
+
+    if (enableValidationLayers) {
+        VkDebugUtilsMessengerCreateInfoEXT createInfo = { 0 };
+        populateDebugMessengerCreateInfo(&createInfo);
+
+        VkResult result = CreateDebugUtilsMessengerEXT(
+            oo->instance, &createInfo, hostAllocator(oo, ALLOC_INSTANCE),
+            &oo->debugMessenger);
+        if (result != VK_SUCCESS) {
+            printf("result: %d\n", result);
+            error_log("failed to set up debug messenger!");
+            exit(1);
+        }
+    }
+}
+
+void createSurface(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createSurface");
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        struct sl_target *target = &oo->targets[i];
+        if (SDL_Vulkan_CreateSurface(target->window, oo->instance,
+                                     &target->surface) != SDL_TRUE) {
+            error_log("failed to create window surface! %s", SDL_GetError());
+            exit(1);
+        }
+    }
+}
+
+void pickPhysicalDevice(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "pickPhysicalDevice");
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(oo->instance, &deviceCount, NULL);
+    if (deviceCount == 0) {
+        error_log("failed to find GPUs with Vulkan support!");
+        exit(1);
+    }
+
+    VkPhysicalDevice *devices =
+        malloc(sizeof(VkPhysicalDevice *) * deviceCount);
+    vkEnumeratePhysicalDevices(oo->instance, &deviceCount, devices);
+
+    int64_t bestScore = 0;
+    for (int i = 0; i < deviceCount; i++) {
+        if (oo->deviceSelector != NULL &&
+            !deviceMatchesSelector(devices[i], i, oo->deviceSelector)) {
+            continue;
+        }
+
+        int64_t score =
+            rateDeviceSuitability(devices[i], oo->targets[0].surface);
+        if (score > bestScore) {
+            bestScore = score;
+            oo->physicalDevice = devices[i];
+        }
+    }
+
+    if (oo->physicalDevice == VK_NULL_HANDLE) {
+        /* never fall back silently when the user asked for a device */
+        if (oo->deviceSelector != NULL) {
+            error_log("no suitable GPU matches \"%s\", see --list-devices",
+                      oo->deviceSelector);
+        } else {
+            error_log("failed to find a suitable GPU!");
+        }
+        exit(1);
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    fprintf(stderr, "using GPU: %s (%s, score %lld)\n", properties.deviceName,
+            deviceTypeName(properties.deviceType), (long long)bestScore);
+
+    uint32_t requested = oo->msaaSamples;
+    oo->msaaSamples = getMaxUsableSampleCount(oo->physicalDevice, requested);
+    if (oo->msaaSamples != requested && requested > 1) {
+        fprintf(stderr, "%ux msaa is not supported, using %ux\n", requested,
+                oo->msaaSamples);
+    }
+
+    free(devices);
+}
+
+void listPhysicalDevices(struct sl_oo *oo) {
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(oo->instance, &deviceCount, NULL);
+
+    VkPhysicalDevice *devices =
+        malloc(sizeof(VkPhysicalDevice *) * deviceCount);
+    vkEnumeratePhysicalDevices(oo->instance, &deviceCount, devices);
+
+    for (int i = 0; i < deviceCount; i++) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(devices[i], &properties);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(devices[i], &memoryProperties);
+        VkDeviceSize deviceLocal = 0;
+        for (uint32_t j = 0; j < memoryProperties.memoryHeapCount; j++) {
+            if (memoryProperties.memoryHeaps[j].flags &
+                VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                deviceLocal += memoryProperties.memoryHeaps[j].size;
+            }
+        }
+
+        uint8_t uuid[VK_UUID_SIZE];
+        char uuidString[VK_UUID_SIZE * 2 + 5];
+        getDeviceUUID(devices[i], uuid);
+        formatUUID(uuid, uuidString);
+
+        int64_t score =
+            rateDeviceSuitability(devices[i], oo->targets[0].surface);
+
+        printf("%d: %s\n", i, properties.deviceName);
+        printf("    type:   %s\n", deviceTypeName(properties.deviceType));
+        printf("    id:     %04x:%04x\n", properties.vendorID,
+               properties.deviceID);
+        printf("    uuid:   %s\n", uuidString);
+        printf("    api:    %u.%u.%u\n",
+               VK_VERSION_MAJOR(properties.apiVersion),
+               VK_VERSION_MINOR(properties.apiVersion),
+               VK_VERSION_PATCH(properties.apiVersion));
+        printf("    memory: %llu MiB device local\n",
+               (unsigned long long)(deviceLocal >> 20));
+        if (score > 0) {
+            printf("    score:  %lld\n", (long long)score);
+        } else {
+            printf("    score:  unsuitable\n");
+        }
+    }
+
+    free(devices);
+}
+
+void createLogicalDevice(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createLogicalDevice");
+
+    struct QueueFamilyIndices indices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+
+    /* originally here use a set */
+    /* we cannot do it in C */
+    VkDeviceQueueCreateInfo queueCreateInfos[QUEUE_CREATE_INFOS_SIZE] = { 0 };
+
+    /* the reason why the original tutorial use a set here is
+           because the graphicsFamily and the presentFamily may be the
+           same, and using a set eliminate the duplicated one */
+
+    /* use a stupid loop to check whether the newly added value is
+           unique, we have to separate it into another function */
+    int uniqueQueueFamiliesSize = 0;
+    uint32_t uniqueQueueFamilies[QUEUE_CREATE_INFOS_SIZE] = { 0 };
+    add_to_unique_set(uniqueQueueFamilies, &uniqueQueueFamiliesSize,
+                      indices.graphicsFamily);
+    add_to_unique_set(uniqueQueueFamilies, &uniqueQueueFamiliesSize,
+                      indices.presentFamily);
+
+    float queuePriority = 1.0f;
+    for (int i = 0; i < uniqueQueueFamiliesSize; i++) {
+        VkDeviceQueueCreateInfo queueCreateInfo = { 0 };
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = uniqueQueueFamilies[i];
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfos[i] = queueCreateInfo;
+    }
+
+    VkPhysicalDeviceFeatures deviceFeatures = { 0 };
+
+    VkDeviceCreateInfo createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = QUEUE_CREATE_INFOS_SIZE;
+    createInfo.pQueueCreateInfos = queueCreateInfos;
+    createInfo.queueCreateInfoCount = uniqueQueueFamiliesSize;
+    createInfo.pEnabledFeatures = &deviceFeatures;
+    /* the budget falls back to the heap sizes, the trace goes without a
+       gpu track */
+    const char *extensions[DEVICE_EXTENSIONS_COUNT + 6];
+    uint32_t extensionCount = 0;
+    for (int i = 0; i < DEVICE_EXTENSIONS_COUNT; i++) {
+        extensions[extensionCount++] = deviceExtensions[i];
+    }
+    oo->budget.extension = checkDeviceExtension(
+        oo->physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (oo->budget.extension) {
+        extensions[extensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+    oo->trace.calibrated =
+        oo->trace.active && checkCalibratedTimestampSupport(oo);
+    if (oo->trace.calibrated) {
+        extensions[extensionCount++] =
+            VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+    }
+    /* pipeline state that would otherwise be a variant of its own */
+    checkDynamicStateSupport(oo);
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedFeatures = { 0 };
+    extendedFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    extendedFeatures.extendedDynamicState = VK_TRUE;
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT blendFeatures = { 0 };
+    blendFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    blendFeatures.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+    blendFeatures.extendedDynamicState3ColorBlendEquation = VK_TRUE;
+    const void **next = &createInfo.pNext;
+    if (oo->pipelines.dynamic.extended) {
+        extensions[extensionCount++] =
+            VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME;
+        *next = &extendedFeatures;
+        next = (const void **)&extendedFeatures.pNext;
+    }
+    if (oo->pipelines.dynamic.blend) {
+        extensions[extensionCount++] =
+            VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME;
+        *next = &blendFeatures;
+        next = (const void **)&blendFeatures.pNext;
+    }
+    /* --pacing waits for presents to show */
+    checkPresentWaitSupport(oo);
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = { 0 };
+    presentIdFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = { 0 };
+    presentWaitFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    if (oo->latch.presentWait) {
+        extensions[extensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        extensions[extensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        *next = &presentIdFeatures;
+    }
+    createInfo.enabledExtensionCount = extensionCount;
+    createInfo.ppEnabledExtensionNames = extensions;
+
+    if (enableValidationLayers) {
+        createInfo.enabledLayerCount =
+            (uint32_t)(sizeof(validationLayers) / sizeof(char *));
+        createInfo.ppEnabledLayerNames = validationLayers;
+    } else {
+        createInfo.enabledLayerCount = 0;
+    }
+
+    if (vkCreateDevice(oo->physicalDevice, &createInfo,
+                       hostAllocator(oo, ALLOC_DEVICE),
+                       &oo->device) != VK_SUCCESS) {
+        error_log("failed to create logical device!");
+        exit(1);
+    }
+
+    vkGetDeviceQueue(oo->device, indices.graphicsFamily, 0, &oo->graphicsQueue);
+    vkGetDeviceQueue(oo->device, indices.presentFamily, 0, &oo->presentQueue);
+
+    loadDynamicState(oo);
+    loadPresentWait(oo);
+    createMemoryBudget(oo);
+}
+
+void createImage(struct sl_oo *oo, uint32_t width, uint32_t height,
+                 VkSampleCountFlagBits numSamples, VkFormat format,
+                 VkImageTiling tiling, VkImageUsageFlags usage,
+                 VkMemoryPropertyFlags properties, VkImage *image,
+                 VkDeviceMemory *imageMemory) {
+    TRACE_ZONE(oo, "createImage");
+
+    VkImageCreateInfo imageInfo = { 0 };
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = numSamples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(oo->device, &imageInfo, hostAllocator(oo, ALLOC_IMAGES),
+                      image) != VK_SUCCESS) {
+        error_log("failed to create image!");
+        exit(1);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(oo->device, *image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    /* lazily allocated memory only exists on tilers, anywhere else a
+       transient attachment gets ordinary memory */
+    if (!tryFindMemoryType(oo->physicalDevice, memRequirements.memoryTypeBits,
+                           properties, &allocInfo.memoryTypeIndex)) {
+        allocInfo.memoryTypeIndex = findMemoryType(
+            oo->physicalDevice, memRequirements.memoryTypeBits,
+            properties & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    }
+
+    if (allocateDeviceMemory(oo, &allocInfo, imageMemory) != VK_SUCCESS) {
+        error_log("failed to allocate image memory!");
+        exit(1);
+    }
+
+    vkBindImageMemory(oo->device, *image, *imageMemory, 0);
+}
+
+/* stands in for createSwapChain when there is no window */
+static void createHeadlessImages(struct sl_oo *oo, struct sl_target *target,
+                                 uint32_t imageCount) {
+    TRACE_ZONE(oo, "createHeadlessImages");
+
+    if (oo->headlessExtent.width == 0 || oo->headlessExtent.height == 0) {
+        oo->headlessExtent.width = WIDTH;
+        oo->headlessExtent.height = HEIGHT;
+    }
+
+    target->swapChainImagesCount = imageCount;
+    target->swapChainImageFormat = HEADLESS_FORMAT;
+    target->swapChainExtent = oo->headlessExtent;
+    target->swapChainImages =
+        arenaAlloc(&target->swapchainArena, sizeof(VkImage) * imageCount);
+    target->headlessImagesMemory = arenaAlloc(
+        &target->swapchainArena, sizeof(VkDeviceMemory) * imageCount);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        createImage(oo, target->swapChainExtent.width,
+                    target->swapChainExtent.height, VK_SAMPLE_COUNT_1_BIT,
+                    target->swapChainImageFormat,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                        (oo->stream.gpuConvert ? VK_IMAGE_USAGE_SAMPLED_BIT
+                                               : 0) |
+                        postSwapchainUsage(oo, target->swapChainImageFormat,
+                                           VK_IMAGE_USAGE_TRANSFER_DST_BIT),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    &target->swapChainImages[i],
+                    &target->headlessImagesMemory[i]);
+    }
+}
+
+static void createTargetSwapChain(struct sl_oo *oo,
+                                  struct sl_target *target) {
+    if (oo->headless) {
+        createHeadlessImages(oo, target, HEADLESS_IMAGE_COUNT);
+        oo->capture.supported = true;
+        oo->stream.sampledImages = oo->stream.gpuConvert;
+        return;
+    }
+
+    struct SwapChainSupportDetails swapChainSupport =
+        querySwapChainSupport(oo->physicalDevice, target->surface,
+                              &target->swapchainArena);
+
+    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(
+        swapChainSupport.formats, swapChainSupport.formatsSize);
+    /* the render pass and the pipelines are built for the primary's
+       format, any other window has to offer it too */
+    bool primary = target == &oo->targets[0];
+    if (!primary) {
+        VkFormat format = oo->targets[0].swapChainImageFormat;
+        bool found = false;
+        for (int i = 0; i < swapChainSupport.formatsSize; i++) {
+            if (swapChainSupport.formats[i].format == format) {
+                surfaceFormat = swapChainSupport.formats[i];
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            error_log("window %d cannot use the format of the first one!",
+                      (int)(target - oo->targets) + 1);
+            exit(1);
+        }
+
+        /* the device was picked for the first window only */
+        struct QueueFamilyIndices indices =
+            findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+        VkBool32 presentSupport = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(oo->physicalDevice,
+                                             indices.presentFamily,
+                                             target->surface, &presentSupport);
+        if (!presentSupport) {
+            error_log("window %d cannot be presented from the present "
+                      "queue!",
+                      (int)(target - oo->targets) + 1);
+            exit(1);
+        }
+    }
+
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(
+        swapChainSupport.presentModes, swapChainSupport.presentModesSize);
+    VkExtent2D extent =
+        chooseSwapExtent(&swapChainSupport.capabilities, target->window);
+
+    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    if (swapChainSupport.capabilities.maxImageCount > 0 &&
+        imageCount > swapChainSupport.capabilities.maxImageCount) {
+        imageCount = swapChainSupport.capabilities.maxImageCount;
+    }
+
+    VkSwapchainCreateInfoKHR createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface = target->surface;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = surfaceFormat.format;
+    createInfo.imageColorSpace = surfaceFormat.colorSpace;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    /* screenshots and the stream only ever read the primary */
+    if (primary) {
+        /* screenshots copy straight out of the swapchain image */
+        oo->capture.supported =
+            (swapChainSupport.capabilities.supportedUsageFlags &
+             VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        if (oo->capture.supported) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        /* the video stream converts to yuv by sampling the image */
+        oo->stream.sampledImages =
+            oo->stream.gpuConvert &&
+            (swapChainSupport.capabilities.supportedUsageFlags &
+             VK_IMAGE_USAGE_SAMPLED_BIT);
+        if (oo->stream.sampledImages) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+    }
+    /* post-processing blits into every window */
+    createInfo.imageUsage |=
+        postSwapchainUsage(oo, surfaceFormat.format,
+                           swapChainSupport.capabilities.supportedUsageFlags);
+
+    struct QueueFamilyIndices indices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+    uint32_t queueFamilyIndices[] = { indices.graphicsFamily,
+                                      indices.presentFamily };
+
+    if (indices.graphicsFamily != indices.presentFamily) {
+        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = 2;
+        createInfo.pQueueFamilyIndices = queueFamilyIndices;
+    } else {
+        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.queueFamilyIndexCount = 0; // Optional
+        createInfo.pQueueFamilyIndices = NULL; // Optional
+    }
+    createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = presentMode;
+    createInfo.clipped = VK_TRUE;
+    createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+    if (vkCreateSwapchainKHR(oo->device, &createInfo,
+                             hostAllocator(oo, ALLOC_SWAPCHAIN),
+                             &target->swapChain) != VK_SUCCESS) {
+        error_log("failed to create swap chain!");
+        exit(1);
+    }
+
+    vkGetSwapchainImagesKHR(oo->device, target->swapChain, &imageCount, NULL);
+    target->swapChainImages =
+        arenaAlloc(&target->swapchainArena, sizeof(VkImage) * imageCount);
+    vkGetSwapchainImagesKHR(oo->device, target->swapChain, &imageCount,
+                            target->swapChainImages);
+    target->swapChainImagesCount = imageCount;
+
+    target->swapChainImageFormat = surfaceFormat.format;
+    target->swapChainExtent = extent;
+}
+
+void createSwapChain(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createSwapChain");
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        createTargetSwapChain(oo, &oo->targets[i]);
+    }
+}
+
+VkImageView createImageView(struct sl_oo *oo, VkImage image, VkFormat format,
+                            VkImageAspectFlags aspectFlags) {
+    TRACE_ZONE(oo, "createImageView");
+
+    VkImageViewCreateInfo createInfo = { 0 };
+    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    createInfo.image = image;
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = format;
+    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.subresourceRange.aspectMask = aspectFlags;
+    createInfo.subresourceRange.baseMipLevel = 0;
+    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseArrayLayer = 0;
+    createInfo.subresourceRange.layerCount = 1;
+
+    VkImageView imageView;
+    if (vkCreateImageView(oo->device, &createInfo,
+                          hostAllocator(oo, ALLOC_IMAGES),
+                          &imageView) != VK_SUCCESS) {
+        error_log("failed to create image views!");
+        exit(1);
+    }
+    return imageView;
+}
+
+static void createTargetImageViews(struct sl_oo *oo,
+                                   struct sl_target *target) {
+    target->swapChainImageViews =
+        arenaAlloc(&target->swapchainArena,
+                   sizeof(VkImageView) * target->swapChainImagesCount);
+    for (int i = 0; i < target->swapChainImagesCount; i++) {
+        target->swapChainImageViews[i] = createImageView(
+            oo, target->swapChainImages[i], target->swapChainImageFormat,
+            VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+}
+
+void createImageViews(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createImageViews");
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        createTargetImageViews(oo, &oo->targets[i]);
+    }
+}
+
+/* the multisampled target, resolved into the swapchain image at the end of
+   the subpass. it never leaves the tile memory on a tiler, so it is
+   transient and lazily allocated, and nothing is stored */
+static void createTargetColorResources(struct sl_oo *oo,
+                                       struct sl_target *target) {
+    /* the image the multisampled one is resolved into, if it is not the
+       swapchain image */
+    createPostTarget(oo, target);
+    if (oo->msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+        return;
+    }
+
+    /* unless the pass is split, then the samples wait for the late
+       part in memory */
+    bool split = occlusionSplitsPass(oo, target);
+    createImage(oo, target->swapChainExtent.width,
+                target->swapChainExtent.height, oo->msaaSamples,
+                sceneFormat(oo, target), VK_IMAGE_TILING_OPTIMAL,
+                (split ? 0 : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) |
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                    (split ? 0 : VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT),
+                &target->colorImage, &target->colorImageMemory);
+    target->colorImageView =
+        createImageView(oo, target->colorImage, sceneFormat(oo, target),
+                        VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+void createColorResources(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createColorResources");
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        createTargetColorResources(oo, &oo->targets[i]);
+    }
+}
+
+/* only needed during the pass, transient like the msaa target. a split
+   pass samples it for the depth pyramid */
+static void createTargetDepthResources(struct sl_oo *oo,
+                                       struct sl_target *target) {
+    bool split = occlusionSplitsPass(oo, target);
+    createImage(oo, target->swapChainExtent.width,
+                target->swapChainExtent.height, oo->msaaSamples,
+                oo->depthFormat, VK_IMAGE_TILING_OPTIMAL,
+                (split ? VK_IMAGE_USAGE_SAMPLED_BIT
+                       : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) |
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                    (split ? 0 : VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT),
+                &target->depthImage, &target->depthImageMemory);
+    target->depthImageView = createImageView(
+        oo, target->depthImage, oo->depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    createOcclusionTarget(oo, target);
+}
+
+void createDepthResources(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createDepthResources");
+
+    oo->depthFormat = findDepthFormat(oo->physicalDevice);
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        createTargetDepthResources(oo, &oo->targets[i]);
+    }
+}
+
+/* the parts a pass can be cut into, occlusion culling splits the
+   primary target's around its tests */
+enum RenderPassPart {
+    RENDER_PASS_WHOLE,
+    /* clears, and leaves color and depth for the late part */
+    RENDER_PASS_EARLY,
+    /* loads them, and ends like the whole one */
+    RENDER_PASS_LATE,
+};
+
+/* all of them compatible, only the load and store ops and the layouts
+   differ */
+static VkRenderPass buildRenderPass(struct sl_oo *oo,
+                                    enum RenderPassPart part) {
+    bool msaa = oo->msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    VkImageLayout presentLayout = oo->headless
+                                      ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                      : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    /* the compute passes take the scene from here */
+    if (oo->post.active) {
+        presentLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    VkFormat format = sceneFormat(oo, &oo->targets[0]);
+
+    VkAttachmentDescription attachments[3] = { 0 };
+
+    VkAttachmentDescription *colorAttachment = &attachments[0];
+    colorAttachment->format = format;
+    colorAttachment->samples = oo->msaaSamples;
+    colorAttachment->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    /* with msaa only the resolved image is kept */
+    colorAttachment->storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                    : VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment->finalLayout =
+        msaa ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : presentLayout;
+    if (part == RENDER_PASS_EARLY) {
+        colorAttachment->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment->finalLayout =
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    } else if (part == RENDER_PASS_LATE) {
+        colorAttachment->loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment->initialLayout =
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    /* reverse-z, cleared to 0 which is infinitely far away */
+    VkAttachmentDescription *depthAttachment = &attachments[1];
+    depthAttachment->format = findDepthFormat(oo->physicalDevice);
+    depthAttachment->samples = oo->msaaSamples;
+    depthAttachment->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment->finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    /* sampled for the depth pyramid in between */
+    if (part == RENDER_PASS_EARLY) {
+        depthAttachment->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment->finalLayout =
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    } else if (part == RENDER_PASS_LATE) {
+        depthAttachment->loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment->initialLayout =
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+
+    VkAttachmentDescription *colorAttachmentResolve = &attachments[2];
+    colorAttachmentResolve->format = format;
+    colorAttachmentResolve->samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachmentResolve->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachmentResolve->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachmentResolve->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachmentResolve->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachmentResolve->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachmentResolve->finalLayout = presentLayout;
+    /* the early part resolves too, the subpasses have to match, but
+       only the late one's is kept */
+    if (part == RENDER_PASS_EARLY) {
+        colorAttachmentResolve->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachmentResolve->finalLayout =
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkAttachmentReference colorAttachmentRef = { 0 };
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef = { 0 };
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentResolveRef = { 0 };
+    colorAttachmentResolveRef.attachment = 2;
+    colorAttachmentResolveRef.layout =
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = { 0 };
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    /* resolved at the end of the subpass, without a round trip through
+       memory for the samples */
+    subpass.pResolveAttachments = msaa ? &colorAttachmentResolveRef : NULL;
+
+    VkSubpassDependency dependency = { 0 };
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    /* and the scene, which the last frame's post chain and blit read */
+    if (oo->post.active) {
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    /* frames in flight share the depth and multisampled targets, the
+       previous frame has to finish writing them before this one clears */
+    dependency.srcAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        (msaa ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0);
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    /* what the early part drew is loaded, after the tests read its
+       depth */
+    if (part == RENDER_PASS_LATE) {
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask |=
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    }
+
+    /* the depth pyramid is built from the early part's depth */
+    VkSubpassDependency outDependency = { 0 };
+    outDependency.srcSubpass = 0;
+    outDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    outDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    outDependency.srcAccessMask =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    outDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    outDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency dependencies[2] = { dependency, outDependency };
+
+    VkRenderPassCreateInfo renderPassInfo = { 0 };
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = msaa ? 3 : 2;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = part == RENDER_PASS_EARLY ? 2 : 1;
+    renderPassInfo.pDependencies = dependencies;
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(oo->device, &renderPassInfo,
+                           hostAllocator(oo, ALLOC_PIPELINES),
+                           &renderPass) != VK_SUCCESS) {
+        error_log("failed to create render pass!");
+        exit(1);
+    }
+    return renderPass;
+}
+
+void createRenderPass(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createRenderPass");
+
+    oo->renderPass = buildRenderPass(oo, RENDER_PASS_WHOLE);
+    if (oo->occlusion.active) {
+        oo->earlyRenderPass = buildRenderPass(oo, RENDER_PASS_EARLY);
+        oo->lateRenderPass = buildRenderPass(oo, RENDER_PASS_LATE);
+    }
+}
+
+/* one variant, called from the pipeline workers. everything it reads
+   from oo is fixed once the registry exists */
+VkResult buildGraphicsPipeline(struct sl_oo *oo,
+                               const struct sl_pipeline_key *key,
+                               VkShaderModule vertShaderModule,
+                               VkShaderModule fragShaderModule,
+                               VkPipeline *pipeline) {
+    /* every constant goes to both stages, a stage ignores the ones it does
+       not declare */
+    VkSpecializationMapEntry specEntries[PIPELINE_SPEC_COUNT];
+    for (uint32_t i = 0; i < PIPELINE_SPEC_COUNT; i++) {
+        specEntries[i].constantID = i;
+        specEntries[i].offset = sizeof(uint32_t) * i;
+        specEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specInfo = { 0 };
+    specInfo.mapEntryCount = PIPELINE_SPEC_COUNT;
+    specInfo.pMapEntries = specEntries;
+    specInfo.dataSize = sizeof(key->spec);
+    specInfo.pData = key->spec;
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = { 0 };
+    vertShaderStageInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+    vertShaderStageInfo.pSpecializationInfo = &specInfo;
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = { 0 };
+    fragShaderStageInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specInfo;
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo,
+                                                       fragShaderStageInfo };
+
+    /* the instances, then the vertices of the mesh */
+    VkVertexInputBindingDescription bindingDescriptions[2] = { 0 };
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(struct sl_instance);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(struct sl_mesh_vertex);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    /* the mesh is quantized, see meshfile.h, shader.vert decodes it */
+    VkVertexInputAttributeDescription attributeDescriptions[4] = { 0 };
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = 0;
+    attributeDescriptions[1].binding = 1;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[1].offset =
+        offsetof(struct sl_mesh_vertex, position);
+    attributeDescriptions[2].binding = 1;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[2].offset = offsetof(struct sl_mesh_vertex, normal);
+    attributeDescriptions[3].binding = 1;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R16G16_UNORM;
+    attributeDescriptions[3].offset = offsetof(struct sl_mesh_vertex, uv);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = { 0 };
+    vertexInputInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = 4;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { 0 };
+    inputAssembly.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = key->topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState = { 0 };
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = { 0 };
+    rasterizer.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    /* with extended dynamic state the key leaves these at one value
+       each, recordPipelineState sets the real ones */
+    rasterizer.cullMode = key->cullMode;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+    rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+    rasterizer.depthBiasClamp = 0.0f; // Optional
+    rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
+
+    VkPipelineMultisampleStateCreateInfo multisampling = { 0 };
+    multisampling.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = key->samples;
+    multisampling.minSampleShading = 1.0f; // Optional
+    multisampling.pSampleMask = NULL; // Optional
+    multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+    multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { 0 };
+    depthStencil.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    pipelineDepthState(key->depth, &depthStencil.depthWriteEnable,
+                       &depthStencil.depthCompareOp);
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = { 0 };
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkColorBlendEquationEXT equation;
+    pipelineBlendState(key->blend, &colorBlendAttachment.blendEnable,
+                       &equation);
+    colorBlendAttachment.srcColorBlendFactor = equation.srcColorBlendFactor;
+    colorBlendAttachment.dstColorBlendFactor = equation.dstColorBlendFactor;
+    colorBlendAttachment.colorBlendOp = equation.colorBlendOp;
+    colorBlendAttachment.srcAlphaBlendFactor = equation.srcAlphaBlendFactor;
+    colorBlendAttachment.dstAlphaBlendFactor = equation.dstAlphaBlendFactor;
+    colorBlendAttachment.alphaBlendOp = equation.alphaBlendOp;
+    if (key->depth == PIPELINE_DEPTH_ONLY) {
+        colorBlendAttachment.colorWriteMask = 0;
+    }
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = { 0 };
+    colorBlending.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.blendConstants[0] = 0.0f; // Optional
+    colorBlending.blendConstants[1] = 0.0f; // Optional
+    colorBlending.blendConstants[2] = 0.0f; // Optional
+    colorBlending.blendConstants[3] = 0.0f; // Optional
+
+    VkDynamicState dynamicStates[10] = { VK_DYNAMIC_STATE_VIEWPORT,
+                                         VK_DYNAMIC_STATE_SCISSOR };
+    uint32_t dynamicStateCount = 2;
+    const struct sl_dynamic_state *dynamic = &oo->pipelines.dynamic;
+    if (dynamic->extended) {
+        dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+        dynamicStates[dynamicStateCount++] = VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+    }
+    if (dynamic->blend) {
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+        dynamicStates[dynamicStateCount++] =
+            VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+    }
+    VkPipelineDynamicStateCreateInfo dynamicState = { 0 };
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = dynamicStateCount;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = { 0 };
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    /* the pre-pass runs the vertex shader only */
+    pipelineInfo.stageCount = key->depth == PIPELINE_DEPTH_ONLY ? 1 : 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = oo->pipelineLayout;
+    pipelineInfo.renderPass = oo->renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+
+    return vkCreateGraphicsPipelines(oo->device, oo->pipelines.cache, 1,
+                                     &pipelineInfo,
+                                     hostAllocator(oo, ALLOC_PIPELINES),
+                                     pipeline);
+}
+
+void createGraphicsPipeline(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createGraphicsPipeline");
+
+    /* how to decode the mesh's quantized vertices */
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(struct sl_mesh_decode);
+
+    /* and what drawFrame latches right before the submit */
+    createLatch(oo);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &oo->latch.descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &oo->pipelineLayout) != VK_SUCCESS) {
+        error_log("failed to create pipeline layout!");
+        exit(1);
+    }
+
+    createPipelineRegistry(oo);
+    oo->material = pipelineKeyDefault(oo);
+
+    /* every variant the material can switch to compiles in parallel,
+       only the first frame's has to be ready before we go on */
+    for (uint32_t mode = 0; mode < COLOR_MODE_COUNT; mode++) {
+        struct sl_pipeline_key key = oo->material;
+        key.spec[SPEC_COLOR_MODE] = mode;
+        key.depth =
+            oo->depthPrepass ? PIPELINE_DEPTH_EQUAL : PIPELINE_DEPTH_WRITE;
+        requestPipeline(oo, &key);
+    }
+    selectPipelines(oo, true);
+}
+
+static void createTargetFramebuffers(struct sl_oo *oo,
+                                     struct sl_target *target) {
+    target->swapChainFramebuffers =
+        arenaAlloc(&target->swapchainArena,
+                   sizeof(VkFramebuffer) * target->swapChainImagesCount);
+
+    for (int i = 0; i < target->swapChainImagesCount; i++) {
+        /* every framebuffer shares the one depth and multisampled target,
+           and the scene when it is post-processed */
+        VkImageView output = oo->post.active ? target->post.sceneView
+                                             : target->swapChainImageViews[i];
+        VkImageView attachments[3] = { output, target->depthImageView };
+        uint32_t attachmentCount = 2;
+        if (oo->msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            attachments[0] = target->colorImageView;
+            attachments[2] = output;
+            attachmentCount = 3;
+        }
+
+        VkFramebufferCreateInfo framebufferInfo = { 0 };
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = oo->renderPass;
+        framebufferInfo.attachmentCount = attachmentCount;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = target->swapChainExtent.width;
+        framebufferInfo.height = target->swapChainExtent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(oo->device, &framebufferInfo,
+                                hostAllocator(oo, ALLOC_IMAGES),
+                                &target->swapChainFramebuffers[i]) !=
+            VK_SUCCESS) {
+            error_log("failed to create framebuffer!");
+            exit(1);
+        }
+    }
+}
+
+void createFramebuffers(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createFramebuffers");
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        createTargetFramebuffers(oo, &oo->targets[i]);
+    }
+}
+
+void createCommandPool(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createCommandPool");
+
+    struct QueueFamilyIndices queueFamilyIndices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+
+    VkCommandPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    if (vkCreateCommandPool(oo->device, &poolInfo,
+                            hostAllocator(oo, ALLOC_COMMANDS),
+                            &oo->commandPool) != VK_SUCCESS) {
+        error_log("failed to create command pool!");
+        exit(1);
+    }
+}
+
+void createCommandBuffer(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createCommandBuffer");
+
+    oo->commandBuffers = malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = oo->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)MAX_FRAMES_IN_FLIGHT;
+
+    if (vkAllocateCommandBuffers(oo->device, &allocInfo, oo->commandBuffers) !=
+        VK_SUCCESS) {
+        error_log("failed to allocate command buffers!");
+        exit(1);
+    }
+}
+
+void createSyncObjects(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createSyncObjects");
+
+    oo->inFlightFences = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+
+    VkSemaphoreCreateInfo semaphoreInfo = { 0 };
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = { 0 };
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    const VkAllocationCallbacks *allocator = hostAllocator(oo, ALLOC_SYNC);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkCreateFence(oo->device, &fenceInfo, allocator,
+                          &oo->inFlightFences[i]) != VK_SUCCESS) {
+            error_log("failed to create semaphores!");
+            exit(1);
+        }
+    }
+
+    /* a frame's submit waits for an acquire and signals a present on
+       every target, the fence is shared */
+    for (uint32_t t = 0; t < oo->targetCount; t++) {
+        struct sl_target *target = &oo->targets[t];
+        target->imageAvailableSemaphores =
+            malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+        target->renderFinishedSemaphores =
+            malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (vkCreateSemaphore(oo->device, &semaphoreInfo, allocator,
+                                  &target->imageAvailableSemaphores[i]) !=
+                    VK_SUCCESS ||
+                vkCreateSemaphore(oo->device, &semaphoreInfo, allocator,
+                                  &target->renderFinishedSemaphores[i]) !=
+                    VK_SUCCESS) {
+                error_log("failed to create semaphores!");
+                exit(1);
+            }
+        }
+    }
+}
+
+void createBuffer(struct sl_oo *oo, VkDeviceSize size, VkBufferUsageFlags usage,
+                  VkMemoryPropertyFlags properties, VkBuffer *buffer,
+                  VkDeviceMemory *bufferMemory) {
+    TRACE_ZONE(oo, "createBuffer");
+
+    VkBufferCreateInfo bufferInfo = { 0 };
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(oo->device, &bufferInfo,
+                       hostAllocator(oo, ALLOC_BUFFERS),
+                       buffer) != VK_SUCCESS) {
+        error_log("failed to create buffer!");
+        exit(1);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(oo->device, *buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(
+        oo->physicalDevice, memRequirements.memoryTypeBits, properties);
+
+    if (allocateDeviceMemory(oo, &allocInfo, bufferMemory) != VK_SUCCESS) {
+        error_log("failed to allocate buffer memory!");
+        exit(1);
+    }
+
+    vkBindBufferMemory(oo->device, *buffer, *bufferMemory, 0);
+}
+
+/* blocks until the copy is done, only for loading */
+void copyBuffer(struct sl_oo *oo, VkBuffer srcBuffer, VkBuffer dstBuffer,
+                VkDeviceSize size) {
+    VkCommandBufferAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = oo->commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(oo->device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = { 0 };
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    VkBufferCopy copyRegion = { 0 };
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = { 0 };
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    vkQueueSubmit(oo->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(oo->graphicsQueue);
+
+    vkFreeCommandBuffers(oo->device, oo->commandPool, 1, &commandBuffer);
+}
+
+int compareInstanceDepth(const void *a, const void *b) {
+    float x = ((const struct sl_instance *)a)->depth;
+    float y = ((const struct sl_instance *)b)->depth;
+    return (x > y) - (x < y);
+}
+
+void scatterInstances(struct sl_instance *instances, uint32_t count,
+                      uint32_t seed) {
+    instances[0].x = 0.0f;
+    instances[0].y = 0.0f;
+    instances[0].depth = 1.0f;
+    for (uint32_t i = 1; i < count; i++) {
+        float r[3];
+        for (int j = 0; j < 3; j++) {
+            seed = seed * 1664525u + 1013904223u;
+            r[j] = (seed >> 8) / 16777216.0f;
+        }
+        float depth = 1.0f + r[2] * (SCENE_DEPTH - 1.0f);
+        /* x and y are in view space, spread to fill the screen at depth */
+        instances[i].x = (r[0] * 2.0f - 1.0f) * depth;
+        instances[i].y = (r[1] * 2.0f - 1.0f) * depth;
+        instances[i].depth = depth;
+    }
+    qsort(instances, count, sizeof(struct sl_instance), compareInstanceDepth);
+}
+
+/* instanceCount meshes scattered through the view, the first one in
+   front of everything. sorted front to back so
+   early-z rejects whatever is hidden behind what was drawn before. they
+   are kept by the culling, the buffer only gets the visible ones */
+void createInstanceBuffer(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createInstanceBuffer");
+
+    oo->instanceCapacity = oo->instanceCount > 0 ? oo->instanceCount : 1;
+    /* fewer triangles rather than running out of memory, the draw is
+       clamped to the capacity */
+    while (oo->instanceCapacity > 1 &&
+           !memoryFits(oo,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                       sizeof(struct sl_instance) * oo->instanceCapacity *
+                           MAX_FRAMES_IN_FLIGHT)) {
+        oo->instanceCapacity /= 2;
+    }
+    if (oo->instanceCapacity < oo->instanceCount) {
+        error_log("only %u of %u instances fit in the memory budget",
+                  oo->instanceCapacity, oo->instanceCount);
+    }
+    VkDeviceSize bufferSize =
+        sizeof(struct sl_instance) * oo->instanceCapacity;
+    struct sl_instance *instances = malloc(bufferSize);
+
+    /* a fixed seed keeps benchmark runs comparable */
+    scatterInstances(instances, oo->instanceCapacity, 1);
+
+    createCulling(oo, instances, oo->instanceCapacity);
+    free(instances);
+
+    /* rewritten every frame and read once, like the sprites. the
+       occlusion tests read it instead */
+    createBuffer(oo, bufferSize * MAX_FRAMES_IN_FLIGHT,
+                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                     (oo->occlusion.active ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                           : 0),
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &oo->instanceBuffer, &oo->instanceBufferMemory);
+    vkMapMemory(oo->device, oo->instanceBufferMemory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&oo->instances);
+    createOcclusionBuffers(oo);
+}
+
+void createQueryPool(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createQueryPool");
+
+    struct QueueFamilyIndices indices =
+        findQueueFamilies(oo->physicalDevice, oo->targets[0].surface);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(oo->physicalDevice,
+                                             &queueFamilyCount, NULL);
+    VkQueueFamilyProperties *queueFamilies =
+        malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(oo->physicalDevice,
+                                             &queueFamilyCount, queueFamilies);
+    uint32_t validBits =
+        queueFamilies[indices.graphicsFamily].timestampValidBits;
+    free(queueFamilies);
+
+    if (validBits == 0) {
+        error_log("graphics queue has no timestamps, gpu timing disabled");
+        oo->gpuTiming = false;
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+    oo->timestampPeriod = properties.limits.timestampPeriod;
+
+    /* a begin and an end query per frame in flight */
+    VkQueryPoolCreateInfo queryPoolInfo = { 0 };
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+
+    if (vkCreateQueryPool(oo->device, &queryPoolInfo,
+                          hostAllocator(oo, ALLOC_COMMANDS),
+                          &oo->timestampQueryPool) != VK_SUCCESS) {
+        error_log("failed to create query pool!");
+        exit(1);
+    }
+    oo->gpuTiming = true;
+}
+
+void cleanUp(struct sl_oo *oo) {
+    destroyCmdlog(oo);
+    destroyStream(oo);
+    destroyCapture(oo);
+    cleanupSwapChain(oo);
+
+    destroyCulling(oo);
+    vkUnmapMemory(oo->device, oo->instanceBufferMemory);
+    vkDestroyBuffer(oo->device, oo->instanceBuffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, oo->instanceBufferMemory);
+    destroyMesh(oo, &oo->mesh);
+    destroySprites(oo);
+    destroyPostProcess(oo);
+    destroyOcclusion(oo);
+    destroyFrameDescriptors(oo);
+
+    /* owns graphicsPipeline and depthPrepassPipeline */
+    destroyShaderReload(oo);
+    destroyPipelineRegistry(oo);
+    vkDestroyPipelineLayout(oo->device, oo->pipelineLayout,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+    destroyLatch(oo);
+
+    vkDestroyRenderPass(oo->device, oo->renderPass,
+                        hostAllocator(oo, ALLOC_PIPELINES));
+    if (oo->earlyRenderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(oo->device, oo->earlyRenderPass,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyRenderPass(oo->device, oo->lateRenderPass,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+    }
+
+    for (uint32_t t = 0; t < oo->targetCount; t++) {
+        struct sl_target *target = &oo->targets[t];
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroySemaphore(oo->device, target->imageAvailableSemaphores[i],
+                               hostAllocator(oo, ALLOC_SYNC));
+            vkDestroySemaphore(oo->device, target->renderFinishedSemaphores[i],
+                               hostAllocator(oo, ALLOC_SYNC));
+        }
+        free(target->imageAvailableSemaphores);
+        free(target->renderFinishedSemaphores);
+    }
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyFence(oo->device, oo->inFlightFences[i],
+                       hostAllocator(oo, ALLOC_SYNC));
+    }
+    free(oo->inFlightFences);
+
+    vkDestroyCommandPool(oo->device, oo->commandPool,
+                         hostAllocator(oo, ALLOC_COMMANDS));
+    free(oo->commandBuffers);
+
+    if (oo->timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(oo->device, oo->timestampQueryPool,
+                           hostAllocator(oo, ALLOC_COMMANDS));
+    }
+
+    vkDestroyDevice(oo->device, hostAllocator(oo, ALLOC_DEVICE));
+    destroyMemoryBudget(oo);
+
+    if (enableValidationLayers) {
+        DestroyDebugUtilsMessengerEXT(oo->instance, oo->debugMessenger,
+                                      hostAllocator(oo, ALLOC_INSTANCE));
+    }
+
+    /* SDL creates the surface without callbacks */
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        if (oo->targets[i].surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(oo->instance, oo->targets[i].surface, NULL);
+        }
+    }
+    vkDestroyInstance(oo->instance, hostAllocator(oo, ALLOC_INSTANCE));
+
+    if (!oo->headless) {
+        for (uint32_t i = 0; i < oo->targetCount; i++) {
+            SDL_DestroyWindow(oo->targets[i].window);
+        }
+        SDL_Quit();
+    }
+
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        arenaDestroy(&oo->targets[i].swapchainArena);
+    }
+    /* every thread that records zones has been joined by now */
+    destroyTrace(oo);
+    /* with --alloc-stats */
+    reportHostAllocations(oo);
+}
+
+static void cleanupTarget(struct sl_oo *oo, struct sl_target *target) {
+    destroyPostTarget(oo, target);
+    destroyOcclusionTarget(oo, target);
+
+    vkDestroyImageView(oo->device, target->depthImageView,
+                       hostAllocator(oo, ALLOC_IMAGES));
+    vkDestroyImage(oo->device, target->depthImage,
+                   hostAllocator(oo, ALLOC_IMAGES));
+    freeDeviceMemory(oo, target->depthImageMemory);
+
+    if (oo->msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        vkDestroyImageView(oo->device, target->colorImageView,
+                           hostAllocator(oo, ALLOC_IMAGES));
+        vkDestroyImage(oo->device, target->colorImage,
+                       hostAllocator(oo, ALLOC_IMAGES));
+        freeDeviceMemory(oo, target->colorImageMemory);
+    }
+
+    for (size_t i = 0; i < target->swapChainImagesCount; i++) {
+        vkDestroyFramebuffer(oo->device, target->swapChainFramebuffers[i],
+                             hostAllocator(oo, ALLOC_IMAGES));
+    }
+
+    for (size_t i = 0; i < target->swapChainImagesCount; i++) {
+        vkDestroyImageView(oo->device, target->swapChainImageViews[i],
+                           hostAllocator(oo, ALLOC_IMAGES));
+    }
+
+    if (oo->headless) {
+        for (size_t i = 0; i < target->swapChainImagesCount; i++) {
+            vkDestroyImage(oo->device, target->swapChainImages[i],
+                           hostAllocator(oo, ALLOC_IMAGES));
+            freeDeviceMemory(oo, target->headlessImagesMemory[i]);
+        }
+    } else {
+        vkDestroySwapchainKHR(oo->device, target->swapChain,
+                              hostAllocator(oo, ALLOC_SWAPCHAIN));
+    }
+
+    /* every array above, in one go */
+    arenaReset(&target->swapchainArena);
+}
+
+void cleanupSwapChain(struct sl_oo *oo) {
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        cleanupTarget(oo, &oo->targets[i]);
+    }
+}
+
+/* the device must be idle */
+/* a minimized window can have no size, no swapchain can be made for it
+   then */
+static bool targetHasSize(struct sl_oo *oo, struct sl_target *target) {
+    if (oo->headless) {
+        /* the caller already changed headlessExtent */
+        return true;
+    }
+    int width = 0;
+    int height = 0;
+    SDL_Vulkan_GetDrawableSize(target->window, &width, &height);
+    return width > 0 && height > 0;
+}
+
+/* without a size the old swapchain is kept and framebufferResized stays
+   set, the main loop waits for events instead of spinning here */
+static void recreateTarget(struct sl_oo *oo, struct sl_target *target) {
+    if (!targetHasSize(oo, target)) {
+        target->framebufferResized = true;
+        return;
+    }
+
+    cleanupTarget(oo, target);
+
+    createTargetSwapChain(oo, target);
+    createTargetImageViews(oo, target);
+    createTargetColorResources(oo, target);
+    createTargetDepthResources(oo, target);
+    createTargetFramebuffers(oo, target);
+    target->framebufferResized = false;
+    if (target == &oo->targets[0]) {
+        /* the new swapchain has shown no present id yet */
+        oo->latch.presentedSwapChain = VK_NULL_HANDLE;
+        recreateCaptureBuffers(oo);
+        recreateStreamBuffers(oo);
+    }
+}
+
+void recreateSwapChain(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "recreateSwapChain");
+
+    vkDeviceWaitIdle(oo->device);
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        recreateTarget(oo, &oo->targets[i]);
+    }
+}
+
+/* whatever acquire or present found out of date, or was resized */
+void recreateResizedTargets(struct sl_oo *oo) {
+    bool idle = false;
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        struct sl_target *target = &oo->targets[i];
+        if (!target->framebufferResized || !targetHasSize(oo, target)) {
+            continue;
+        }
+        if (!idle) {
+            TRACE_ZONE(oo, "recreateSwapChain");
+            vkDeviceWaitIdle(oo->device);
+            idle = true;
+        }
+        recreateTarget(oo, target);
+    }
+}
+
+void createOffscreenTarget(struct sl_oo *oo, struct sl_target *target) {
+    TRACE_ZONE(oo, "createOffscreenTarget");
+
+    /* nothing cycles through it, one image is enough */
+    createHeadlessImages(oo, target, 1);
+    createTargetImageViews(oo, target);
+    createTargetColorResources(oo, target);
+    createTargetDepthResources(oo, target);
+    createTargetFramebuffers(oo, target);
+}
+
+void destroyOffscreenTarget(struct sl_oo *oo, struct sl_target *target) {
+    cleanupTarget(oo, target);
+    arenaDestroy(&target->swapchainArena);
+}
+
+struct sl_target *findTarget(struct sl_oo *oo, uint32_t windowID) {
+    for (uint32_t i = 0; i < oo->targetCount; i++) {
+        if (oo->targets[i].window != NULL &&
+            SDL_GetWindowID(oo->targets[i].window) == windowID) {
+            return &oo->targets[i];
+        }
+    }
+    return NULL;
+}
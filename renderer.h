@@ -0,0 +1,387 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_wayland.h>
+#include <vulkan/vulkan_metal.h>
+#include <vulkan/vulkan_beta.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_vulkan.h>
+
+#include "capture.h"
+#include "stream.h"
+#include "pipeline.h"
+#include "reload.h"
+#include "alloc.h"
+#include "budget.h"
+#include "trace.h"
+#include "sprite.h"
+#include "mesh.h"
+#include "cull.h"
+#include "post.h"
+#include "descriptor.h"
+#include "cmdlog.h"
+#include "latch.h"
+#include "occlusion.h"
+
+enum ValidationLevel {
+    VALIDATION_OFF,
+    VALIDATION_ERROR,
+    VALIDATION_WARNING,
+    VALIDATION_INFO,
+    VALIDATION_VERBOSE,
+};
+
+/* set by the executable before createInstance */
+extern enum ValidationLevel validationLevel;
+extern bool enableValidationLayers;
+
+void error_log(const char *format, ...);
+void add_to_unique_set(uint32_t *set, int *size, uint32_t value);
+bool parseValidationLevel(const char *s, enum ValidationLevel *level);
+
+bool checkValidationLayerSupport();
+VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    VkDebugUtilsMessageTypeFlagsEXT messageType,
+    const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData, void *pUserData);
+
+VkResult CreateDebugUtilsMessengerEXT(
+    VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator,
+    VkDebugUtilsMessengerEXT *pDebugMessenger);
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance,
+                                   VkDebugUtilsMessengerEXT debugMessenger,
+                                   const VkAllocationCallbacks *pAllocator);
+
+void populateDebugMessengerCreateInfo(
+    VkDebugUtilsMessengerCreateInfoEXT *createInfo);
+bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface);
+int64_t rateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface);
+const char *deviceTypeName(VkPhysicalDeviceType type);
+void getDeviceUUID(VkPhysicalDevice device, uint8_t uuid[VK_UUID_SIZE]);
+bool deviceMatchesSelector(VkPhysicalDevice device, int index,
+                           const char *selector);
+bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+bool checkDeviceExtension(VkPhysicalDevice device, const char *name);
+struct QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device,
+                                            VkSurfaceKHR surface);
+/* whether compute can be recorded into the graphics command buffer */
+bool graphicsQueueSupportsCompute(struct sl_oo *oo);
+
+struct QueueFamilyIndices {
+    /* the vulkan tutorial uses a optional type in C++17 which we
+       don't have in C */
+
+    /* use a bool to indicate whether it has value */
+    uint32_t graphicsFamily;
+    bool graphicsFamilyHasValue;
+
+    uint32_t presentFamily;
+    bool presentFamilyHasValue;
+
+    /* there is a isComplete member function here, we don't have it in
+       C */
+};
+
+bool QueueFamilyIndicesIsComplete(
+    struct QueueFamilyIndices *queueFamiliyIndices);
+
+struct SwapChainSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities;
+    VkSurfaceFormatKHR *formats;
+    int formatsSize;
+    VkPresentModeKHR *presentModes;
+    int presentModesSize;
+};
+
+/* the arrays come from arena, or from malloc and need
+   DestroySwapChainSupportDetails when it is NULL */
+struct SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device,
+                                                     VkSurfaceKHR surface,
+                                                     struct sl_arena *arena);
+void DestroySwapChainSupportDetails(struct SwapChainSupportDetails *details);
+
+VkSurfaceFormatKHR
+chooseSwapSurfaceFormat(const VkSurfaceFormatKHR *availableFormats, int size);
+VkPresentModeKHR
+chooseSwapPresentMode(const VkPresentModeKHR *availablePresentModes, int size);
+VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR *capabilities,
+                            SDL_Window *window);
+
+bool tryFindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+                       VkMemoryPropertyFlags properties, uint32_t *index);
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+                        VkMemoryPropertyFlags properties);
+VkFormat findSupportedFormat(VkPhysicalDevice physicalDevice,
+                             const VkFormat *candidates, int size,
+                             VkImageTiling tiling,
+                             VkFormatFeatureFlags features);
+VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
+VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice physicalDevice,
+                                              uint32_t requested);
+
+/* a whole command line or file field, no sign and at most max */
+bool parseNumber(const char *s, unsigned long max, uint32_t *value);
+/* CLOCK_MONOTONIC in milliseconds, for timing frames and jobs */
+double nowMs(void);
+/* for qsort, ascending */
+int compareDouble(const void *a, const void *b);
+/* p from 0 to 1, sorts values in place */
+double percentile(double *values, uint32_t count, double p);
+
+char *readFile(const char *filename, uint32_t *size);
+VkShaderModule createShaderModule(struct sl_oo *oo, const char *code,
+                                  uint32_t size);
+/* from the SPIR-V at path, the module is gone once it returns */
+VkPipeline createComputePipeline(struct sl_oo *oo, const char *path,
+                                 VkPipelineLayout layout);
+
+/* one copy of the mesh, x and y in view space at depth 1 */
+struct sl_instance {
+    float x;
+    float y;
+    float depth;
+};
+
+/* filled in by drawFrame */
+struct sl_stats {
+    uint64_t frames;
+    /* gpu time of the last frame whose fence signaled, needs gpuTiming */
+    double gpuFrameMs;
+    bool gpuFrameValid;
+    /* device local heaps, from updateMemoryBudget */
+    VkDeviceSize memoryBudget;
+    VkDeviceSize memoryUsage;
+    bool memoryPressure;
+    /* instances that survived culling */
+    uint32_t visibleInstances;
+    /* of those, what was drawn. occlusion culling reads it back, a
+       frame or two late */
+    uint32_t drawnInstances;
+};
+
+/* a window and its swapchain, or the offscreen images when headless.
+   the device, the pipelines, the command buffers and the instances are
+   shared by all of them, a frame records every target into one command
+   buffer and presents them together */
+struct sl_target {
+    SDL_Window *window;
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapChain;
+    VkImage *swapChainImages;
+    uint32_t swapChainImagesCount;
+    VkFormat swapChainImageFormat;
+    VkExtent2D swapChainExtent;
+    VkImageView *swapChainImageViews;
+    VkFramebuffer *swapChainFramebuffers;
+    VkDeviceMemory *headlessImagesMemory;
+
+    /* sized like the swapchain, see createColorResources and
+       createDepthResources */
+    VkImage colorImage;
+    VkDeviceMemory colorImageMemory;
+    VkImageView colorImageView;
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+    /* what the render pass renders into instead of the swapchain image
+       while a post-processing chain is active */
+    struct sl_post_target post;
+    /* the depth pyramid, only for the primary one */
+    struct sl_occlusion_target occlusion;
+
+    /* one of each per frame in flight */
+    VkSemaphore *imageAvailableSemaphores;
+    VkSemaphore *renderFinishedSemaphores;
+    bool framebufferResized;
+    /* minimized or hidden, drawFrame leaves it alone until it is back */
+    bool hidden;
+
+    /* the image of the frame being recorded, a target that could not
+       acquire one sits the frame out */
+    bool acquired;
+    uint32_t imageIndex;
+
+    /* the image, view and framebuffer arrays, reset by cleanupSwapChain */
+    struct sl_arena swapchainArena;
+};
+
+/* imitation of object oriented */
+struct sl_oo {
+    VkInstance instance;
+    VkDebugUtilsMessengerEXT debugMessenger;
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue graphicsQueue;
+    VkQueue presentQueue;
+    /* targets[0] is the primary one, the device is picked for it and
+       screenshots, the stream and the sprites only use it. the others
+       have to take its format, the render pass is shared */
+    struct sl_target targets[MAX_TARGETS];
+    uint32_t targetCount;
+    VkRenderPass renderPass;
+    /* with occlusion culling the primary target's pass is split in two,
+       compatible with renderPass so its framebuffers serve all three */
+    VkRenderPass earlyRenderPass;
+    VkRenderPass lateRenderPass;
+    VkPipelineLayout pipelineLayout;
+    /* the variants selectPipelines picked for this frame, and what they
+       were picked for. the keys carry the state they leave dynamic */
+    VkPipeline graphicsPipeline;
+    struct sl_pipeline_key graphicsKey;
+    VkCommandPool commandPool;
+    VkCommandBuffer *commandBuffers;
+    VkFence *inFlightFences;
+    uint32_t currentFrame;
+
+    /* the requested count until pickPhysicalDevice clamps it, with more
+       than one sample the pass renders into colorImage and resolves */
+    VkSampleCountFlagBits msaaSamples;
+
+    /* reverse-z, 1 at the near plane and 0 infinitely far away */
+    VkFormat depthFormat;
+    /* lay down depth first, then shade only what is visible */
+    bool depthPrepass;
+    VkPipeline depthPrepassPipeline;
+    struct sl_pipeline_key depthPrepassKey;
+
+    /* render into offscreen images instead of a window, there is no
+       surface, no swapchain and no present */
+    bool headless;
+    VkExtent2D headlessExtent;
+
+    /* meshes drawn per frame, 0 only clears. createInstanceBuffer
+       makes room for the count it sees, draws never exceed that */
+    uint32_t instanceCount;
+    uint32_t instanceCapacity;
+    /* persistently mapped, instanceCapacity per frame in flight, what
+       cullInstances let through */
+    VkBuffer instanceBuffer;
+    VkDeviceMemory instanceBufferMemory;
+    struct sl_instance *instances;
+    /* what every instance is drawn as */
+    struct sl_mesh mesh;
+    /* in view space, the instances are moved by minus this */
+    float camera[3];
+    struct sl_cull cull;
+
+    /* timestamps around every command buffer */
+    bool gpuTiming;
+    VkQueryPool timestampQueryPool;
+    float timestampPeriod;
+    struct sl_stats stats;
+
+    /* createCapture is optional, nothing is captured without it */
+    struct sl_capture capture;
+    /* likewise createStream, which does nothing without stream.path */
+    struct sl_stream stream;
+    /* compute passes between the render pass and the present, with
+       post.passes */
+    struct sl_post post;
+    /* descriptor sets recorded into one frame, with createFrameDescriptors */
+    struct sl_descriptors descriptors;
+    /* --record writes what every frame drew, ./replay plays it back */
+    struct sl_cmdlog cmdlog;
+    /* what is written right before the submit, and --pacing */
+    struct sl_latch latch;
+    /* --occlusion, tests what the frustum let through on the gpu */
+    struct sl_occlusion occlusion;
+
+    /* every pipeline variant, and the one the triangles are drawn with.
+       changing material takes effect once its variant is compiled */
+    struct sl_pipelines pipelines;
+    struct sl_pipeline_key material;
+    /* new shader modules for the registry, with createShaderReload */
+    struct sl_reload reload;
+
+    /* host allocation callbacks and their counters */
+    struct sl_allocator alloc;
+    /* device memory against the heap budgets */
+    struct sl_budget budget;
+    /* cpu zones and gpu frames on one timeline, with trace.path */
+    struct sl_trace trace;
+    /* 2d quads drawn over the scene, pushed anew every frame */
+    struct sl_sprites sprites;
+
+    /* command line / environment options */
+    const char *deviceSelector;
+    bool listDevices;
+    const char *screenshotPath;
+    const char *meshPath;
+    /* only draw when something changed, --continuous turns it off */
+    bool onDemand;
+};
+
+void createInstance(struct sl_oo *oo);
+void setupDebugMessenger(struct sl_oo *oo);
+void createSurface(struct sl_oo *oo);
+void pickPhysicalDevice(struct sl_oo *oo);
+void listPhysicalDevices(struct sl_oo *oo);
+void createLogicalDevice(struct sl_oo *oo);
+void createSwapChain(struct sl_oo *oo);
+void createImageViews(struct sl_oo *oo);
+void createColorResources(struct sl_oo *oo);
+void createDepthResources(struct sl_oo *oo);
+void createRenderPass(struct sl_oo *oo);
+void createGraphicsPipeline(struct sl_oo *oo);
+VkResult buildGraphicsPipeline(struct sl_oo *oo,
+                               const struct sl_pipeline_key *key,
+                               VkShaderModule vertShaderModule,
+                               VkShaderModule fragShaderModule,
+                               VkPipeline *pipeline);
+void createFramebuffers(struct sl_oo *oo);
+void createCommandPool(struct sl_oo *oo);
+void createCommandBuffer(struct sl_oo *oo);
+void createSyncObjects(struct sl_oo *oo);
+/* count instances spread through the view from seed, the first one in
+   front of everything, sorted front to back */
+void scatterInstances(struct sl_instance *instances, uint32_t count,
+                      uint32_t seed);
+void createInstanceBuffer(struct sl_oo *oo);
+void createQueryPool(struct sl_oo *oo);
+void createBuffer(struct sl_oo *oo, VkDeviceSize size, VkBufferUsageFlags usage,
+                  VkMemoryPropertyFlags properties, VkBuffer *buffer,
+                  VkDeviceMemory *bufferMemory);
+void copyBuffer(struct sl_oo *oo, VkBuffer srcBuffer, VkBuffer dstBuffer,
+                VkDeviceSize size);
+void createImage(struct sl_oo *oo, uint32_t width, uint32_t height,
+                 VkSampleCountFlagBits numSamples, VkFormat format,
+                 VkImageTiling tiling, VkImageUsageFlags usage,
+                 VkMemoryPropertyFlags properties, VkImage *image,
+                 VkDeviceMemory *imageMemory);
+VkImageView createImageView(struct sl_oo *oo, VkImage image, VkFormat format,
+                            VkImageAspectFlags aspectFlags);
+
+/* every acquired target, one render pass after the other */
+void recordCommandBuffer(struct sl_oo *oo, VkCommandBuffer commandBuffer);
+
+/* every target, after their windows or headlessExtent changed */
+void recreateSwapChain(struct sl_oo *oo);
+/* only the targets flagged framebufferResized, waits for idle first */
+void recreateResizedTargets(struct sl_oo *oo);
+/* the target a window event is for, NULL for a window we do not own */
+struct sl_target *findTarget(struct sl_oo *oo, uint32_t windowID);
+void drawFrame(struct sl_oo *oo);
+
+/* one headless image with its attachments and framebuffer, of
+   headlessExtent and for the shared render pass, for a target outside
+   oo->targets */
+void createOffscreenTarget(struct sl_oo *oo, struct sl_target *target);
+void destroyOffscreenTarget(struct sl_oo *oo, struct sl_target *target);
+
+void cleanupSwapChain(struct sl_oo *oo);
+void cleanUp(struct sl_oo *oo);
+
+#endif /* RENDERER_H */
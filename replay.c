@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "log.h"
+
+/* plays a --record file back offscreen with the current build and
+   prints the time of every frame as json on stdout. the renderer is set
+   up the way the header says, every frame is drawn the way it was
+   recorded, so two builds replaying one file can be compared frame by
+   frame. the file is played --runs times, the first one only warms the
+   pipelines and caches up, every frame reports the fastest of the
+   others. */
+
+struct replay_frame {
+    /* drawFrame, and the resize before it if the recording had one */
+    double cpuMs;
+    /* negative when no timestamp made it back */
+    double gpuMs;
+};
+
+static void keepFastest(double *slot, double ms) {
+    if (*slot < 0.0 || ms < *slot) {
+        *slot = ms;
+    }
+}
+
+/* one pass over the file, frames grows with it on the first one */
+static uint32_t replayRun(struct sl_oo *oo, struct replay_frame **frames,
+                          uint32_t *capacity, bool measure) {
+    rewindCmdlog(oo);
+    uint32_t count = 0;
+    while (readCmdlogFrame(oo)) {
+        if (count == *capacity) {
+            *capacity = *capacity > 0 ? *capacity * 2 : 256;
+            *frames = realloc(*frames,
+                              sizeof(struct replay_frame) * *capacity);
+            for (uint32_t i = count; i < *capacity; i++) {
+                (*frames)[i].cpuMs = -1.0;
+                (*frames)[i].gpuMs = -1.0;
+            }
+        }
+
+        double start = nowMs();
+        VkExtent2D extent = oo->cmdlog.extent;
+        VkExtent2D current = oo->targets[0].swapChainExtent;
+        if (extent.width != current.width ||
+            extent.height != current.height) {
+            oo->headlessExtent = extent;
+            recreateSwapChain(oo);
+        }
+        /* the gpu time drawFrame reports belongs to an older frame */
+        oo->stats.gpuFrameValid = false;
+        drawFrame(oo);
+        double ms = nowMs() - start;
+
+        if (measure) {
+            keepFastest(&(*frames)[count].cpuMs, ms);
+            if (oo->stats.gpuFrameValid && count >= MAX_FRAMES_IN_FLIGHT) {
+                keepFastest(&(*frames)[count - MAX_FRAMES_IN_FLIGHT].gpuMs,
+                            oo->stats.gpuFrameMs);
+            }
+        }
+        count++;
+    }
+    vkDeviceWaitIdle(oo->device);
+    return count;
+}
+
+static void printResults(struct sl_oo *oo, const char *path,
+                         struct replay_frame *frames, uint32_t count,
+                         uint32_t runs) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(oo->physicalDevice, &properties);
+
+    double *cpu = malloc(sizeof(double) * (count > 0 ? count : 1));
+    double *gpu = malloc(sizeof(double) * (count > 0 ? count : 1));
+    uint32_t gpuCount = 0;
+    double gpuTotal = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        cpu[i] = frames[i].cpuMs;
+        if (frames[i].gpuMs >= 0.0) {
+            gpu[gpuCount++] = frames[i].gpuMs;
+            gpuTotal += frames[i].gpuMs;
+        }
+    }
+
+    double p50 = percentile(cpu, count, 0.50);
+    double p90 = percentile(cpu, count, 0.90);
+    double p99 = percentile(cpu, count, 0.99);
+    /* percentile left cpu sorted */
+    double max = count > 0 ? cpu[count - 1] : 0.0;
+    double gpuP50 = percentile(gpu, gpuCount, 0.50);
+    double gpuP99 = percentile(gpu, gpuCount, 0.99);
+
+    printf("{\n");
+    /* paths and device names are printed as they are, neither has
+       quotes in practice */
+    printf("  \"file\": \"%s\",\n", path);
+    printf("  \"device\": \"%s\",\n", properties.deviceName);
+    printf("  \"driver_version\": %u,\n", properties.driverVersion);
+    printf("  \"frames\": %u,\n", count);
+    printf("  \"runs\": %u,\n", runs);
+    printf("  \"gpu_timing\": %s,\n", oo->gpuTiming ? "true" : "false");
+    printf("  \"frame_ms\": { \"p50\": %.4f, \"p90\": %.4f, "
+           "\"p99\": %.4f, \"max\": %.4f },\n",
+           p50, p90, p99, max);
+    printf("  \"gpu_ms\": { \"mean\": %.4f, \"p50\": %.4f, "
+           "\"p99\": %.4f, \"samples\": %u },\n",
+           gpuCount > 0 ? gpuTotal / gpuCount : 0.0, gpuP50, gpuP99,
+           gpuCount);
+    printf("  \"per_frame\": [\n");
+    for (uint32_t i = 0; i < count; i++) {
+        printf("    { \"cpu_ms\": %.4f, ", frames[i].cpuMs);
+        if (frames[i].gpuMs >= 0.0) {
+            printf("\"gpu_ms\": %.4f }", frames[i].gpuMs);
+        } else {
+            printf("\"gpu_ms\": null }");
+        }
+        printf("%s\n", i + 1 < count ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+
+    free(cpu);
+    free(gpu);
+}
+
+static void usage(const char *name) {
+    error_log("usage: %s [--runs N] [--device index|name|uuid] "
+              "[--trace file.json] "
+              "[--validation=off|error|warning|info|verbose] file.slc",
+              name);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    uint32_t runs = REPLAY_RUNS;
+
+    struct sl_oo oo = { 0 };
+    oo.headless = true;
+    oo.targetCount = 1;
+    oo.deviceSelector = getenv(DEVICE_ENV);
+    oo.alloc.enabled = HOST_ALLOCATOR;
+
+    /* validation skews every number, only enable it on request */
+    validationLevel = VALIDATION_OFF;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            oo.deviceSelector = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            oo.trace.path = argv[++i];
+        } else if (strncmp(argv[i], "--validation=", 13) == 0) {
+            if (!parseValidationLevel(argv[i] + 13, &validationLevel)) {
+                usage(argv[0]);
+            }
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (path == NULL || runs == 0) {
+        usage(argv[0]);
+    }
+
+    enableValidationLayers = validationLevel != VALIDATION_OFF;
+    if (enableValidationLayers) {
+        log_init();
+    }
+
+    /* everything the recording was made with, before it is created */
+    openCmdlog(&oo, path);
+    struct sl_cmdlog_header *header = &oo.cmdlog.header;
+    oo.headlessExtent.width = header->width;
+    oo.headlessExtent.height = header->height;
+    oo.msaaSamples = header->msaaSamples;
+    oo.depthPrepass = header->depthPrepass != 0;
+    oo.pipelines.dynamic.enabled = header->dynamicState != 0;
+    oo.occlusion.enabled = header->occlusion != 0;
+    oo.instanceCount = header->instanceCapacity;
+    oo.meshPath = header->meshPath[0] != '\0' ? header->meshPath : NULL;
+    oo.post.passCount = header->postPassCount;
+    for (uint32_t i = 0; i < header->postPassCount; i++) {
+        oo.post.passes[i] = (enum PostPass)header->postPasses[i];
+    }
+
+    createTrace(&oo);
+    createHostAllocator(&oo);
+    createInstance(&oo);
+    setupDebugMessenger(&oo);
+    pickPhysicalDevice(&oo);
+    createLogicalDevice(&oo);
+    createPostProcess(&oo);
+    /* before the depth buffer and the render pass, which it splits */
+    createOcclusion(&oo);
+    createSwapChain(&oo);
+    createImageViews(&oo);
+    createColorResources(&oo);
+    createDepthResources(&oo);
+    createRenderPass(&oo);
+    createGraphicsPipeline(&oo);
+    createFramebuffers(&oo);
+    createCommandPool(&oo);
+    createCommandBuffer(&oo);
+    createFrameDescriptors(&oo);
+    createMesh(&oo);
+    createInstanceBuffer(&oo);
+    createSyncObjects(&oo);
+    createQueryPool(&oo);
+    createSprites(&oo);
+
+    struct replay_frame *frames = NULL;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    for (uint32_t run = 0; run < runs; run++) {
+        /* with a single run there is nothing to warm up for */
+        bool measure = run > 0 || runs == 1;
+        fprintf(stderr, "%s run %u of %u\n", measure ? "measured" : "warm up",
+                run + 1, runs);
+        count = replayRun(&oo, &frames, &capacity, measure);
+    }
+    if (count == 0) {
+        error_log("%s has no frames", path);
+        exit(1);
+    }
+    if (header->frameCount != 0 && header->frameCount != count) {
+        error_log("%s says %u frames, played %u", path, header->frameCount,
+                  count);
+    }
+
+    printResults(&oo, path, frames, count, runs);
+    free(frames);
+
+    vkDeviceWaitIdle(oo.device);
+    cleanUp(&oo);
+    return 0;
+}
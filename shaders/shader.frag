@@ -4,6 +4,17 @@ layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
+// specialization constants, see enum PipelineSpec and enum ColorMode
+layout(constant_id = 1) const uint colorMode = 0;
+layout(constant_id = 2) const float alpha = 1.0;
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (colorMode == 1u) {
+        // reverse-z depth is near / view depth, 1 at the near plane
+        color *= clamp(gl_FragCoord.z * 10.0, 0.0, 1.0);
+    } else if (colorMode == 2u) {
+        color = vec3(1.0);
+    }
+    outColor = vec4(color, alpha);
 }
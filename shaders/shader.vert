@@ -1,20 +1,54 @@
 #version 450
 
+// x and y in view space at depth 1, then the view depth
+layout(location = 0) in vec3 instance;
+// the mesh, quantized, see meshfile.h
+layout(location = 1) in vec4 position;
+layout(location = 2) in vec2 normal;
+layout(location = 3) in vec2 uv;
+
 layout(location = 0) out vec3 fragColor;
+// for textured materials
+layout(location = 1) out vec2 fragUV;
+
+// the depth pre-pass and the shading pass must agree on every depth
+invariant gl_Position;
+
+// reverse-z with an infinite far plane: clip z is the near plane and w the
+// view depth, so depth = near / w goes from 1 at near to 0 at infinity
+const float near = 0.1;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// specialization constants, see enum PipelineSpec
+layout(constant_id = 0) const float triangleScale = 1.0;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// the ranges the converter quantized into, struct sl_mesh_decode
+layout(push_constant) uniform Mesh {
+    vec4 positionMin;
+    vec4 positionExtent;
+    vec2 uvMin;
+    vec2 uvExtent;
+} mesh;
+
+// written right before the submit, struct sl_latch_data
+layout(set = 0, binding = 0) uniform Latch {
+    // how far the camera moved since the instances were culled
+    vec4 camera;
+} latch;
+
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // the lower half is folded over the diagonals
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    vec3 local = mesh.positionMin.xyz + position.xyz * mesh.positionExtent.xyz;
+    vec3 view = local * triangleScale + vec3(instance.xy, instance.z) -
+                latch.camera.xyz;
+    gl_Position = vec4(view.xy, near, view.z);
+    // the built in triangle's normals are its red, green and blue corners
+    fragColor = abs(octahedralDecode(normal));
+    fragUV = mesh.uvMin + uv * mesh.uvExtent;
 }
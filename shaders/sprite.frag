@@ -0,0 +1,13 @@
+#version 450
+
+// coverage only, the color comes with the quad
+layout(binding = 0) uniform sampler2D atlas;
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor.rgb, fragColor.a * texture(atlas, fragUV).r);
+}
@@ -0,0 +1,24 @@
+#version 450
+
+// one instance per quad, x y width height in pixels from the top left
+layout(location = 0) in vec4 rect;
+// u0 v0 u1 v1
+layout(location = 1) in vec4 uvRect;
+layout(location = 2) in vec4 color;
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec4 fragColor;
+
+// 2 / the framebuffer size
+layout(push_constant) uniform Push {
+    vec2 scale;
+} push;
+
+void main() {
+    // a triangle strip, 0 1 2 3 are the corners in z order
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 position = rect.xy + corner * rect.zw;
+    gl_Position = vec4(position * push.scale - 1.0, 0.0, 1.0);
+    fragUV = mix(uvRect.xy, uvRect.zw, corner);
+    fragColor = color;
+}
@@ -0,0 +1,560 @@
+#include "renderer.h"
+#include "sprite.h"
+
+#include <math.h>
+
+#define ATLAS_WIDTH (SPRITE_ATLAS_CELL * SPRITE_SHAPE_COUNT)
+#define ATLAS_HEIGHT SPRITE_ATLAS_CELL
+
+/* bytes of one quad in the streaming buffer: rect, uv rect and color */
+#define SPRITE_RECT_SIZE (sizeof(float) * 4)
+#define SPRITE_UV_SIZE (sizeof(float) * 4)
+#define SPRITE_COLOR_SIZE sizeof(uint32_t)
+
+/* a square that fills its cell and a disc with a one texel soft edge */
+static void fillAtlas(uint8_t *pixels) {
+    const float radius = SPRITE_ATLAS_CELL / 2.0f - 1.0f;
+    for (uint32_t y = 0; y < ATLAS_HEIGHT; y++) {
+        for (uint32_t x = 0; x < SPRITE_ATLAS_CELL; x++) {
+            pixels[y * ATLAS_WIDTH + x] = 255;
+
+            float dx = x + 0.5f - SPRITE_ATLAS_CELL / 2.0f;
+            float dy = y + 0.5f - SPRITE_ATLAS_CELL / 2.0f;
+            float coverage = radius + 0.5f - sqrtf(dx * dx + dy * dy);
+            coverage = coverage < 0.0f ? 0.0f : coverage > 1.0f ? 1.0f
+                                                                : coverage;
+            pixels[y * ATLAS_WIDTH + SPRITE_ATLAS_CELL + x] =
+                (uint8_t)(coverage * 255.0f + 0.5f);
+        }
+    }
+}
+
+static void createAtlas(struct sl_oo *oo) {
+    struct sl_sprites *sprites = &oo->sprites;
+    VkDeviceSize size = ATLAS_WIDTH * ATLAS_HEIGHT;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(oo, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &stagingBuffer, &stagingBufferMemory);
+
+    void *data;
+    vkMapMemory(oo->device, stagingBufferMemory, 0, size, 0, &data);
+    fillAtlas(data);
+    vkUnmapMemory(oo->device, stagingBufferMemory);
+
+    createImage(oo, ATLAS_WIDTH, ATLAS_HEIGHT, VK_SAMPLE_COUNT_1_BIT,
+                VK_FORMAT_R8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &sprites->atlas,
+                &sprites->atlasMemory);
+
+    /* blocks like copyBuffer, only done once at startup */
+    VkCommandBufferAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = oo->commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(oo->device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = { 0 };
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier = { 0 };
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = sprites->atlas;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &barrier);
+
+    VkBufferImageCopy region = { 0 };
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = ATLAS_WIDTH;
+    region.imageExtent.height = ATLAS_HEIGHT;
+    region.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, sprites->atlas,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = { 0 };
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    vkQueueSubmit(oo->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(oo->graphicsQueue);
+
+    vkFreeCommandBuffers(oo->device, oo->commandPool, 1, &commandBuffer);
+    vkDestroyBuffer(oo->device, stagingBuffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, stagingBufferMemory);
+
+    sprites->atlasView = createImageView(oo, sprites->atlas,
+                                         VK_FORMAT_R8_UNORM,
+                                         VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+static void createSpriteDescriptors(struct sl_oo *oo) {
+    struct sl_sprites *sprites = &oo->sprites;
+
+    VkSamplerCreateInfo samplerInfo = { 0 };
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(oo->device, &samplerInfo,
+                        hostAllocator(oo, ALLOC_DESCRIPTORS),
+                        &sprites->sampler) != VK_SUCCESS) {
+        error_log("failed to create sprite sampler!");
+        exit(1);
+    }
+
+    VkDescriptorSetLayoutBinding binding = { 0 };
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &sprites->descriptorSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create sprite descriptor set layout!");
+        exit(1);
+    }
+
+    /* the atlas never changes, one set for every frame */
+    VkDescriptorPoolSize poolSize = { 0 };
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &sprites->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create sprite descriptor pool!");
+        exit(1);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = sprites->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &sprites->descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(oo->device, &allocInfo,
+                                 &sprites->descriptorSet) != VK_SUCCESS) {
+        error_log("failed to allocate sprite descriptor set!");
+        exit(1);
+    }
+
+    VkDescriptorImageInfo imageInfo = { 0 };
+    imageInfo.sampler = sprites->sampler;
+    imageInfo.imageView = sprites->atlasView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = { 0 };
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = sprites->descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(oo->device, 1, &write, 0, NULL);
+
+    /* 2 / the framebuffer size, the shader works in pixels */
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(float) * 2;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &sprites->descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &sprites->pipelineLayout) != VK_SUCCESS) {
+        error_log("failed to create sprite pipeline layout!");
+        exit(1);
+    }
+}
+
+static void createSpritePipeline(struct sl_oo *oo, enum SpriteBlend blend,
+                                 VkShaderModule vertShaderModule,
+                                 VkShaderModule fragShaderModule) {
+    struct sl_sprites *sprites = &oo->sprites;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = { 0 };
+    shaderStages[0].sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    /* one stream per attribute, all of them per instance */
+    VkVertexInputBindingDescription bindingDescriptions[3] = { 0 };
+    VkVertexInputAttributeDescription attributeDescriptions[3] = { 0 };
+    const uint32_t strides[3] = { SPRITE_RECT_SIZE, SPRITE_UV_SIZE,
+                                  SPRITE_COLOR_SIZE };
+    const VkFormat formats[3] = { VK_FORMAT_R32G32B32A32_SFLOAT,
+                                  VK_FORMAT_R32G32B32A32_SFLOAT,
+                                  VK_FORMAT_R8G8B8A8_UNORM };
+    for (uint32_t i = 0; i < 3; i++) {
+        bindingDescriptions[i].binding = i;
+        bindingDescriptions[i].stride = strides[i];
+        bindingDescriptions[i].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        attributeDescriptions[i].binding = i;
+        attributeDescriptions[i].location = i;
+        attributeDescriptions[i].format = formats[i];
+        attributeDescriptions[i].offset = 0;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = { 0 };
+    vertexInputInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 3;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    /* four vertices per instance, the corners come from gl_VertexIndex */
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = { 0 };
+    inputAssembly.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState = { 0 };
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = { 0 };
+    rasterizer.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = { 0 };
+    multisampling.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = oo->msaaSamples;
+    multisampling.minSampleShading = 1.0f;
+
+    /* over everything, the depth buffer is neither read nor written */
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { 0 };
+    depthStencil.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_FALSE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = { 0 };
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = blend != SPRITE_BLEND_OPAQUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor =
+        blend == SPRITE_BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE
+                                       : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = { 0 };
+    colorBlending.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT,
+                                       VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState = { 0 };
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = { 0 };
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = sprites->pipelineLayout;
+    pipelineInfo.renderPass = oo->renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(oo->device, oo->pipelines.cache, 1,
+                                  &pipelineInfo,
+                                  hostAllocator(oo, ALLOC_PIPELINES),
+                                  &sprites->pipelines[blend]) != VK_SUCCESS) {
+        error_log("failed to create sprite pipeline!");
+        exit(1);
+    }
+}
+
+void createSprites(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createSprites");
+
+    struct sl_sprites *sprites = &oo->sprites;
+
+    sprites->keys = malloc(sizeof(uint32_t) * SPRITE_MAX_SPRITES);
+    sprites->rects = malloc(SPRITE_RECT_SIZE * SPRITE_MAX_SPRITES);
+    sprites->uvs = malloc(SPRITE_UV_SIZE * SPRITE_MAX_SPRITES);
+    sprites->colors = malloc(SPRITE_COLOR_SIZE * SPRITE_MAX_SPRITES);
+    sprites->order = malloc(sizeof(uint32_t) * SPRITE_MAX_SPRITES);
+
+    createAtlas(oo);
+    createSpriteDescriptors(oo);
+
+    uint32_t vertShaderSize = 0;
+    char *vertShaderCode = readFile("shaders/sprite_vert.spv", &vertShaderSize);
+    uint32_t fragShaderSize = 0;
+    char *fragShaderCode = readFile("shaders/sprite_frag.spv", &fragShaderSize);
+    VkShaderModule vertShaderModule =
+        createShaderModule(oo, vertShaderCode, vertShaderSize);
+    VkShaderModule fragShaderModule =
+        createShaderModule(oo, fragShaderCode, fragShaderSize);
+
+    for (int blend = 0; blend < SPRITE_BLEND_COUNT; blend++) {
+        createSpritePipeline(oo, (enum SpriteBlend)blend, vertShaderModule,
+                             fragShaderModule);
+    }
+
+    vkDestroyShaderModule(oo->device, vertShaderModule,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroyShaderModule(oo->device, fragShaderModule,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    free(vertShaderCode);
+    free(fragShaderCode);
+
+    /* written by the cpu once per frame and read once by the gpu, not
+       worth a copy into device local memory */
+    sprites->frameSize =
+        (SPRITE_RECT_SIZE + SPRITE_UV_SIZE + SPRITE_COLOR_SIZE) *
+        SPRITE_MAX_SPRITES;
+    createBuffer(oo, sprites->frameSize * MAX_FRAMES_IN_FLIGHT,
+                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &sprites->buffer, &sprites->memory);
+    vkMapMemory(oo->device, sprites->memory, 0, VK_WHOLE_SIZE, 0,
+                (void **)&sprites->mapped);
+
+    sprites->active = true;
+}
+
+void destroySprites(struct sl_oo *oo) {
+    struct sl_sprites *sprites = &oo->sprites;
+    if (!sprites->active) {
+        return;
+    }
+
+    vkUnmapMemory(oo->device, sprites->memory);
+    vkDestroyBuffer(oo->device, sprites->buffer,
+                    hostAllocator(oo, ALLOC_BUFFERS));
+    freeDeviceMemory(oo, sprites->memory);
+
+    for (int blend = 0; blend < SPRITE_BLEND_COUNT; blend++) {
+        vkDestroyPipeline(oo->device, sprites->pipelines[blend],
+                          hostAllocator(oo, ALLOC_PIPELINES));
+    }
+    vkDestroyPipelineLayout(oo->device, sprites->pipelineLayout,
+                            hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroyDescriptorPool(oo->device, sprites->descriptorPool,
+                            hostAllocator(oo, ALLOC_DESCRIPTORS));
+    vkDestroyDescriptorSetLayout(oo->device, sprites->descriptorSetLayout,
+                                 hostAllocator(oo, ALLOC_PIPELINES));
+    vkDestroySampler(oo->device, sprites->sampler,
+                     hostAllocator(oo, ALLOC_DESCRIPTORS));
+    vkDestroyImageView(oo->device, sprites->atlasView,
+                       hostAllocator(oo, ALLOC_IMAGES));
+    vkDestroyImage(oo->device, sprites->atlas,
+                   hostAllocator(oo, ALLOC_IMAGES));
+    freeDeviceMemory(oo, sprites->atlasMemory);
+
+    free(sprites->keys);
+    free(sprites->rects);
+    free(sprites->uvs);
+    free(sprites->colors);
+    free(sprites->order);
+    sprites->active = false;
+}
+
+void spriteShapeUV(enum SpriteShape shape, float uv[4]) {
+    /* half a texel in, so filtering never reaches into the next cell */
+    uv[0] = (shape * SPRITE_ATLAS_CELL + 0.5f) / ATLAS_WIDTH;
+    uv[1] = 0.5f / ATLAS_HEIGHT;
+    uv[2] = ((shape + 1) * SPRITE_ATLAS_CELL - 0.5f) / ATLAS_WIDTH;
+    uv[3] = (ATLAS_HEIGHT - 0.5f) / ATLAS_HEIGHT;
+}
+
+void clearSprites(struct sl_oo *oo) {
+    oo->sprites.count = 0;
+}
+
+void pushSprite(struct sl_oo *oo, uint32_t key, const float rect[4],
+                const float uv[4], uint32_t color) {
+    struct sl_sprites *sprites = &oo->sprites;
+    if (!sprites->active) {
+        return;
+    }
+    if (sprites->count == SPRITE_MAX_SPRITES || key >= SPRITE_KEY_COUNT) {
+        sprites->dropped++;
+        return;
+    }
+
+    uint32_t i = sprites->count++;
+    sprites->keys[i] = key;
+    memcpy(&sprites->rects[i * 4], rect, SPRITE_RECT_SIZE);
+    memcpy(&sprites->uvs[i * 4], uv, SPRITE_UV_SIZE);
+    sprites->colors[i] = color;
+}
+
+void recordSprites(struct sl_oo *oo, VkCommandBuffer commandBuffer) {
+    TRACE_ZONE(oo, "recordSprites");
+
+    struct sl_sprites *sprites = &oo->sprites;
+    sprites->drawn = 0;
+    sprites->draws = 0;
+    if (!sprites->active || sprites->count == 0) {
+        return;
+    }
+    uint32_t count = sprites->count;
+
+    /* counting sort, stable, so quads with the same key stay in the order
+       they were pushed in */
+    uint32_t first[SPRITE_KEY_COUNT + 1] = { 0 };
+    for (uint32_t i = 0; i < count; i++) {
+        first[sprites->keys[i] + 1]++;
+    }
+    for (uint32_t key = 0; key < SPRITE_KEY_COUNT; key++) {
+        first[key + 1] += first[key];
+    }
+    uint32_t next[SPRITE_KEY_COUNT];
+    memcpy(next, first, sizeof(next));
+    for (uint32_t i = 0; i < count; i++) {
+        sprites->order[next[sprites->keys[i]]++] = i;
+    }
+
+    /* the mapped memory is usually write combined, so it is written front
+       to back and only the cached side is read out of order */
+    VkDeviceSize frameOffset = sprites->frameSize * oo->currentFrame;
+    uint8_t *base = sprites->mapped + frameOffset;
+    float *rects = (float *)base;
+    float *uvs = (float *)(base + SPRITE_RECT_SIZE * SPRITE_MAX_SPRITES);
+    uint32_t *colors = (uint32_t *)(base + (SPRITE_RECT_SIZE +
+                                            SPRITE_UV_SIZE) *
+                                               SPRITE_MAX_SPRITES);
+    for (uint32_t at = 0; at < count; at++) {
+        uint32_t i = sprites->order[at];
+        memcpy(&rects[at * 4], &sprites->rects[i * 4], SPRITE_RECT_SIZE);
+        memcpy(&uvs[at * 4], &sprites->uvs[i * 4], SPRITE_UV_SIZE);
+        colors[at] = sprites->colors[i];
+    }
+
+    VkBuffer buffers[3] = { sprites->buffer, sprites->buffer,
+                            sprites->buffer };
+    VkDeviceSize offsets[3] = {
+        frameOffset,
+        frameOffset + SPRITE_RECT_SIZE * SPRITE_MAX_SPRITES,
+        frameOffset + (SPRITE_RECT_SIZE + SPRITE_UV_SIZE) * SPRITE_MAX_SPRITES,
+    };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 3, buffers, offsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            sprites->pipelineLayout, 0, 1,
+                            &sprites->descriptorSet, 0, NULL);
+    float scale[2] = { 2.0f / oo->targets[0].swapChainExtent.width,
+                       2.0f / oo->targets[0].swapChainExtent.height };
+    vkCmdPushConstants(commandBuffer, sprites->pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(scale), scale);
+
+    /* neighbouring keys with the same pipeline are contiguous in the
+       buffer and already in the right order, so they share a draw */
+    int bound = -1;
+    uint32_t runStart = 0;
+    uint32_t runEnd = 0;
+    for (uint32_t key = 0; key <= SPRITE_KEY_COUNT; key++) {
+        bool last = key == SPRITE_KEY_COUNT;
+        if (!last && first[key] == first[key + 1]) {
+            continue;
+        }
+        int blend = last ? -1 : (int)(key % SPRITE_BLEND_COUNT);
+        if (blend == bound) {
+            runEnd = first[key + 1];
+            continue;
+        }
+        if (runEnd > runStart) {
+            vkCmdDraw(commandBuffer, 4, runEnd - runStart, 0, runStart);
+            sprites->draws++;
+        }
+        if (last) {
+            break;
+        }
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          sprites->pipelines[blend]);
+        bound = blend;
+        runStart = first[key];
+        runEnd = first[key + 1];
+    }
+
+    sprites->drawn = count;
+}
@@ -0,0 +1,96 @@
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* 2d quads over the scene, in as few draws as possible. pushSprite
+   appends to one array per attribute, recordSprites sorts them by key
+   with a counting sort, copies them in that order into the frame's
+   persistently mapped buffer and issues one instanced draw per run of
+   quads that share a pipeline. the quads stay until clearSprites, so a
+   frame that is skipped or recorded twice draws the same thing. */
+
+struct sl_oo;
+
+enum SpriteBlend {
+    SPRITE_BLEND_OPAQUE,
+    SPRITE_BLEND_ALPHA,
+    SPRITE_BLEND_ADDITIVE,
+    SPRITE_BLEND_COUNT,
+};
+
+/* cells of the built in atlas, which only holds coverage */
+enum SpriteShape {
+    SPRITE_SHAPE_SQUARE,
+    SPRITE_SHAPE_DISC,
+    SPRITE_SHAPE_COUNT,
+};
+
+/* draws are ordered by layer, then by pipeline. within a key quads keep
+   the order they were pushed in */
+#define SPRITE_KEY(layer, blend) ((layer) * SPRITE_BLEND_COUNT + (blend))
+#define SPRITE_KEY_COUNT (SPRITE_LAYERS * SPRITE_BLEND_COUNT)
+
+/* what R8G8B8A8_UNORM reads back as r, g, b, a */
+#define SPRITE_RGBA(r, g, b, a)                                              \
+    ((uint32_t)(r) | (uint32_t)(g) << 8 | (uint32_t)(b) << 16 |              \
+     (uint32_t)(a) << 24)
+
+struct sl_sprites {
+    bool active;
+
+    /* this frame's quads, one array per attribute so the sort only
+       touches the keys */
+    uint32_t count;
+    uint32_t *keys;
+    /* x y width height, in pixels from the top left corner */
+    float *rects;
+    /* u0 v0 u1 v1 */
+    float *uvs;
+    uint32_t *colors;
+    /* scratch for the sort, indices in draw order */
+    uint32_t *order;
+    /* pushed past SPRITE_MAX_SPRITES */
+    uint32_t dropped;
+
+    /* a region per frame in flight, each one the three attribute arrays
+       back to back */
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint8_t *mapped;
+    VkDeviceSize frameSize;
+
+    VkImage atlas;
+    VkDeviceMemory atlasMemory;
+    VkImageView atlasView;
+    VkSampler sampler;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipelines[SPRITE_BLEND_COUNT];
+
+    /* of the last recorded frame */
+    uint32_t drawn;
+    uint32_t draws;
+};
+
+/* after createCommandPool, the atlas is uploaded with it */
+void createSprites(struct sl_oo *oo);
+void destroySprites(struct sl_oo *oo);
+
+/* the uv rectangle of a cell of the atlas */
+void spriteShapeUV(enum SpriteShape shape, float uv[4]);
+/* before pushing the next frame's quads */
+void clearSprites(struct sl_oo *oo);
+void pushSprite(struct sl_oo *oo, uint32_t key, const float rect[4],
+                const float uv[4], uint32_t color);
+
+/* inside the render pass, from recordCommandBuffer */
+void recordSprites(struct sl_oo *oo, VkCommandBuffer commandBuffer);
+
+#endif /* SPRITE_H */
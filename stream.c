@@ -0,0 +1,684 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+static size_t yuvFrameSize(VkExtent2D extent) {
+    size_t chroma =
+        (size_t)((extent.width + 1) / 2) * ((extent.height + 1) / 2);
+    return (size_t)extent.width * extent.height + chroma * 2;
+}
+
+static uint8_t clampByte(int v) {
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+/****** writer thread */
+
+/* writev until everything is out, a pipe takes a few pages at a time */
+static bool writeAll(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/* bt.601 full range in 8 bit fixed point, the same as rgb2yuv.comp */
+static void convertToYUV(const uint8_t *src, uint8_t *dst, uint32_t width,
+                         uint32_t height, bool bgra) {
+    int r = bgra ? 2 : 0;
+    int b = 2 - r;
+    uint32_t chromaWidth = (width + 1) / 2;
+    uint32_t chromaHeight = (height + 1) / 2;
+    uint8_t *yPlane = dst;
+    uint8_t *uPlane = yPlane + (size_t)width * height;
+    uint8_t *vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        const uint8_t *p = src + i * 4;
+        yPlane[i] = (77 * p[r] + 150 * p[1] + 29 * p[b] + 128) >> 8;
+    }
+
+    for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+        for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+            /* sum of a 2x2 block, odd edges repeat the last pixel */
+            int sr = 0;
+            int sg = 0;
+            int sb = 0;
+            for (int i = 0; i < 4; i++) {
+                uint32_t x = cx * 2 + (i & 1);
+                uint32_t y = cy * 2 + (i >> 1);
+                x = x < width ? x : width - 1;
+                y = y < height ? y : height - 1;
+                const uint8_t *p = src + ((size_t)y * width + x) * 4;
+                sr += p[r];
+                sg += p[1];
+                sb += p[b];
+            }
+            size_t c = (size_t)cy * chromaWidth + cx;
+            /* four samples summed, so >> 10 and 128 << 10 as the offset */
+            uPlane[c] = clampByte((-43 * sr - 85 * sg + 128 * sb +
+                                   (128 << 10) + 512) >> 10);
+            vPlane[c] = clampByte((128 * sr - 107 * sg - 21 * sb +
+                                   (128 << 10) + 512) >> 10);
+        }
+    }
+}
+
+static void writeReadback(struct sl_oo *oo, struct sl_readback *readback) {
+    TRACE_ZONE(oo, "write frame");
+    static const char frameHeader[] = "FRAME\n";
+    struct sl_stream *stream = &oo->stream;
+
+    invalidateReadback(oo, readback);
+
+    uint32_t width = readback->extent.width;
+    uint32_t height = readback->extent.height;
+    size_t pixels = (size_t)width * height;
+    const uint8_t *src = readback->mapped;
+
+    struct iovec iov[2];
+    int count = 0;
+    if (stream->format == STREAM_Y4M) {
+        iov[count].iov_base = (void *)frameHeader;
+        iov[count].iov_len = sizeof(frameHeader) - 1;
+        count++;
+        if (!stream->useCompute) {
+            convertToYUV(src, stream->staging, width, height,
+                         isBGRA(readback->format));
+            src = stream->staging;
+        }
+        iov[count].iov_base = (void *)src;
+        iov[count].iov_len = yuvFrameSize(readback->extent);
+        count++;
+    } else {
+        if (isBGRA(readback->format)) {
+            for (size_t i = 0; i < pixels; i++) {
+                stream->staging[i * 4 + 0] = src[i * 4 + 2];
+                stream->staging[i * 4 + 1] = src[i * 4 + 1];
+                stream->staging[i * 4 + 2] = src[i * 4 + 0];
+                stream->staging[i * 4 + 3] = src[i * 4 + 3];
+            }
+            src = stream->staging;
+        }
+        iov[count].iov_base = (void *)src;
+        iov[count].iov_len = pixels * 4;
+        count++;
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < count; i++) {
+        size += iov[i].iov_len;
+    }
+
+    /* one frame is one large sequential write */
+    bool ok = writeAll(stream->fd, iov, count);
+    if (!ok) {
+        error_log("failed to write video stream to %s: %s!", stream->path,
+                  strerror(errno));
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    if (ok) {
+        stream->framesWritten++;
+        stream->bytesWritten += size;
+    } else {
+        stream->failed = true;
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static void *streamWriter(void *arg) {
+    struct sl_oo *oo = arg;
+    struct sl_stream *stream = &oo->stream;
+    traceThreadName(oo, "stream writer");
+
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (stream->queueCount == 0 && !stream->stopping) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (stream->queueCount == 0) {
+            break;
+        }
+
+        int index = stream->queue[stream->queueHead];
+        bool failed = stream->failed;
+        pthread_mutex_unlock(&stream->lock);
+
+        /* after a failed write the rest is only drained, so the render
+           thread never waits on a reader that is gone */
+        if (!failed) {
+            writeReadback(oo, &stream->readbacks[index]);
+        }
+
+        pthread_mutex_lock(&stream->lock);
+        stream->queueHead = (stream->queueHead + 1) % STREAM_RING_SIZE;
+        stream->queueCount--;
+        stream->readbacks[index].state = READBACK_FREE;
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+static void dispatchStreamReadback(struct sl_stream *stream, int index) {
+    pthread_mutex_lock(&stream->lock);
+    stream->readbacks[index].state = READBACK_ENCODING;
+    int tail = (stream->queueHead + stream->queueCount) % STREAM_RING_SIZE;
+    stream->queue[tail] = index;
+    stream->queueCount++;
+    if (stream->queueCount > stream->maxQueued) {
+        stream->maxQueued = stream->queueCount;
+    }
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/* only valid once the gpu is idle, hands over every recorded frame and
+   waits until all of them are written */
+static void flushStream(struct sl_oo *oo) {
+    struct sl_stream *stream = &oo->stream;
+
+    /* readbacks are used round robin, walking from next is oldest first */
+    for (int k = 0; k < STREAM_RING_SIZE; k++) {
+        int index = (stream->next + k) % STREAM_RING_SIZE;
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (stream->pending[i] == index) {
+                dispatchStreamReadback(stream, index);
+                stream->pending[i] = -1;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    while (stream->queueCount > 0) {
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+/****** render thread */
+
+static bool supportsComputeConversion(struct sl_oo *oo) {
+    struct sl_stream *stream = &oo->stream;
+
+    if (!stream->gpuConvert || stream->format != STREAM_Y4M ||
+        !stream->sampledImages) {
+        return false;
+    }
+
+    /* the shader writes 8x2 blocks as whole words */
+    if (stream->extent.width % 8 != 0 || stream->extent.height % 2 != 0) {
+        return false;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(oo->physicalDevice, stream->imageFormat,
+                                        &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        return false;
+    }
+
+    /* the dispatch goes into the graphics command buffer */
+    return graphicsQueueSupportsCompute(oo);
+}
+
+static void createConversionPipeline(struct sl_oo *oo) {
+    struct sl_stream *stream = &oo->stream;
+
+    VkDescriptorSetLayoutBinding bindings[2] = { 0 };
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { 0 };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(oo->device, &layoutInfo,
+                                    hostAllocator(oo, ALLOC_PIPELINES),
+                                    &stream->descriptorSetLayout) !=
+        VK_SUCCESS) {
+        error_log("failed to create stream descriptor set layout!");
+        exit(1);
+    }
+
+    /* one set per readback, rewritten when the readback is reused */
+    VkDescriptorPoolSize poolSizes[2] = { 0 };
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = STREAM_RING_SIZE;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = STREAM_RING_SIZE;
+
+    VkDescriptorPoolCreateInfo poolInfo = { 0 };
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = STREAM_RING_SIZE;
+
+    if (vkCreateDescriptorPool(oo->device, &poolInfo,
+                               hostAllocator(oo, ALLOC_DESCRIPTORS),
+                               &stream->descriptorPool) != VK_SUCCESS) {
+        error_log("failed to create stream descriptor pool!");
+        exit(1);
+    }
+
+    VkDescriptorSetLayout layouts[STREAM_RING_SIZE];
+    for (int i = 0; i < STREAM_RING_SIZE; i++) {
+        layouts[i] = stream->descriptorSetLayout;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = { 0 };
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = stream->descriptorPool;
+    allocInfo.descriptorSetCount = STREAM_RING_SIZE;
+    allocInfo.pSetLayouts = layouts;
+
+    if (vkAllocateDescriptorSets(oo->device, &allocInfo,
+                                 stream->descriptorSets) != VK_SUCCESS) {
+        error_log("failed to allocate stream descriptor sets!");
+        exit(1);
+    }
+
+    /* texelFetch ignores the filter, a sampler is still required */
+    VkSamplerCreateInfo samplerInfo = { 0 };
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(oo->device, &samplerInfo,
+                        hostAllocator(oo, ALLOC_DESCRIPTORS),
+                        &stream->sampler) != VK_SUCCESS) {
+        error_log("failed to create stream sampler!");
+        exit(1);
+    }
+
+    VkPushConstantRange pushConstantRange = { 0 };
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(uint32_t) * 3;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { 0 };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &stream->descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(oo->device, &pipelineLayoutInfo,
+                               hostAllocator(oo, ALLOC_PIPELINES),
+                               &stream->pipelineLayout) != VK_SUCCESS) {
+        error_log("failed to create stream pipeline layout!");
+        exit(1);
+    }
+
+    stream->pipeline = createComputePipeline(oo, "shaders/rgb2yuv.spv",
+                                             stream->pipelineLayout);
+}
+
+static void writeY4MHeader(struct sl_stream *stream) {
+    char header[128];
+    int n = snprintf(header, sizeof(header),
+                     "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C420jpeg "
+                     "XCOLORRANGE=FULL\n",
+                     stream->extent.width, stream->extent.height, STREAM_FPS);
+    struct iovec iov = { header, (size_t)n };
+    if (!writeAll(stream->fd, &iov, 1)) {
+        error_log("failed to write video stream to %s: %s!", stream->path,
+                  strerror(errno));
+        exit(1);
+    }
+}
+
+void createStream(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "createStream");
+
+    struct sl_stream *stream = &oo->stream;
+    if (stream->path == NULL) {
+        return;
+    }
+
+    if (STREAM_RING_SIZE <= MAX_FRAMES_IN_FLIGHT) {
+        error_log("STREAM_RING_SIZE must be larger than MAX_FRAMES_IN_FLIGHT!");
+        exit(1);
+    }
+    if (!isCapturableFormat(oo->targets[0].swapChainImageFormat)) {
+        error_log("cannot stream swapchain format %d",
+                  oo->targets[0].swapChainImageFormat);
+        return;
+    }
+
+    stream->extent = oo->targets[0].swapChainExtent;
+    stream->imageFormat = oo->targets[0].swapChainImageFormat;
+    stream->useCompute = supportsComputeConversion(oo);
+    /* createSwapChain asks for TRANSFER_SRC whenever it can */
+    if (!stream->useCompute && !oo->capture.supported) {
+        error_log("cannot stream, swapchain images can not be copied");
+        return;
+    }
+
+    if (strcmp(stream->path, "-") == 0) {
+        stream->fd = STDOUT_FILENO;
+    } else {
+        stream->fd = open(stream->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (stream->fd < 0) {
+            error_log("failed to open %s: %s!", stream->path,
+                      strerror(errno));
+            exit(1);
+        }
+    }
+
+    /* a closed pipe should fail the write, not kill the process */
+    struct sigaction action = { 0 };
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+
+    if (stream->format == STREAM_Y4M) {
+        writeY4MHeader(stream);
+    }
+
+    size_t pixels = (size_t)stream->extent.width * stream->extent.height;
+    for (int i = 0; i < STREAM_RING_SIZE; i++) {
+        if (stream->useCompute) {
+            createReadback(oo, &stream->readbacks[i],
+                           yuvFrameSize(stream->extent),
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        } else {
+            createReadback(oo, &stream->readbacks[i], pixels * 4,
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        }
+    }
+    if (stream->useCompute) {
+        createConversionPipeline(oo);
+    } else {
+        stream->staging = malloc(pixels * 4);
+    }
+
+    stream->pending = malloc(sizeof(int) * MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        stream->pending[i] = -1;
+    }
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    if (pthread_create(&stream->writer, NULL, streamWriter, oo) != 0) {
+        error_log("failed to start stream thread!");
+        exit(1);
+    }
+
+    stream->active = true;
+    fprintf(stderr, "streaming %ux%u %s to %s, %s conversion\n",
+            stream->extent.width, stream->extent.height,
+            stream->format == STREAM_Y4M ? "y4m" : "rgba", stream->path,
+            stream->useCompute ? "gpu" : "cpu");
+}
+
+void recreateStreamBuffers(struct sl_oo *oo) {
+    TRACE_ZONE(oo, "recreateStreamBuffers");
+
+    struct sl_stream *stream = &oo->stream;
+    if (stream->pending == NULL || !stream->active) {
+        return;
+    }
+
+    /* the readbacks do not depend on the swapchain, only the size does */
+    if (oo->targets[0].swapChainExtent.width == stream->extent.width &&
+        oo->targets[0].swapChainExtent.height == stream->extent.height &&
+        oo->targets[0].swapChainImageFormat == stream->imageFormat) {
+        return;
+    }
+
+    flushStream(oo);
+    stream->active = false;
+    error_log("swapchain resized to %ux%u, video stream ended after %llu "
+              "frames",
+              oo->targets[0].swapChainExtent.width,
+              oo->targets[0].swapChainExtent.height,
+              (unsigned long long)stream->framesWritten);
+}
+
+void destroyStream(struct sl_oo *oo) {
+    struct sl_stream *stream = &oo->stream;
+    if (stream->pending == NULL) {
+        return;
+    }
+
+    flushStream(oo);
+
+    pthread_mutex_lock(&stream->lock);
+    stream->stopping = true;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->writer, NULL);
+
+    fprintf(stderr,
+            "stream: %llu frames, %.1f MiB, rendering waited for the writer "
+            "%u times (%.1f ms), at most %d frames queued\n",
+            (unsigned long long)stream->framesWritten,
+            stream->bytesWritten / (1024.0 * 1024.0), stream->stalls,
+            stream->stallMs, stream->maxQueued);
+
+    if (stream->fd != STDOUT_FILENO) {
+        close(stream->fd);
+    }
+
+    for (int i = 0; i < STREAM_RING_SIZE; i++) {
+        destroyReadback(oo, &stream->readbacks[i]);
+    }
+    if (stream->useCompute) {
+        vkDestroyPipeline(oo->device, stream->pipeline,
+                          hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroyPipelineLayout(oo->device, stream->pipelineLayout,
+                                hostAllocator(oo, ALLOC_PIPELINES));
+        vkDestroySampler(oo->device, stream->sampler,
+                         hostAllocator(oo, ALLOC_DESCRIPTORS));
+        vkDestroyDescriptorPool(oo->device, stream->descriptorPool,
+                                hostAllocator(oo, ALLOC_DESCRIPTORS));
+        vkDestroyDescriptorSetLayout(oo->device, stream->descriptorSetLayout,
+                                     hostAllocator(oo, ALLOC_PIPELINES));
+    }
+
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream->staging);
+    free(stream->pending);
+    stream->pending = NULL;
+    stream->active = false;
+}
+
+void streamCollect(struct sl_oo *oo) {
+    struct sl_stream *stream = &oo->stream;
+    if (stream->pending == NULL) {
+        return;
+    }
+    int index = stream->pending[oo->currentFrame];
+
+    /* the fence of this frame slot just signaled, so is the copy */
+    if (index >= 0) {
+        dispatchStreamReadback(stream, index);
+        stream->pending[oo->currentFrame] = -1;
+    }
+}
+
+void streamBegin(struct sl_oo *oo, uint32_t imageIndex) {
+    struct sl_stream *stream = &oo->stream;
+    if (stream->pending == NULL || !stream->active) {
+        return;
+    }
+
+    struct sl_readback *readback = &stream->readbacks[stream->next];
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->failed) {
+        pthread_mutex_unlock(&stream->lock);
+        stream->active = false;
+        error_log("video stream ended after %llu frames",
+                  (unsigned long long)stream->framesWritten);
+        return;
+    }
+    if (readback->state != READBACK_FREE) {
+        /* the writer is behind, hold the frame rather than drop one. the
+           ring is larger than the frames in flight, so this readback is
+           already with the writer and will come back */
+        double start = nowMs();
+        while (readback->state != READBACK_FREE) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        stream->stalls++;
+        stream->stallMs += nowMs() - start;
+    }
+    readback->state = READBACK_IN_FLIGHT;
+    pthread_mutex_unlock(&stream->lock);
+
+    readback->extent = stream->extent;
+    readback->format = stream->imageFormat;
+    stream->pending[oo->currentFrame] = stream->next;
+
+    if (stream->useCompute) {
+        /* the set is not in use, its last frame already signaled */
+        VkDescriptorImageInfo imageInfo = { 0 };
+        imageInfo.sampler = stream->sampler;
+        imageInfo.imageView = oo->targets[0].swapChainImageViews[imageIndex];
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkDescriptorBufferInfo bufferInfo = { 0 };
+        bufferInfo.buffer = readback->buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writes[2] = { 0 };
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = stream->descriptorSets[stream->next];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].descriptorCount = 1;
+        writes[0].pImageInfo = &imageInfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = stream->descriptorSets[stream->next];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].descriptorCount = 1;
+        writes[1].pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(oo->device, 2, writes, 0, NULL);
+    }
+
+    stream->next = (stream->next + 1) % STREAM_RING_SIZE;
+}
+
+static void recordConversion(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                             VkImage image, int index) {
+    struct sl_stream *stream = &oo->stream;
+    struct sl_readback *readback = &stream->readbacks[index];
+    VkImageLayout finalLayout = oo->headless
+                                    ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkImageMemoryBarrier barrier = { 0 };
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = finalLayout;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    uint32_t params[3] = {
+        stream->extent.width, stream->extent.height,
+        stream->imageFormat == VK_FORMAT_B8G8R8A8_SRGB ||
+            stream->imageFormat == VK_FORMAT_R8G8B8A8_SRGB
+    };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      stream->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            stream->pipelineLayout, 0, 1,
+                            &stream->descriptorSets[index], 0, NULL);
+    vkCmdPushConstants(commandBuffer, stream->pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), params);
+    /* 8x2 pixels per invocation, 8x8 invocations per group */
+    vkCmdDispatch(commandBuffer, (stream->extent.width / 8 + 7) / 8,
+                  (stream->extent.height / 2 + 7) / 8, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    VkBufferMemoryBarrier bufferBarrier = { 0 };
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = readback->buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                         &bufferBarrier, 0, NULL);
+}
+
+void recordStream(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                  uint32_t imageIndex) {
+    struct sl_stream *stream = &oo->stream;
+    if (stream->pending == NULL) {
+        return;
+    }
+    int index = stream->pending[oo->currentFrame];
+    if (index < 0) {
+        return;
+    }
+
+    VkImage image = oo->targets[0].swapChainImages[imageIndex];
+    if (stream->useCompute) {
+        recordConversion(oo, commandBuffer, image, index);
+    } else {
+        recordReadbackCopy(oo, commandBuffer, image,
+                           &stream->readbacks[index]);
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "config.h"
+#include "capture.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* every rendered frame written to a file or pipe for offline encoding.
+   same scheme as screenshots: the copy is recorded into the frame's
+   command buffer, the frame fence says when it landed and a writer thread
+   does the io, strictly in frame order. when the writer falls behind the
+   render thread waits for it and counts the wait, nothing is dropped. */
+
+struct sl_oo;
+
+enum StreamFormat {
+    /* planar 4:2:0 with a YUV4MPEG2 header, what ffmpeg -i - expects */
+    STREAM_Y4M,
+    /* headerless 8 bit rgba, the size is only known to the caller */
+    STREAM_RGBA,
+};
+
+struct sl_stream {
+    /* options, set before createSwapChain */
+    const char *path;
+    enum StreamFormat format;
+    /* convert to yuv in a compute shader, 1.5 instead of 4 bytes per
+       pixel cross the bus. falls back to the cpu when unsupported */
+    bool gpuConvert;
+
+    /* set by createSwapChain when the images can be sampled */
+    bool sampledImages;
+
+    bool active;
+    bool useCompute;
+    int fd;
+    VkExtent2D extent;
+    VkFormat imageFormat;
+
+    struct sl_readback readbacks[STREAM_RING_SIZE];
+    /* readbacks are used round robin, so the writer frees them in order */
+    int next;
+    /* readback recorded by each frame in flight, -1 for none */
+    int *pending;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSets[STREAM_RING_SIZE];
+    VkSampler sampler;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int queue[STREAM_RING_SIZE];
+    int queueHead;
+    int queueCount;
+    bool stopping;
+    /* a write failed, e.g. the reader of the pipe went away */
+    bool failed;
+    /* conversion target for the cpu paths, writer thread only */
+    uint8_t *staging;
+
+    /* back pressure accounting, guarded by lock */
+    uint64_t framesWritten;
+    uint64_t bytesWritten;
+    uint32_t stalls;
+    double stallMs;
+    int maxQueued;
+};
+
+/* both do nothing unless stream.path is set */
+void createStream(struct sl_oo *oo);
+void destroyStream(struct sl_oo *oo);
+/* the stream keeps its size, a different extent ends it */
+void recreateStreamBuffers(struct sl_oo *oo);
+
+/* drawFrame calls these in the same places as the capture ones */
+void streamCollect(struct sl_oo *oo);
+void streamBegin(struct sl_oo *oo, uint32_t imageIndex);
+void recordStream(struct sl_oo *oo, VkCommandBuffer commandBuffer,
+                  uint32_t imageIndex);
+
+#endif /* STREAM_H */
@@ -0,0 +1,1368 @@
+/* bakes an obj or gltf file into the mesh format loadMesh maps, see
+   meshfile.h. all the parsing happens here, once, instead of at every
+   startup.
+
+   usage: meshconv [--keep-scale] [--no-optimize] [--no-lods]
+                   in.obj|in.gltf|in.glb out.slm
+
+   every triangle primitive of every gltf mesh goes into the one output
+   mesh, node transforms are not applied. the mesh is centered and scaled
+   to fit in a unit cube unless --keep-scale is given. the triangles are
+   reordered for the vertex cache and overdraw unless --no-optimize is
+   given, and the attributes are always quantized. up to three coarser
+   levels of detail are added unless --no-lods is given. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../meshfile.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* what the parsers produce, quantized into struct sl_mesh_vertex last */
+struct vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct model {
+    struct vertex *vertices;
+    uint32_t vertexCount;
+    uint32_t vertexCapacity;
+    uint32_t *indices;
+    uint32_t indexCount;
+    uint32_t indexCapacity;
+    /* vertices without a normal in the source, filled in from the faces */
+    bool *needsNormal;
+    /* ranges of indices, the full mesh until buildLods */
+    uint32_t lodCount;
+    struct sl_mesh_lod lods[MESH_MAX_LODS];
+};
+
+static void fail(const char *what, const char *path) {
+    fprintf(stderr, "meshconv: %s: %s\n", path, what);
+    exit(1);
+}
+
+static char *readWhole(const char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fail("cannot open", path);
+    }
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    /* nul terminated for the text parsers */
+    char *data = malloc(*size + 1);
+    if (fread(data, 1, *size, fp) != *size) {
+        fail("short read", path);
+    }
+    data[*size] = '\0';
+    fclose(fp);
+    return data;
+}
+
+static uint32_t addVertex(struct model *model,
+                          const struct vertex *vertex,
+                          bool needsNormal) {
+    if (model->vertexCount == model->vertexCapacity) {
+        model->vertexCapacity =
+            model->vertexCapacity ? model->vertexCapacity * 2 : 1024;
+        model->vertices = realloc(model->vertices,
+                                  sizeof(struct vertex) *
+                                      model->vertexCapacity);
+        model->needsNormal =
+            realloc(model->needsNormal, sizeof(bool) * model->vertexCapacity);
+    }
+    model->vertices[model->vertexCount] = *vertex;
+    model->needsNormal[model->vertexCount] = needsNormal;
+    return model->vertexCount++;
+}
+
+static void addIndex(struct model *model, uint32_t index) {
+    if (model->indexCount == model->indexCapacity) {
+        model->indexCapacity =
+            model->indexCapacity ? model->indexCapacity * 2 : 4096;
+        model->indices = realloc(model->indices,
+                                 sizeof(uint32_t) * model->indexCapacity);
+    }
+    model->indices[model->indexCount++] = index;
+}
+
+static void bounds(const struct model *model, float min[3], float max[3]) {
+    for (int k = 0; k < 3; k++) {
+        min[k] = model->vertexCount ? INFINITY : 0.0f;
+        max[k] = model->vertexCount ? -INFINITY : 0.0f;
+    }
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        for (int k = 0; k < 3; k++) {
+            float p = model->vertices[i].position[k];
+            min[k] = p < min[k] ? p : min[k];
+            max[k] = p > max[k] ? p : max[k];
+        }
+    }
+}
+
+/* area weighted face normals into every vertex that came without one,
+   before the flip into view space so the winding is still ccw */
+static void fillNormals(struct model *model) {
+    for (uint32_t i = 0; i + 2 < model->indexCount; i += 3) {
+        struct vertex *v[3];
+        for (int j = 0; j < 3; j++) {
+            v[j] = &model->vertices[model->indices[i + j]];
+        }
+        float e1[3], e2[3];
+        for (int k = 0; k < 3; k++) {
+            e1[k] = v[1]->position[k] - v[0]->position[k];
+            e2[k] = v[2]->position[k] - v[0]->position[k];
+        }
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0] };
+        for (int j = 0; j < 3; j++) {
+            if (!model->needsNormal[model->indices[i + j]]) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                v[j]->normal[k] += n[k];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        if (!model->needsNormal[i]) {
+            continue;
+        }
+        float *n = model->vertices[i].normal;
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        } else {
+            n[2] = 1.0f;
+        }
+    }
+}
+
+/****** obj */
+
+struct cornerKey {
+    int32_t v, t, n;
+};
+
+struct cornerTable {
+    struct cornerKey *keys;
+    uint32_t *values;
+    uint32_t mask;
+};
+
+static uint32_t hashCorner(const struct cornerKey *key) {
+    uint32_t h = (uint32_t)key->v * 0x9e3779b1u;
+    h ^= (uint32_t)key->t * 0x85ebca77u;
+    h ^= (uint32_t)key->n * 0xc2b2ae3du;
+    return h ^ (h >> 15);
+}
+
+/* a vertex per distinct v/t/n triple, obj indexes each attribute on its
+   own */
+static uint32_t findCorner(struct cornerTable *table, struct model *model,
+                           const struct cornerKey *key, const float *v,
+                           const float *t, const float *n) {
+    if (model->vertexCount * 2 >= table->mask) {
+        struct cornerTable grown;
+        grown.mask = table->mask ? table->mask * 2 + 1 : 4095;
+        grown.keys = malloc(sizeof(struct cornerKey) * (grown.mask + 1));
+        grown.values = malloc(sizeof(uint32_t) * (grown.mask + 1));
+        memset(grown.values, 0xff, sizeof(uint32_t) * (grown.mask + 1));
+        for (uint32_t i = 0; table->mask && i <= table->mask; i++) {
+            if (table->values[i] == UINT32_MAX) {
+                continue;
+            }
+            uint32_t slot = hashCorner(&table->keys[i]) & grown.mask;
+            while (grown.values[slot] != UINT32_MAX) {
+                slot = (slot + 1) & grown.mask;
+            }
+            grown.keys[slot] = table->keys[i];
+            grown.values[slot] = table->values[i];
+        }
+        free(table->keys);
+        free(table->values);
+        *table = grown;
+    }
+
+    uint32_t slot = hashCorner(key) & table->mask;
+    while (table->values[slot] != UINT32_MAX) {
+        const struct cornerKey *other = &table->keys[slot];
+        if (other->v == key->v && other->t == key->t && other->n == key->n) {
+            return table->values[slot];
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    struct vertex vertex = { 0 };
+    memcpy(vertex.position, v, sizeof(vertex.position));
+    if (t != NULL) {
+        vertex.uv[0] = t[0];
+        /* obj has v going up */
+        vertex.uv[1] = 1.0f - t[1];
+    }
+    if (n != NULL) {
+        memcpy(vertex.normal, n, sizeof(vertex.normal));
+    }
+    table->keys[slot] = *key;
+    table->values[slot] = addVertex(model, &vertex, n == NULL);
+    return table->values[slot];
+}
+
+struct floatArray {
+    float *data;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static void pushFloats(struct floatArray *array, const float *values,
+                       uint32_t count) {
+    if (array->count + count > array->capacity) {
+        array->capacity = array->capacity ? array->capacity * 2 : 4096;
+        array->data = realloc(array->data, sizeof(float) * array->capacity);
+    }
+    memcpy(array->data + array->count, values, sizeof(float) * count);
+    array->count += count;
+}
+
+/* 1 based, negative counts back from the last one defined so far */
+static int32_t objIndex(long index, uint32_t count) {
+    if (index > 0) {
+        return index - 1 < (long)count ? (int32_t)(index - 1) : -1;
+    }
+    if (index < 0) {
+        return (long)count + index >= 0 ? (int32_t)(count + index) : -1;
+    }
+    return -1;
+}
+
+static void parseObj(char *text, const char *path, struct model *model) {
+    struct floatArray positions = { 0 };
+    struct floatArray texcoords = { 0 };
+    struct floatArray normals = { 0 };
+    struct cornerTable table = { 0 };
+
+    for (char *line = strtok(text, "\n"); line != NULL;
+         line = strtok(NULL, "\n")) {
+        float f[3] = { 0 };
+        if (strncmp(line, "v ", 2) == 0) {
+            sscanf(line + 2, "%f %f %f", &f[0], &f[1], &f[2]);
+            pushFloats(&positions, f, 3);
+        } else if (strncmp(line, "vt ", 3) == 0) {
+            sscanf(line + 3, "%f %f", &f[0], &f[1]);
+            pushFloats(&texcoords, f, 2);
+        } else if (strncmp(line, "vn ", 3) == 0) {
+            sscanf(line + 3, "%f %f %f", &f[0], &f[1], &f[2]);
+            pushFloats(&normals, f, 3);
+        } else if (strncmp(line, "f ", 2) == 0) {
+            /* polygons as a fan around the first corner */
+            uint32_t first = 0, previous = 0;
+            int corners = 0;
+            char *p = line + 2;
+            for (;;) {
+                while (*p == ' ' || *p == '\t' || *p == '\r') {
+                    p++;
+                }
+                if (*p == '\0') {
+                    break;
+                }
+                long v = strtol(p, &p, 10), t = 0, n = 0;
+                if (*p == '/') {
+                    p++;
+                    if (*p != '/') {
+                        t = strtol(p, &p, 10);
+                    }
+                    if (*p == '/') {
+                        n = strtol(p + 1, &p, 10);
+                    }
+                }
+                while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r') {
+                    p++;
+                }
+
+                struct cornerKey key = { objIndex(v, positions.count / 3),
+                                         objIndex(t, texcoords.count / 2),
+                                         objIndex(n, normals.count / 3) };
+                if (key.v < 0) {
+                    fail("face refers to a missing vertex", path);
+                }
+                uint32_t index = findCorner(
+                    &table, model, &key, &positions.data[key.v * 3],
+                    key.t >= 0 ? &texcoords.data[key.t * 2] : NULL,
+                    key.n >= 0 ? &normals.data[key.n * 3] : NULL);
+
+                if (corners == 0) {
+                    first = index;
+                } else if (corners >= 2) {
+                    addIndex(model, first);
+                    addIndex(model, previous);
+                    addIndex(model, index);
+                }
+                previous = index;
+                corners++;
+            }
+        }
+    }
+
+    free(positions.data);
+    free(texcoords.data);
+    free(normals.data);
+    free(table.keys);
+    free(table.values);
+}
+
+/****** gltf */
+
+enum JsonType { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY,
+                JSON_OBJECT };
+
+/* strings point into the text and are not unescaped, gltf keys and uris
+   do not need it */
+struct json {
+    enum JsonType type;
+    double number;
+    const char *string;
+    int length;
+    /* members of an object have a key */
+    const char *key;
+    int keyLength;
+    struct json *child;
+    struct json *next;
+};
+
+static const char *skipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static const char *parseString(const char *p, const char **s, int *length) {
+    /* p is past the opening quote */
+    const char *start = p;
+    while (*p != '"' && *p != '\0') {
+        p += *p == '\\' && p[1] != '\0' ? 2 : 1;
+    }
+    *s = start;
+    *length = (int)(p - start);
+    return *p == '"' ? p + 1 : p;
+}
+
+static const char *parseJson(const char *p, struct json **out) {
+    struct json *node = calloc(1, sizeof(struct json));
+    *out = node;
+    p = skipSpace(p);
+
+    if (*p == '{' || *p == '[') {
+        bool object = *p == '{';
+        char close = object ? '}' : ']';
+        node->type = object ? JSON_OBJECT : JSON_ARRAY;
+        struct json **tail = &node->child;
+        p = skipSpace(p + 1);
+        while (*p != close && *p != '\0') {
+            const char *key = NULL;
+            int keyLength = 0;
+            if (object) {
+                if (*p != '"') {
+                    return NULL;
+                }
+                p = skipSpace(parseString(p + 1, &key, &keyLength));
+                if (*p++ != ':') {
+                    return NULL;
+                }
+            }
+            p = parseJson(p, tail);
+            if (p == NULL) {
+                return NULL;
+            }
+            (*tail)->key = key;
+            (*tail)->keyLength = keyLength;
+            tail = &(*tail)->next;
+            p = skipSpace(p);
+            if (*p == ',') {
+                p = skipSpace(p + 1);
+            }
+        }
+        return *p == close ? p + 1 : NULL;
+    }
+    if (*p == '"') {
+        node->type = JSON_STRING;
+        return parseString(p + 1, &node->string, &node->length);
+    }
+    if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+        node->type = JSON_BOOL;
+        node->number = *p == 't';
+        return p + (*p == 't' ? 4 : 5);
+    }
+    if (strncmp(p, "null", 4) == 0) {
+        return p + 4;
+    }
+    char *end;
+    node->type = JSON_NUMBER;
+    node->number = strtod(p, &end);
+    return end == p ? NULL : end;
+}
+
+static struct json *jsonGet(const struct json *object, const char *key) {
+    if (object == NULL || object->type != JSON_OBJECT) {
+        return NULL;
+    }
+    int length = (int)strlen(key);
+    for (struct json *child = object->child; child; child = child->next) {
+        if (child->keyLength == length &&
+            strncmp(child->key, key, length) == 0) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+static struct json *jsonAt(const struct json *array, int index) {
+    if (array == NULL || array->type != JSON_ARRAY || index < 0) {
+        return NULL;
+    }
+    struct json *child = array->child;
+    while (child != NULL && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+static long jsonInt(const struct json *node, long fallback) {
+    return node != NULL && node->type == JSON_NUMBER ? (long)node->number
+                                                     : fallback;
+}
+
+static void freeJson(struct json *node) {
+    while (node != NULL) {
+        struct json *next = node->next;
+        freeJson(node->child);
+        free(node);
+        node = next;
+    }
+}
+
+static int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+static uint8_t *decodeBase64(const char *s, int length, size_t *size) {
+    uint8_t *data = malloc(length / 4 * 3 + 3);
+    uint32_t bits = 0;
+    int count = 0;
+    *size = 0;
+    for (int i = 0; i < length; i++) {
+        int value = base64Value(s[i]);
+        if (value < 0) {
+            continue;
+        }
+        bits = bits << 6 | value;
+        if (++count == 4) {
+            data[(*size)++] = bits >> 16;
+            data[(*size)++] = bits >> 8;
+            data[(*size)++] = bits;
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 3) {
+        data[(*size)++] = bits >> 10;
+        data[(*size)++] = bits >> 2;
+    } else if (count == 2) {
+        data[(*size)++] = bits >> 4;
+    }
+    return data;
+}
+
+struct gltfBuffer {
+    uint8_t *data;
+    size_t size;
+    /* the glb chunk belongs to the file, everything else is ours */
+    bool owned;
+};
+
+struct gltf {
+    struct json *root;
+    struct gltfBuffer *buffers;
+    int bufferCount;
+    const char *path;
+};
+
+static void loadBuffers(struct gltf *gltf, uint8_t *glbChunk,
+                        size_t glbSize) {
+    struct json *buffers = jsonGet(gltf->root, "buffers");
+    int count = 0;
+    for (struct json *b = buffers ? buffers->child : NULL; b; b = b->next) {
+        count++;
+    }
+    gltf->buffers = calloc(count ? count : 1, sizeof(struct gltfBuffer));
+    gltf->bufferCount = count;
+
+    for (int i = 0; i < count; i++) {
+        struct json *uri = jsonGet(jsonAt(buffers, i), "uri");
+        struct gltfBuffer *buffer = &gltf->buffers[i];
+        if (uri == NULL) {
+            if (glbChunk == NULL) {
+                fail("buffer without uri outside of a glb", gltf->path);
+            }
+            buffer->data = glbChunk;
+            buffer->size = glbSize;
+            continue;
+        }
+        buffer->owned = true;
+        if (uri->length > 5 && strncmp(uri->string, "data:", 5) == 0) {
+            const char *comma = memchr(uri->string, ',', uri->length);
+            if (comma == NULL) {
+                fail("bad data uri", gltf->path);
+            }
+            comma++;
+            buffer->data = decodeBase64(
+                comma, uri->length - (int)(comma - uri->string),
+                &buffer->size);
+            continue;
+        }
+        /* relative to the gltf file */
+        const char *slash = strrchr(gltf->path, '/');
+        int dirLength = slash ? (int)(slash - gltf->path) + 1 : 0;
+        char *file = malloc(dirLength + uri->length + 1);
+        memcpy(file, gltf->path, dirLength);
+        memcpy(file + dirLength, uri->string, uri->length);
+        file[dirLength + uri->length] = '\0';
+        buffer->data = (uint8_t *)readWhole(file, &buffer->size);
+        free(file);
+    }
+}
+
+/* a pointer to element 0 of an accessor and the distance between
+   elements, after checking they are all inside the buffer */
+static const uint8_t *accessorData(const struct gltf *gltf, long index,
+                                   size_t elementSize, uint32_t *count,
+                                   size_t *stride,
+                                   long *componentType) {
+    struct json *accessor = jsonAt(jsonGet(gltf->root, "accessors"),
+                                   (int)index);
+    if (accessor == NULL) {
+        fail("missing accessor", gltf->path);
+    }
+    struct json *view = jsonAt(jsonGet(gltf->root, "bufferViews"),
+                               (int)jsonInt(jsonGet(accessor, "bufferView"),
+                                            -1));
+    if (view == NULL) {
+        fail("sparse or bufferless accessors are not supported", gltf->path);
+    }
+    long bufferIndex = jsonInt(jsonGet(view, "buffer"), -1);
+    if (bufferIndex < 0 || bufferIndex >= gltf->bufferCount) {
+        fail("missing buffer", gltf->path);
+    }
+    const struct gltfBuffer *buffer = &gltf->buffers[bufferIndex];
+
+    *count = (uint32_t)jsonInt(jsonGet(accessor, "count"), 0);
+    *componentType = jsonInt(jsonGet(accessor, "componentType"), 0);
+    *stride = (size_t)jsonInt(jsonGet(view, "byteStride"), 0);
+    if (*stride == 0) {
+        *stride = elementSize;
+    }
+    size_t offset = (size_t)jsonInt(jsonGet(view, "byteOffset"), 0) +
+                    (size_t)jsonInt(jsonGet(accessor, "byteOffset"), 0);
+    if (*count > 0 &&
+        offset + (size_t)(*count - 1) * *stride + elementSize > buffer->size) {
+        fail("accessor past the end of its buffer", gltf->path);
+    }
+    return buffer->data + offset;
+}
+
+static void readFloats(const uint8_t *p, float *out, int n) {
+    memcpy(out, p, sizeof(float) * n);
+}
+
+static void addPrimitive(const struct gltf *gltf, const struct json *primitive,
+                         struct model *model) {
+    /* triangles is the default mode */
+    if (jsonInt(jsonGet(primitive, "mode"), 4) != 4) {
+        return;
+    }
+    struct json *attributes = jsonGet(primitive, "attributes");
+    struct json *position = jsonGet(attributes, "POSITION");
+    if (position == NULL) {
+        return;
+    }
+
+    uint32_t count, normalCount = 0, uvCount = 0;
+    size_t stride, normalStride = 0, uvStride = 0;
+    long type;
+    const uint8_t *positions =
+        accessorData(gltf, jsonInt(position, -1), sizeof(float) * 3, &count,
+                     &stride, &type);
+    if (type != 5126) {
+        fail("positions are not floats", gltf->path);
+    }
+    const uint8_t *normals = NULL;
+    struct json *normal = jsonGet(attributes, "NORMAL");
+    if (normal != NULL) {
+        normals = accessorData(gltf, jsonInt(normal, -1), sizeof(float) * 3,
+                               &normalCount, &normalStride, &type);
+        if (type != 5126 || normalCount != count) {
+            normals = NULL;
+        }
+    }
+    const uint8_t *uvs = NULL;
+    struct json *uv = jsonGet(attributes, "TEXCOORD_0");
+    if (uv != NULL) {
+        uvs = accessorData(gltf, jsonInt(uv, -1), sizeof(float) * 2, &uvCount,
+                           &uvStride, &type);
+        if (type != 5126 || uvCount != count) {
+            uvs = NULL;
+        }
+    }
+
+    uint32_t base = model->vertexCount;
+    for (uint32_t i = 0; i < count; i++) {
+        struct vertex vertex = { 0 };
+        readFloats(positions + i * stride, vertex.position, 3);
+        if (normals != NULL) {
+            readFloats(normals + i * normalStride, vertex.normal, 3);
+        }
+        if (uvs != NULL) {
+            readFloats(uvs + i * uvStride, vertex.uv, 2);
+        }
+        addVertex(model, &vertex, normals == NULL);
+    }
+
+    struct json *indices = jsonGet(primitive, "indices");
+    if (indices == NULL) {
+        for (uint32_t i = 0; i + 2 < count; i += 3) {
+            addIndex(model, base + i);
+            addIndex(model, base + i + 1);
+            addIndex(model, base + i + 2);
+        }
+        return;
+    }
+    /* unsigned byte, short or int */
+    long indexType = jsonInt(
+        jsonGet(jsonAt(jsonGet(gltf->root, "accessors"),
+                       (int)jsonInt(indices, -1)),
+                "componentType"),
+        5125);
+    size_t indexSize = indexType == 5121 ? 1 : indexType == 5123 ? 2 : 4;
+    uint32_t indexCount;
+    size_t indexStride;
+    const uint8_t *data =
+        accessorData(gltf, jsonInt(indices, -1), indexSize, &indexCount,
+                     &indexStride, &indexType);
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        for (int j = 0; j < 3; j++) {
+            const uint8_t *p = data + (size_t)(i + j) * indexStride;
+            uint32_t index;
+            if (indexSize == 1) {
+                index = p[0];
+            } else if (indexSize == 2) {
+                uint16_t v;
+                memcpy(&v, p, 2);
+                index = v;
+            } else {
+                memcpy(&index, p, 4);
+            }
+            if (index >= count) {
+                fail("index past the last vertex", gltf->path);
+            }
+            addIndex(model, base + index);
+        }
+    }
+}
+
+static void parseGltf(char *data, size_t size, const char *path,
+                      struct model *model) {
+    const char *json = data;
+    uint8_t *binChunk = NULL;
+    size_t binSize = 0;
+
+    /* glb: a 12 byte header, then a json chunk and an optional bin chunk */
+    if (size >= 20 && memcmp(data, "glTF", 4) == 0) {
+        uint32_t jsonLength;
+        memcpy(&jsonLength, data + 12, 4);
+        if (20 + (size_t)jsonLength > size) {
+            fail("truncated glb", path);
+        }
+        /* the json chunk is padded with spaces, the nul goes on the
+           padding or on the next chunk's length, which is read first */
+        size_t binStart = 20 + (size_t)jsonLength;
+        if (binStart + 8 <= size) {
+            uint32_t binLength;
+            memcpy(&binLength, data + binStart, 4);
+            if (binStart + 8 + binLength > size) {
+                fail("truncated glb", path);
+            }
+            binChunk = (uint8_t *)data + binStart + 8;
+            binSize = binLength;
+        }
+        data[binStart] = '\0';
+        json = data + 20;
+    }
+
+    struct gltf gltf = { 0 };
+    gltf.path = path;
+    if (parseJson(json, &gltf.root) == NULL) {
+        fail("bad json", path);
+    }
+    loadBuffers(&gltf, binChunk, binSize);
+
+    struct json *meshes = jsonGet(gltf.root, "meshes");
+    for (struct json *mesh = meshes ? meshes->child : NULL; mesh;
+         mesh = mesh->next) {
+        struct json *primitives = jsonGet(mesh, "primitives");
+        for (struct json *p = primitives ? primitives->child : NULL; p;
+             p = p->next) {
+            addPrimitive(&gltf, p, model);
+        }
+    }
+
+    for (int i = 0; i < gltf.bufferCount; i++) {
+        if (gltf.buffers[i].owned) {
+            free(gltf.buffers[i].data);
+        }
+    }
+    free(gltf.buffers);
+    freeJson(gltf.root);
+}
+
+/****** optimization */
+
+/* the post-transform cache the triangle order is scored against */
+#define CACHE_SIZE 32
+/* the fifo the result is measured with, small enough to be pessimistic
+   for every gpu we run on */
+#define FIFO_SIZE 16
+
+/* average cache misses per triangle through a fifo, 0.5 is the best a
+   large regular mesh can do and 3 the worst */
+static float measureAcmr(const struct model *model) {
+    uint32_t *stamp = calloc(model->vertexCount, sizeof(uint32_t));
+    uint32_t time = FIFO_SIZE + 1;
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < model->indexCount; i++) {
+        uint32_t v = model->indices[i];
+        if (time - stamp[v] > FIFO_SIZE) {
+            stamp[v] = time++;
+            misses++;
+        }
+    }
+    free(stamp);
+    return model->indexCount ? misses * 3.0f / model->indexCount : 0.0f;
+}
+
+/* tom forsyth's linear speed vertex cache optimisation: the recently
+   used vertices score high, and so do vertices with few triangles left,
+   so no lone triangles are left behind to be picked up much later */
+static float vertexScore(int cachePosition, uint32_t remaining) {
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0 && cachePosition < 3) {
+        /* the last triangle's, about as likely to hit as not */
+        score = 0.75f;
+    } else if (cachePosition >= 3) {
+        score = powf(1.0f - (cachePosition - 3) / (float)(CACHE_SIZE - 3),
+                     1.5f);
+    }
+    return score + 2.0f / sqrtf((float)remaining);
+}
+
+static void optimizeVertexCache(struct model *model) {
+    uint32_t vertexCount = model->vertexCount;
+    uint32_t triangleCount = model->indexCount / 3;
+
+    /* the triangles of every vertex that are not emitted yet, in one
+       array, each vertex's start in offsets */
+    uint32_t *remaining = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t *offsets = malloc(sizeof(uint32_t) * (vertexCount + 1));
+    uint32_t *adjacency = malloc(sizeof(uint32_t) * triangleCount * 3);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) {
+        remaining[model->indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    for (uint32_t i = 0; i < triangleCount * 3; i++) {
+        uint32_t v = model->indices[i];
+        adjacency[offsets[v] + remaining[v]++] = i / 3;
+    }
+
+    int *cachePosition = malloc(sizeof(int) * vertexCount);
+    float *score = malloc(sizeof(float) * vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        cachePosition[v] = -1;
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    float *triangleScore = malloc(sizeof(float) * triangleCount);
+    bool *emitted = calloc(triangleCount, sizeof(bool));
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t *tri = &model->indices[t * 3];
+        triangleScore[t] = score[tri[0]] + score[tri[1]] + score[tri[2]];
+    }
+
+    uint32_t *ordered = malloc(sizeof(uint32_t) * triangleCount * 3);
+    uint32_t cache[CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    uint32_t scan = 0;
+    int64_t best = -1;
+    for (uint32_t n = 0; n < triangleCount; n++) {
+        if (best < 0) {
+            /* nothing in the cache has triangles left, start over at the
+               first one not emitted yet */
+            while (emitted[scan]) {
+                scan++;
+            }
+            best = scan;
+        }
+        const uint32_t *tri = &model->indices[best * 3];
+        memcpy(&ordered[n * 3], tri, sizeof(uint32_t) * 3);
+        emitted[best] = true;
+
+        uint32_t next[CACHE_SIZE + 3];
+        uint32_t nextCount = 0;
+        for (int j = 0; j < 3; j++) {
+            uint32_t v = tri[j];
+            /* out of the vertex's list of triangles left */
+            uint32_t *list = &adjacency[offsets[v]];
+            for (uint32_t k = 0; k < remaining[v]; k++) {
+                if (list[k] == (uint32_t)best) {
+                    list[k] = list[--remaining[v]];
+                    break;
+                }
+            }
+            next[nextCount++] = v;
+        }
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next[nextCount++] = v;
+            }
+        }
+
+        /* whatever fell out of the cache scores as uncached again */
+        for (uint32_t i = 0; i < nextCount; i++) {
+            uint32_t v = next[i];
+            cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < nextCount; i++) {
+            uint32_t v = next[i];
+            for (uint32_t k = 0; k < remaining[v]; k++) {
+                uint32_t t = adjacency[offsets[v] + k];
+                const uint32_t *other = &model->indices[t * 3];
+                triangleScore[t] =
+                    score[other[0]] + score[other[1]] + score[other[2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = nextCount < CACHE_SIZE ? nextCount : CACHE_SIZE;
+        memcpy(cache, next, sizeof(uint32_t) * cacheCount);
+    }
+
+    memcpy(model->indices, ordered, sizeof(uint32_t) * triangleCount * 3);
+    free(ordered);
+    free(emitted);
+    free(triangleScore);
+    free(score);
+    free(cachePosition);
+    free(adjacency);
+    free(offsets);
+    free(remaining);
+}
+
+struct cluster {
+    uint32_t start;
+    uint32_t count;
+    float facing;
+};
+
+static int compareClusters(const void *a, const void *b) {
+    float x = ((const struct cluster *)a)->facing;
+    float y = ((const struct cluster *)b)->facing;
+    return (x < y) - (x > y);
+}
+
+/* cuts the cache ordered triangles wherever the fifo had to start over
+   anyway, so moving the pieces around costs no hits. the pieces that
+   face away from the center are drawn first, on a closed mesh they are
+   the ones in front of the rest */
+static void optimizeOverdraw(struct model *model) {
+    uint32_t triangleCount = model->indexCount / 3;
+    struct cluster *clusters = malloc(sizeof(struct cluster) * triangleCount);
+    uint32_t clusterCount = 0;
+
+    uint32_t *stamp = calloc(model->vertexCount, sizeof(uint32_t));
+    uint32_t time = FIFO_SIZE + 1;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int j = 0; j < 3; j++) {
+            uint32_t v = model->indices[t * 3 + j];
+            if (time - stamp[v] > FIFO_SIZE) {
+                stamp[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters[clusterCount].start = t;
+            clusters[clusterCount].count = 0;
+            clusterCount++;
+        }
+        clusters[clusterCount - 1].count++;
+    }
+    free(stamp);
+
+    /* area weighted, the center of the surface and not of the bounds */
+    float center[3] = { 0 };
+    float totalArea = 0.0f;
+    float *centroids = malloc(sizeof(float) * 3 * clusterCount);
+    float *normals = calloc(3 * clusterCount, sizeof(float));
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        float *centroid = &centroids[c * 3];
+        float *normal = &normals[c * 3];
+        float area = 0.0f;
+        centroid[0] = centroid[1] = centroid[2] = 0.0f;
+        for (uint32_t t = clusters[c].start;
+             t < clusters[c].start + clusters[c].count; t++) {
+            const float *p[3];
+            for (int j = 0; j < 3; j++) {
+                p[j] = model->vertices[model->indices[t * 3 + j]].position;
+            }
+            float e1[3], e2[3];
+            for (int k = 0; k < 3; k++) {
+                e1[k] = p[1][k] - p[0][k];
+                e2[k] = p[2][k] - p[0][k];
+            }
+            /* clockwise front faces in view space, e2 x e1 points out */
+            float n[3] = { e2[1] * e1[2] - e2[2] * e1[1],
+                           e2[2] * e1[0] - e2[0] * e1[2],
+                           e2[0] * e1[1] - e2[1] * e1[0] };
+            float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++) {
+                centroid[k] += (p[0][k] + p[1][k] + p[2][k]) / 3.0f * a;
+                normal[k] += n[k];
+            }
+            area += a;
+        }
+        for (int k = 0; k < 3; k++) {
+            center[k] += centroid[k];
+            centroid[k] = area > 0.0f ? centroid[k] / area : 0.0f;
+        }
+        totalArea += area;
+    }
+    for (int k = 0; k < 3; k++) {
+        center[k] = totalArea > 0.0f ? center[k] / totalArea : 0.0f;
+    }
+
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        const float *centroid = &centroids[c * 3];
+        const float *normal = &normals[c * 3];
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                             normal[2] * normal[2]);
+        float facing = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            facing += (centroid[k] - center[k]) * normal[k];
+        }
+        clusters[c].facing = length > 0.0f ? facing / length : 0.0f;
+    }
+    free(centroids);
+    free(normals);
+
+    /* qsort is not stable, ties only happen between pieces that are
+       equally good to draw first */
+    qsort(clusters, clusterCount, sizeof(struct cluster), compareClusters);
+    uint32_t *ordered = malloc(sizeof(uint32_t) * model->indexCount);
+    uint32_t n = 0;
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        memcpy(&ordered[n], &model->indices[clusters[c].start * 3],
+               sizeof(uint32_t) * clusters[c].count * 3);
+        n += clusters[c].count * 3;
+    }
+    memcpy(model->indices, ordered, sizeof(uint32_t) * model->indexCount);
+    free(ordered);
+    free(clusters);
+}
+
+/* vertices in the order the triangles first use them, so fetches walk
+   through memory instead of jumping around. unused vertices go away */
+static void optimizeVertexFetch(struct model *model) {
+    uint32_t *remap = malloc(sizeof(uint32_t) * model->vertexCount);
+    memset(remap, 0xff, sizeof(uint32_t) * model->vertexCount);
+    struct vertex *vertices =
+        malloc(sizeof(struct vertex) * (model->vertexCount + 1));
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < model->indexCount; i++) {
+        uint32_t v = model->indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = count;
+            vertices[count++] = model->vertices[v];
+        }
+        model->indices[i] = remap[v];
+    }
+
+    free(model->vertices);
+    model->vertices = vertices;
+    model->vertexCount = count;
+    model->vertexCapacity = count;
+    free(remap);
+}
+
+/****** levels of detail */
+
+/* cells along the longest side of the bounds for the first coarser
+   level, halved for every one after it */
+#define LOD_GRID 64
+/* a level has to drop at least this much of the one before to be worth
+   a draw of its own */
+#define LOD_MIN_REDUCTION 0.75f
+
+/* vertex clustering: every vertex in a grid cell collapses into the one
+   nearest the middle of them, and the triangles that collapse to a line
+   or a point go away. the survivors are existing vertices, so a level is
+   only more indices into the same vertex buffer. crude next to an edge
+   collapse simplifier, but the coarse levels are only drawn a few pixels
+   big */
+static uint32_t clusterLevel(struct model *model, int grid,
+                             const uint32_t *source, uint32_t sourceCount,
+                             uint32_t *out) {
+    float min[3], max[3];
+    bounds(model, min, max);
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        extent = max[k] - min[k] > extent ? max[k] - min[k] : extent;
+    }
+    float scale = extent > 0.0f ? (grid - 0.001f) / extent : 0.0f;
+
+    size_t cellCount = (size_t)grid * grid * grid;
+    uint32_t *cellOf = malloc(sizeof(uint32_t) * model->vertexCount);
+    float *sums = calloc(cellCount * 4, sizeof(float));
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        const float *p = model->vertices[i].position;
+        size_t cell = 0;
+        for (int k = 2; k >= 0; k--) {
+            cell = cell * grid + (size_t)((p[k] - min[k]) * scale);
+        }
+        cellOf[i] = (uint32_t)cell;
+        for (int k = 0; k < 3; k++) {
+            sums[cell * 4 + k] += p[k];
+        }
+        sums[cell * 4 + 3] += 1.0f;
+    }
+
+    uint32_t *representative = malloc(sizeof(uint32_t) * cellCount);
+    float *distance = malloc(sizeof(float) * cellCount);
+    for (size_t c = 0; c < cellCount; c++) {
+        distance[c] = INFINITY;
+    }
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        uint32_t c = cellOf[i];
+        const float *p = model->vertices[i].position;
+        float d = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            float e = p[k] - sums[c * 4 + k] / sums[c * 4 + 3];
+            d += e * e;
+        }
+        if (d < distance[c]) {
+            distance[c] = d;
+            representative[c] = i;
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i + 2 < sourceCount; i += 3) {
+        uint32_t a = representative[cellOf[source[i]]];
+        uint32_t b = representative[cellOf[source[i + 1]]];
+        uint32_t c = representative[cellOf[source[i + 2]]];
+        if (a != b && b != c && c != a) {
+            out[count++] = a;
+            out[count++] = b;
+            out[count++] = c;
+        }
+    }
+
+    free(distance);
+    free(representative);
+    free(sums);
+    free(cellOf);
+    return count;
+}
+
+/* appends the coarser levels after the full mesh, each made from the
+   full mesh at a coarser grid so the errors do not pile up */
+static void buildLods(struct model *model) {
+    uint32_t fullCount = model->indexCount;
+    uint32_t *level = malloc(sizeof(uint32_t) * fullCount);
+    int grid = LOD_GRID;
+    while (model->lodCount < MESH_MAX_LODS && grid >= 2) {
+        uint32_t count =
+            clusterLevel(model, grid, model->indices, fullCount, level);
+        grid /= 2;
+        uint32_t previous = model->lods[model->lodCount - 1].indexCount;
+        if (count == 0) {
+            break;
+        }
+        if (count > previous * LOD_MIN_REDUCTION) {
+            continue;
+        }
+        struct sl_mesh_lod *lod = &model->lods[model->lodCount++];
+        lod->firstIndex = model->indexCount;
+        lod->indexCount = count;
+        for (uint32_t i = 0; i < count; i++) {
+            addIndex(model, level[i]);
+        }
+    }
+    free(level);
+}
+
+/* the cache and overdraw passes on one level at a time, the levels do
+   not share triangles and are never drawn together */
+static struct model lodView(const struct model *model, uint32_t lod) {
+    struct model view = *model;
+    view.indices = model->indices + model->lods[lod].firstIndex;
+    view.indexCount = model->lods[lod].indexCount;
+    return view;
+}
+
+/****** output */
+
+/* both formats are y up with the camera looking down -z, ours is y down
+   looking down +z. a half turn around x, so the mesh looks the same, but
+   their front faces are counter clockwise on screen and ours clockwise */
+static void toViewSpace(struct model *model) {
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        struct vertex *v = &model->vertices[i];
+        v->position[1] = -v->position[1];
+        v->position[2] = -v->position[2];
+        v->normal[1] = -v->normal[1];
+        v->normal[2] = -v->normal[2];
+    }
+    for (uint32_t i = 0; i + 2 < model->indexCount; i += 3) {
+        uint32_t index = model->indices[i + 1];
+        model->indices[i + 1] = model->indices[i + 2];
+        model->indices[i + 2] = index;
+    }
+}
+
+/* the size of the triangle, so --mesh works with the instance layout */
+static void normalize(struct model *model) {
+    float min[3], max[3];
+    bounds(model, min, max);
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        extent = max[k] - min[k] > extent ? max[k] - min[k] : extent;
+    }
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        for (int k = 0; k < 3; k++) {
+            float center = (min[k] + max[k]) * 0.5f;
+            model->vertices[i].position[k] =
+                (model->vertices[i].position[k] - center) * scale;
+        }
+    }
+}
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN;
+}
+
+static uint16_t unorm16(float value, float min, float extent) {
+    float t = extent > 0.0f ? (value - min) / extent : 0.0f;
+    t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+    return (uint16_t)(t * 65535.0f + 0.5f);
+}
+
+static int16_t snorm16(float value) {
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return (int16_t)lrintf(value * 32767.0f);
+}
+
+/* the unit sphere onto an octahedron, then the lower half folded out
+   over the diagonals of the square */
+static void octahedralEncode(const float n[3], int16_t out[2]) {
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+    if (n[2] < 0.0f) {
+        float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = snorm16(x);
+    out[1] = snorm16(y);
+}
+
+static void writeMesh(const struct model *model, const char *path) {
+    struct sl_mesh_header header = { 0 };
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexCount = model->vertexCount;
+    header.vertexStride = sizeof(struct sl_mesh_vertex);
+    header.indexCount = model->indexCount;
+    header.lodCount = model->lodCount;
+    memcpy(header.lods, model->lods, sizeof(header.lods));
+    /* half the index bandwidth whenever it fits */
+    header.indexSize = model->vertexCount <= 65536 ? 2 : 4;
+    header.vertexOffset = alignUp(sizeof(header));
+    header.indexOffset =
+        alignUp(header.vertexOffset +
+                (uint64_t)model->vertexCount * header.vertexStride);
+    uint64_t end = header.indexOffset +
+                   (uint64_t)model->indexCount * header.indexSize;
+    header.dataSize = end - header.vertexOffset;
+    bounds(model, header.boundsMin, header.boundsMax);
+    for (int k = 0; k < 2; k++) {
+        header.uvMin[k] = model->vertexCount ? INFINITY : 0.0f;
+        header.uvMax[k] = model->vertexCount ? -INFINITY : 0.0f;
+    }
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        for (int k = 0; k < 2; k++) {
+            float uv = model->vertices[i].uv[k];
+            header.uvMin[k] = uv < header.uvMin[k] ? uv : header.uvMin[k];
+            header.uvMax[k] = uv > header.uvMax[k] ? uv : header.uvMax[k];
+        }
+    }
+
+    uint8_t *file = calloc(1, end);
+    memcpy(file, &header, sizeof(header));
+    struct sl_mesh_vertex *out =
+        (struct sl_mesh_vertex *)(file + header.vertexOffset);
+    for (uint32_t i = 0; i < model->vertexCount; i++) {
+        const struct vertex *v = &model->vertices[i];
+        for (int k = 0; k < 3; k++) {
+            out[i].position[k] =
+                unorm16(v->position[k], header.boundsMin[k],
+                        header.boundsMax[k] - header.boundsMin[k]);
+        }
+        octahedralEncode(v->normal, out[i].normal);
+        for (int k = 0; k < 2; k++) {
+            out[i].uv[k] = unorm16(v->uv[k], header.uvMin[k],
+                                   header.uvMax[k] - header.uvMin[k]);
+        }
+    }
+    for (uint32_t i = 0; i < model->indexCount; i++) {
+        uint8_t *p = file + header.indexOffset + (size_t)i * header.indexSize;
+        if (header.indexSize == 2) {
+            uint16_t index = (uint16_t)model->indices[i];
+            memcpy(p, &index, 2);
+        } else {
+            memcpy(p, &model->indices[i], 4);
+        }
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL || fwrite(file, 1, end, fp) != end || fclose(fp) != 0) {
+        fail("cannot write", path);
+    }
+    free(file);
+}
+
+static bool endsWith(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool keepScale = false;
+    bool optimize = true;
+    bool lods = true;
+    const char *in = NULL;
+    const char *out = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--keep-scale") == 0) {
+            keepScale = true;
+        } else if (strcmp(argv[i], "--no-optimize") == 0) {
+            optimize = false;
+        } else if (strcmp(argv[i], "--no-lods") == 0) {
+            lods = false;
+        } else if (in == NULL) {
+            in = argv[i];
+        } else if (out == NULL) {
+            out = argv[i];
+        } else {
+            in = NULL;
+            break;
+        }
+    }
+    if (in == NULL || out == NULL) {
+        fprintf(stderr, "usage: %s [--keep-scale] [--no-optimize] "
+                        "[--no-lods] in.obj|in.gltf|in.glb out.slm\n",
+                argv[0]);
+        return 1;
+    }
+
+    size_t size;
+    char *data = readWhole(in, &size);
+    struct model model = { 0 };
+    if (endsWith(in, ".obj")) {
+        parseObj(data, in, &model);
+    } else if (endsWith(in, ".gltf") || endsWith(in, ".glb")) {
+        parseGltf(data, size, in, &model);
+    } else {
+        fail("not .obj, .gltf or .glb", in);
+    }
+    free(data);
+    if (model.indexCount == 0) {
+        fail("no triangles", in);
+    }
+
+    fillNormals(&model);
+    toViewSpace(&model);
+    if (!keepScale) {
+        normalize(&model);
+    }
+    model.lodCount = 1;
+    model.lods[0].indexCount = model.indexCount;
+    if (lods) {
+        buildLods(&model);
+    }
+    if (optimize) {
+        struct model full = lodView(&model, 0);
+        float before = measureAcmr(&full);
+        for (uint32_t i = 0; i < model.lodCount; i++) {
+            struct model view = lodView(&model, i);
+            optimizeVertexCache(&view);
+            optimizeOverdraw(&view);
+        }
+        /* the full mesh first, so its vertices are the ones up front */
+        optimizeVertexFetch(&model);
+        full = lodView(&model, 0);
+        fprintf(stderr, "%s: acmr %.3f -> %.3f\n", out, before,
+                measureAcmr(&full));
+    }
+    writeMesh(&model, out);
+
+    fprintf(stderr, "%s: %u vertices, %u triangles", out,
+            model.vertexCount, model.lods[0].indexCount / 3);
+    for (uint32_t i = 1; i < model.lodCount; i++) {
+        fprintf(stderr, ", lod %u %u", i, model.lods[i].indexCount / 3);
+    }
+    fprintf(stderr, "\n");
+    free(model.vertices);
+    free(model.needsNormal);
+    free(model.indices);
+    return 0;
+}
@@ -0,0 +1,290 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "renderer.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <time.h>
+
+/* the gpu track, every cpu thread gets a number from 1 up */
+#define TRACE_GPU_TID 0
+
+static uint32_t nextThreadId;
+static __thread uint32_t threadId;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t currentThread(void) {
+    if (threadId == 0) {
+        threadId = __atomic_add_fetch(&nextThreadId, 1, __ATOMIC_RELAXED);
+    }
+    return threadId;
+}
+
+static void push(struct sl_trace *trace, uint32_t kind, uint32_t tid,
+                 const char *name, uint64_t start, uint64_t duration) {
+    uint32_t pos = __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+    struct sl_trace_event *event;
+    for (;;) {
+        event = &trace->ring[pos & (TRACE_RING_SIZE - 1)];
+        uint32_t seq = __atomic_load_n(&event->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&trace->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* full, a hole in the timeline is better than a stall in it */
+            __atomic_fetch_add(&trace->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    event->kind = kind;
+    event->tid = tid;
+    event->name = name;
+    event->start = start;
+    event->duration = duration;
+    __atomic_store_n(&event->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/****** writer thread */
+
+static void writeEvent(struct sl_trace *trace,
+                       const struct sl_trace_event *event) {
+    /* the array form, a missing ] is fine for both viewers so a crash
+       still leaves a usable trace behind */
+    fputs(trace->written ? ",\n" : "[\n", trace->fp);
+    trace->written = true;
+
+    if (event->kind == TRACE_EVENT_THREAD_NAME) {
+        fprintf(trace->fp,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                event->tid, event->name);
+        return;
+    }
+    /* events from before createTrace end up at 0 */
+    uint64_t start =
+        event->start > trace->origin ? event->start - trace->origin : 0;
+    fprintf(trace->fp,
+            "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+            "\"ts\":%.3f,\"dur\":%.3f}",
+            event->name, event->tid, start / 1e3, event->duration / 1e3);
+}
+
+static bool drain(struct sl_trace *trace) {
+    bool any = false;
+
+    for (;;) {
+        struct sl_trace_event *event =
+            &trace->ring[trace->tail & (TRACE_RING_SIZE - 1)];
+        uint32_t seq = __atomic_load_n(&event->seq, __ATOMIC_ACQUIRE);
+        if ((int32_t)(seq - (trace->tail + 1)) < 0) {
+            break;
+        }
+
+        writeEvent(trace, event);
+
+        __atomic_store_n(&event->seq, trace->tail + TRACE_RING_SIZE,
+                         __ATOMIC_RELEASE);
+        trace->tail++;
+        any = true;
+    }
+
+    if (any) {
+        fflush(trace->fp);
+    }
+    return any;
+}
+
+static void *traceWriter(void *arg) {
+    struct sl_trace *trace = arg;
+
+    struct timespec interval = { 0, TRACE_FLUSH_INTERVAL_MS * 1000000L };
+    while (!__atomic_load_n(&trace->stopping, __ATOMIC_ACQUIRE)) {
+        if (!drain(trace)) {
+            nanosleep(&interval, NULL);
+        }
+    }
+
+    drain(trace);
+    return NULL;
+}
+
+/****** any thread */
+
+void createTrace(struct sl_oo *oo) {
+    struct sl_trace *trace = &oo->trace;
+    if (trace->path == NULL) {
+        return;
+    }
+
+    trace->fp = fopen(trace->path, "w");
+    if (trace->fp == NULL) {
+        error_log("cannot write trace to %s: %s", trace->path,
+                  strerror(errno));
+        return;
+    }
+    trace->ring = malloc(sizeof(struct sl_trace_event) * TRACE_RING_SIZE);
+    for (uint32_t i = 0; i < TRACE_RING_SIZE; i++) {
+        trace->ring[i].seq = i;
+    }
+    trace->origin = now_ns();
+    trace->active = true;
+
+    push(trace, TRACE_EVENT_THREAD_NAME, TRACE_GPU_TID, "gpu", 0, 0);
+    traceThreadName(oo, "render");
+
+    if (pthread_create(&trace->writer, NULL, traceWriter, trace) != 0) {
+        error_log("failed to start trace thread!");
+        exit(1);
+    }
+}
+
+/* after every other thread that records zones has been joined */
+void destroyTrace(struct sl_oo *oo) {
+    struct sl_trace *trace = &oo->trace;
+    if (!trace->active) {
+        return;
+    }
+
+    __atomic_store_n(&trace->stopping, true, __ATOMIC_RELEASE);
+    pthread_join(trace->writer, NULL);
+    trace->active = false;
+
+    fputs(trace->written ? "\n]\n" : "[]\n", trace->fp);
+    fclose(trace->fp);
+    free(trace->ring);
+    trace->ring = NULL;
+
+    if (trace->dropped > 0) {
+        error_log("trace: dropped %u events, ring full", trace->dropped);
+    }
+    fprintf(stderr, "trace written to %s\n", trace->path);
+}
+
+void traceThreadName(struct sl_oo *oo, const char *name) {
+    if (!oo->trace.active) {
+        return;
+    }
+    push(&oo->trace, TRACE_EVENT_THREAD_NAME, currentThread(), name, 0, 0);
+}
+
+struct sl_trace_zone traceZoneBegin(struct sl_oo *oo, const char *name) {
+    struct sl_trace_zone zone = { oo, name, 0 };
+    if (oo->trace.active) {
+        zone.start = now_ns();
+    }
+    return zone;
+}
+
+void traceZoneEnd(struct sl_trace_zone *zone) {
+    if (zone->start == 0) {
+        return;
+    }
+    push(&zone->oo->trace, TRACE_EVENT_ZONE, currentThread(), zone->name,
+         zone->start, now_ns() - zone->start);
+}
+
+/****** render thread */
+
+bool checkCalibratedTimestampSupport(struct sl_oo *oo) {
+#ifdef __linux__
+    if (!checkDeviceExtension(oo->physicalDevice,
+                              VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+        return false;
+    }
+    PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getTimeDomains =
+        (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+            vkGetInstanceProcAddr(
+                oo->instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+    if (getTimeDomains == NULL) {
+        return false;
+    }
+
+    uint32_t domainCount = 0;
+    getTimeDomains(oo->physicalDevice, &domainCount, NULL);
+    VkTimeDomainEXT *domains = malloc(sizeof(VkTimeDomainEXT) * domainCount);
+    getTimeDomains(oo->physicalDevice, &domainCount, domains);
+
+    bool device = false;
+    bool monotonic = false;
+    for (uint32_t i = 0; i < domainCount; i++) {
+        device |= domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+        monotonic |= domains[i] == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+    }
+    free(domains);
+    return device && monotonic;
+#else
+    /* our zones are on CLOCK_MONOTONIC, nothing else to line up with */
+    return false;
+#endif
+}
+
+/* the gpu and cpu clocks run at slightly different rates, a fresh pair
+   every TRACE_CALIBRATE_INTERVAL frames keeps the drift well under a
+   frame */
+static void calibrate(struct sl_oo *oo) {
+    struct sl_trace *trace = &oo->trace;
+
+    if (trace->getCalibratedTimestamps == NULL) {
+        trace->getCalibratedTimestamps =
+            (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(
+                oo->device, "vkGetCalibratedTimestampsEXT");
+        if (trace->getCalibratedTimestamps == NULL) {
+            trace->calibrated = false;
+            return;
+        }
+    }
+
+    VkCalibratedTimestampInfoEXT timestampInfos[2] = { 0 };
+    timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (trace->getCalibratedTimestamps(oo->device, 2, timestampInfos,
+                                       timestamps,
+                                       &maxDeviation) != VK_SUCCESS) {
+        return;
+    }
+    trace->gpuBase = timestamps[0];
+    trace->cpuBase = timestamps[1];
+    trace->calibration = true;
+    trace->calibratedFrame = oo->stats.frames;
+}
+
+void traceGpuFrame(struct sl_oo *oo, uint64_t begin, uint64_t end) {
+    struct sl_trace *trace = &oo->trace;
+    if (!trace->active || !trace->calibrated) {
+        return;
+    }
+
+    if (!trace->calibration ||
+        oo->stats.frames - trace->calibratedFrame >=
+            TRACE_CALIBRATE_INTERVAL) {
+        calibrate(oo);
+        if (!trace->calibration) {
+            return;
+        }
+    }
+
+    /* the frame may be from before the calibration, so signed */
+    double offset =
+        (double)(int64_t)(begin - trace->gpuBase) * oo->timestampPeriod;
+    uint64_t start = trace->cpuBase + (int64_t)offset;
+    uint64_t duration = (uint64_t)((double)(end - begin) *
+                                   oo->timestampPeriod);
+    push(trace, TRACE_EVENT_ZONE, TRACE_GPU_TID, "frame", start, duration);
+}
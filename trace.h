@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "config.h"
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/* a timeline of what the cpu and the gpu were doing, written as chrome
+   trace json for chrome://tracing or ui.perfetto.dev. zones go into a
+   lock free ring from any thread and a writer thread formats them. the
+   gpu frames come from the timestamp queries, moved onto the cpu clock
+   with VK_EXT_calibrated_timestamps. */
+
+struct sl_oo;
+
+enum TraceEventKind {
+    TRACE_EVENT_ZONE,
+    /* names the track of tid */
+    TRACE_EVENT_THREAD_NAME,
+};
+
+struct sl_trace_event {
+    uint32_t seq;
+    uint32_t kind;
+    uint32_t tid;
+    /* string literals only, the writer reads them much later */
+    const char *name;
+    /* ns on CLOCK_MONOTONIC */
+    uint64_t start;
+    uint64_t duration;
+};
+
+struct sl_trace {
+    /* option, set before createTrace */
+    const char *path;
+
+    bool active;
+    FILE *fp;
+    /* where ts 0 is */
+    uint64_t origin;
+    /* writer thread only, whether the next event needs a comma */
+    bool written;
+
+    /* same bounded mpsc queue as the validation log */
+    struct sl_trace_event *ring;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    pthread_t writer;
+    bool stopping;
+
+    /* VK_EXT_calibrated_timestamps is enabled on the device */
+    bool calibrated;
+    PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps;
+    /* a device tick and a CLOCK_MONOTONIC ns taken at the same moment */
+    uint64_t gpuBase;
+    uint64_t cpuBase;
+    bool calibration;
+    uint64_t calibratedFrame;
+};
+
+/* a zone is closed when its variable goes out of scope */
+struct sl_trace_zone {
+    struct sl_oo *oo;
+    const char *name;
+    uint64_t start;
+};
+
+/* both do nothing unless trace.path is set */
+void createTrace(struct sl_oo *oo);
+void destroyTrace(struct sl_oo *oo);
+
+/* createLogicalDevice enables the extension when this says the gpu clock
+   can be lined up with CLOCK_MONOTONIC */
+bool checkCalibratedTimestampSupport(struct sl_oo *oo);
+
+/* the name of the calling thread's track */
+void traceThreadName(struct sl_oo *oo, const char *name);
+
+struct sl_trace_zone traceZoneBegin(struct sl_oo *oo, const char *name);
+void traceZoneEnd(struct sl_trace_zone *zone);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+/* from here to the end of the enclosing block, name must be a literal */
+#define TRACE_ZONE(oo, name)                                                 \
+    struct sl_trace_zone TRACE_CONCAT(traceZone, __LINE__)                   \
+        __attribute__((cleanup(traceZoneEnd))) = traceZoneBegin(oo, name)
+
+/* drawFrame passes the timestamps of a frame whose fence signaled */
+void traceGpuFrame(struct sl_oo *oo, uint64_t begin, uint64_t end);
+
+#endif /* TRACE_H */